@@ -22,6 +22,9 @@ namespace rl_tools::rl::environments::multirotor{
             T J_inv[3][3];
             T rpm_time_constant;
             ActionLimit action_limit;
+            // Derived from the rotor geometry by update_wrench_mixing (not part of the parameter sets):
+            // body-frame thrust (rows 0-2) and torque (rows 3-5) produced by one unit of thrust of each rotor
+            T wrench_mixing[6][N];
         };
         struct Integration{
             T dt;
@@ -132,6 +135,8 @@ namespace rl_tools::rl::environments::multirotor{
             using NEXT_COMPONENT = typename SPEC::NEXT_COMPONENT;
             static constexpr bool PRIVILEGED = SPEC::PRIVILEGED;
             static constexpr TI CURRENT_DIM = 3;
+            template <bool PRIVILEGED_OBSERVATION_NOISE>
+            static constexpr TI CURRENT_NOISE_DIM = !PRIVILEGED || PRIVILEGED_OBSERVATION_NOISE ? CURRENT_DIM : 0;
             static constexpr TI DIM = NEXT_COMPONENT::DIM + CURRENT_DIM;
         };
         template <typename T_T, typename T_TI, typename T_NEXT_COMPONENT = LastComponent<T_TI>>
@@ -152,6 +157,8 @@ namespace rl_tools::rl::environments::multirotor{
             using NEXT_COMPONENT = typename SPEC::NEXT_COMPONENT;
             static constexpr bool PRIVILEGED = SPEC::PRIVILEGED;
             static constexpr TI CURRENT_DIM = 4;
+            template <bool PRIVILEGED_OBSERVATION_NOISE>
+            static constexpr TI CURRENT_NOISE_DIM = !PRIVILEGED || PRIVILEGED_OBSERVATION_NOISE ? CURRENT_DIM : 0;
             static constexpr TI DIM = NEXT_COMPONENT::DIM + CURRENT_DIM;
         };
 
@@ -173,6 +180,8 @@ namespace rl_tools::rl::environments::multirotor{
             using NEXT_COMPONENT = typename SPEC::NEXT_COMPONENT;
             static constexpr bool PRIVILEGED = SPEC::PRIVILEGED;
             static constexpr TI CURRENT_DIM = 9;
+            template <bool PRIVILEGED_OBSERVATION_NOISE>
+            static constexpr TI CURRENT_NOISE_DIM = !PRIVILEGED || PRIVILEGED_OBSERVATION_NOISE ? CURRENT_DIM : 0;
             static constexpr TI DIM = NEXT_COMPONENT::DIM + CURRENT_DIM;
         };
         template <typename T_T, typename T_TI, typename T_NEXT_COMPONENT = LastComponent<T_TI>>
@@ -193,6 +202,8 @@ namespace rl_tools::rl::environments::multirotor{
             using NEXT_COMPONENT = typename SPEC::NEXT_COMPONENT;
             static constexpr bool PRIVILEGED = SPEC::PRIVILEGED;
             static constexpr TI CURRENT_DIM = 3;
+            template <bool PRIVILEGED_OBSERVATION_NOISE>
+            static constexpr TI CURRENT_NOISE_DIM = !PRIVILEGED || PRIVILEGED_OBSERVATION_NOISE ? CURRENT_DIM : 0;
             static constexpr TI DIM = NEXT_COMPONENT::DIM + CURRENT_DIM;
         };
         template <typename T_T, typename T_TI, typename T_NEXT_COMPONENT = LastComponent<T_TI>>
@@ -213,6 +224,8 @@ namespace rl_tools::rl::environments::multirotor{
             using NEXT_COMPONENT = typename SPEC::NEXT_COMPONENT;
             static constexpr bool PRIVILEGED = SPEC::PRIVILEGED;
             static constexpr TI CURRENT_DIM = 3;
+            template <bool PRIVILEGED_OBSERVATION_NOISE>
+            static constexpr TI CURRENT_NOISE_DIM = !PRIVILEGED || PRIVILEGED_OBSERVATION_NOISE ? CURRENT_DIM : 0;
             static constexpr TI DIM = NEXT_COMPONENT::DIM + CURRENT_DIM;
         };
         template <typename T_T, typename T_TI, typename T_NEXT_COMPONENT = LastComponent<T_TI>>
@@ -227,6 +240,8 @@ namespace rl_tools::rl::environments::multirotor{
             using TI = typename SPEC::TI;
             using NEXT_COMPONENT = typename SPEC::NEXT_COMPONENT;
             static constexpr TI CURRENT_DIM = 4;
+            template <bool PRIVILEGED_OBSERVATION_NOISE>
+            static constexpr TI CURRENT_NOISE_DIM = 0;
             static constexpr TI DIM = NEXT_COMPONENT::DIM + CURRENT_DIM;
         };
         template <typename T_T, typename T_TI, T_TI T_HISTORY_LENGTH, typename T_NEXT_COMPONENT = LastComponent<T_TI>>
@@ -244,6 +259,8 @@ namespace rl_tools::rl::environments::multirotor{
             static constexpr TI HISTORY_LENGTH = SPEC::HISTORY_LENGTH;
             static constexpr TI ACTION_DIM = 4;
             static constexpr TI CURRENT_DIM = ACTION_DIM * HISTORY_LENGTH;
+            template <bool PRIVILEGED_OBSERVATION_NOISE>
+            static constexpr TI CURRENT_NOISE_DIM = 0;
             static constexpr TI DIM = NEXT_COMPONENT::DIM + CURRENT_DIM;
         };
         template <typename T_T, typename T_TI, typename T_NEXT_COMPONENT = LastComponent<T_TI>>
@@ -258,8 +275,56 @@ namespace rl_tools::rl::environments::multirotor{
             using TI = typename SPEC::TI;
             using NEXT_COMPONENT = typename SPEC::NEXT_COMPONENT;
             static constexpr TI CURRENT_DIM = 6;
+            template <bool PRIVILEGED_OBSERVATION_NOISE>
+            static constexpr TI CURRENT_NOISE_DIM = 0;
             static constexpr TI DIM = NEXT_COMPONENT::DIM + CURRENT_DIM;
         };
+        template <typename T_T, typename T_TI, T_TI T_NUM_RAYS, typename T_NEXT_COMPONENT = LastComponent<T_TI>>
+        struct RangeSensorSpecification {
+            using T = T_T;
+            using TI = T_TI;
+            using NEXT_COMPONENT = T_NEXT_COMPONENT;
+            static constexpr TI NUM_RAYS = T_NUM_RAYS;
+            static constexpr T MAX_RANGE = 2; // [m]
+        };
+        // Distances to the obstacles along NUM_RAYS rays that are evenly spaced in the body x-y plane, divided by MAX_RANGE (1: nothing in range)
+        template <typename SPEC>
+        struct RangeSensor{
+            using T = typename SPEC::T;
+            using TI = typename SPEC::TI;
+            using NEXT_COMPONENT = typename SPEC::NEXT_COMPONENT;
+            static constexpr TI NUM_RAYS = SPEC::NUM_RAYS;
+            static constexpr T MAX_RANGE = SPEC::MAX_RANGE;
+            static constexpr TI CURRENT_DIM = NUM_RAYS;
+            template <bool PRIVILEGED_OBSERVATION_NOISE>
+            static constexpr TI CURRENT_NOISE_DIM = 0;
+            static constexpr TI DIM = NEXT_COMPONENT::DIM + CURRENT_DIM;
+        };
+
+        // Compile-time layout of a flat observation row: the column offset of each component and the offset into the
+        // block of observation noise samples (only the noisy components consume samples)
+        template <typename TI, typename OBSERVATION, bool PRIVILEGED_OBSERVATION_NOISE, TI T_OFFSET = 0, TI T_NOISE_OFFSET = 0>
+        struct Layout{
+            using COMPONENT = OBSERVATION;
+            static constexpr TI OFFSET = T_OFFSET;
+            static constexpr TI NOISE_OFFSET = T_NOISE_OFFSET;
+            static constexpr TI NOISE_DIM = OBSERVATION::template CURRENT_NOISE_DIM<PRIVILEGED_OBSERVATION_NOISE>;
+            using NEXT = Layout<TI, typename OBSERVATION::NEXT_COMPONENT, PRIVILEGED_OBSERVATION_NOISE, OFFSET + OBSERVATION::CURRENT_DIM, NOISE_OFFSET + NOISE_DIM>;
+            static constexpr TI DIM = NEXT::DIM;
+            static constexpr TI TOTAL_NOISE_DIM = NEXT::TOTAL_NOISE_DIM;
+        };
+        template <typename TI, bool PRIVILEGED_OBSERVATION_NOISE, TI T_OFFSET, TI T_NOISE_OFFSET>
+        struct Layout<TI, LastComponent<TI>, PRIVILEGED_OBSERVATION_NOISE, T_OFFSET, T_NOISE_OFFSET>{
+            using COMPONENT = LastComponent<TI>;
+            static constexpr TI OFFSET = T_OFFSET;
+            static constexpr TI NOISE_OFFSET = T_NOISE_OFFSET;
+            static constexpr TI DIM = OFFSET;
+            static constexpr TI TOTAL_NOISE_DIM = NOISE_OFFSET;
+        };
+        template <typename TI, bool PRIVILEGED_OBSERVATION_NOISE, TI T_OFFSET, TI T_NOISE_OFFSET>
+        struct Layout<TI, NONE<TI>, PRIVILEGED_OBSERVATION_NOISE, T_OFFSET, T_NOISE_OFFSET>: Layout<TI, LastComponent<TI>, PRIVILEGED_OBSERVATION_NOISE, T_OFFSET, T_NOISE_OFFSET>{
+            using COMPONENT = NONE<TI>;
+        };
     }
 
 
@@ -273,6 +338,12 @@ namespace rl_tools::rl::environments::multirotor{
         T orientation[4];
         T linear_velocity[3];
         T angular_velocity[3];
+        // derived from the (normalized) orientation once per step by update_derived_quantities, not part of DIM
+        T rotation_matrix[3][3];
+        // collision query at the position, cached once per step by update_obstacle_cache, not part of DIM
+        T obstacle_distance; // signed distance to the nearest obstacle surface (negative inside)
+        int obstacle_id;     // index of the nearest obstacle (cf. obstacles::Node::nearest), -1 if there are none
+        bool obstacle_collision; // also set by step if the position was inside an obstacle at any of the physics sub-steps
     };
     template <typename T_T, typename T_TI, typename T_NEXT_COMPONENT>
     struct StateRotors: T_NEXT_COMPONENT{
@@ -294,7 +365,9 @@ namespace rl_tools::rl::environments::multirotor{
         static constexpr TI PARENT_DIM = StateRotors<T, TI, NEXT_COMPONENT>::DIM;
         static constexpr TI ACTION_DIM = 4;
         static constexpr TI DIM = PARENT_DIM + HISTORY_LENGTH * ACTION_DIM;
+        // ring buffer: action_history[action_history_head] is the oldest action, the newest one is right before it
         T action_history[HISTORY_LENGTH][4];
+        TI action_history_head;
     };
     template <typename T_T, typename T_TI, typename T_NEXT_COMPONENT>
     struct StateRandomForce: T_NEXT_COMPONENT{
@@ -321,6 +394,10 @@ namespace rl_tools::rl::environments::multirotor{
                                  observation::AngularVelocity<observation::AngularVelocitySpecification<T, TI>>>>>>>>;
         using OBSERVATION_TYPE_PRIVILEGED = observation::NONE<TI>;
         static constexpr bool PRIVILEGED_OBSERVATION_NOISE = false;
+        // advance the rotor speeds with the exact solution of the first-order lag instead of integrating them with RK4
+        static constexpr bool CLOSED_FORM_ROTOR_DELAY = false;
+        // number of physics steps per control step (integration.dt is the control period)
+        static constexpr TI PHYSICS_SUBSTEPS = 1;
     };
 
     template <typename T_T, typename T_TI, typename T_PARAMETERS, typename T_STATIC_PARAMETERS>
@@ -330,6 +407,15 @@ namespace rl_tools::rl::environments::multirotor{
         using PARAMETERS = T_PARAMETERS;
         using STATIC_PARAMETERS = T_STATIC_PARAMETERS;
     };
+
+    // transition summary produced by step_full: dt, reward, terminal flag and the reward components of one step
+    template <typename T, typename COMPONENTS>
+    struct StepResult{
+        T dt;
+        T reward;
+        bool terminated;
+        COMPONENTS components;
+    };
 }
 RL_TOOLS_NAMESPACE_WRAPPER_END
 
@@ -0,0 +1,137 @@
+#ifndef LEARNING_TO_FLY_IN_SECONDS_SIMULATOR_OBSTACLE_COURSE_H
+#define LEARNING_TO_FLY_IN_SECONDS_SIMULATOR_OBSTACLE_COURSE_H
+
+#include "obstacle_field.h"
+
+#ifndef RL_TOOLS_FUNCTION_PLACEMENT
+#define RL_TOOLS_FUNCTION_PLACEMENT
+#endif
+
+// Procedural obstacle courses. A Course is a fixed-capacity structure of arrays that is stored by value in the parameters of
+// each environment (no heap, no indirection) and redrawn from a CourseGenerator at the start of every episode
+// (sample_initial_state). evaluate() and raycast() of obstacle_field.h accept it like a Scene.
+
+namespace rl_tools::rl::environments::multirotor::obstacles{
+    static constexpr size_t COURSE_MAX_CYLINDERS = 8;
+    static constexpr size_t COURSE_MAX_PLANES = 4;
+    struct Course{
+        size_t num_cylinders = 0;
+        size_t num_planes = 0;
+        // cylinders
+        float x[COURSE_MAX_CYLINDERS];
+        float y[COURSE_MAX_CYLINDERS];
+        float radius[COURSE_MAX_CYLINDERS];
+        float cylinder_z_min[COURSE_MAX_CYLINDERS];
+        float cylinder_z_max[COURSE_MAX_CYLINDERS];
+        // walls (cf. Plane)
+        float point[3][COURSE_MAX_PLANES];
+        float normal[3][COURSE_MAX_PLANES];
+        float thickness[COURSE_MAX_PLANES];
+        float lower[3][COURSE_MAX_PLANES];
+        float upper[3][COURSE_MAX_PLANES];
+        RL_TOOLS_FUNCTION_PLACEMENT Cylinder cylinder(size_t i) const {
+            return {x[i], y[i], radius[i], cylinder_z_min[i], cylinder_z_max[i]};
+        }
+        RL_TOOLS_FUNCTION_PLACEMENT Plane plane(size_t i) const {
+            return {point[0][i], point[1][i], point[2][i], normal[0][i], normal[1][i], normal[2][i], thickness[i], lower[0][i], upper[0][i], lower[1][i], upper[1][i], lower[2][i], upper[2][i]};
+        }
+    };
+    // Pipes are vertical and span [lower[2], upper[2]], walls are vertical and axis aligned (normal along x or y)
+    struct CourseGenerator{
+        size_t min_cylinders;
+        size_t max_cylinders; // <= COURSE_MAX_CYLINDERS
+        float min_radius;
+        float max_radius;
+        size_t min_planes;
+        size_t max_planes; // <= COURSE_MAX_PLANES
+        float plane_thickness; // half-thickness
+        float min_plane_length;
+        float max_plane_length;
+        // obstacle centers are drawn uniformly from this box
+        float lower[3];
+        float upper[3];
+        // free space around the spawn position and the target
+        float clearance;
+        // rejection sampling: an obstacle that violates the clearance is redrawn at most this often and dropped afterwards
+        size_t max_attempts;
+    };
+
+    namespace internal{
+        template <typename DEVICE, typename T>
+        RL_TOOLS_FUNCTION_PLACEMENT bool clear(DEVICE& device, const Cylinder& cylinder, const T spawn[3], const T target[3], T clearance){
+            Node<T> spawn_node = empty_node<T>(), target_node = empty_node<T>();
+            add_cylinder(device, spawn, cylinder, 0, spawn_node);
+            add_cylinder(device, target, cylinder, 0, target_node);
+            return spawn_node.distance > clearance && target_node.distance > clearance;
+        }
+        template <typename DEVICE, typename T>
+        RL_TOOLS_FUNCTION_PLACEMENT bool clear(DEVICE& device, const Plane& plane, const T spawn[3], const T target[3], T clearance){
+            Node<T> spawn_node = empty_node<T>(), target_node = empty_node<T>();
+            add_plane(device, spawn, plane, 0, spawn_node);
+            add_plane(device, target, plane, 0, target_node);
+            return spawn_node.distance > clearance && target_node.distance > clearance;
+        }
+    }
+
+    // Draws a new course into course (overwriting the previous one), keeping the given positions (spawn and target) clear
+    template <typename DEVICE, typename T, typename RNG>
+    RL_TOOLS_FUNCTION_PLACEMENT void sample(DEVICE& device, const CourseGenerator& generator, const T spawn[3], const T target[3], Course& course, RNG& rng){
+        typename DEVICE::SPEC::RANDOM random_dev;
+        using TI = typename DEVICE::index_t;
+        // the bounds are clamped to the capacity and min to max (generators built in code do not pass the checks of the JSON loader)
+        const size_t max_cylinders = generator.max_cylinders < COURSE_MAX_CYLINDERS ? generator.max_cylinders : COURSE_MAX_CYLINDERS;
+        const size_t max_planes = generator.max_planes < COURSE_MAX_PLANES ? generator.max_planes : COURSE_MAX_PLANES;
+        const size_t min_cylinders = generator.min_cylinders < max_cylinders ? generator.min_cylinders : max_cylinders;
+        const size_t min_planes = generator.min_planes < max_planes ? generator.min_planes : max_planes;
+        const size_t num_cylinders = (size_t)random::uniform_int_distribution(random_dev, (TI)min_cylinders, (TI)max_cylinders, rng);
+        const size_t num_planes = (size_t)random::uniform_int_distribution(random_dev, (TI)min_planes, (TI)max_planes, rng);
+        const T clearance = generator.clearance;
+        course.num_cylinders = 0;
+        course.num_planes = 0;
+        for(size_t obstacle_i = 0; obstacle_i < num_cylinders; obstacle_i++){
+            const size_t i = course.num_cylinders;
+            for(size_t attempt_i = 0; attempt_i < generator.max_attempts; attempt_i++){
+                course.x[i] = random::uniform_real_distribution(random_dev, (T)generator.lower[0], (T)generator.upper[0], rng);
+                course.y[i] = random::uniform_real_distribution(random_dev, (T)generator.lower[1], (T)generator.upper[1], rng);
+                course.radius[i] = random::uniform_real_distribution(random_dev, (T)generator.min_radius, (T)generator.max_radius, rng);
+                course.cylinder_z_min[i] = generator.lower[2];
+                course.cylinder_z_max[i] = generator.upper[2];
+                if(internal::clear(device, course.cylinder(i), spawn, target, clearance)){
+                    course.num_cylinders++;
+                    break;
+                }
+            }
+        }
+        for(size_t plane_i = 0; plane_i < num_planes; plane_i++){
+            const size_t i = course.num_planes;
+            for(size_t attempt_i = 0; attempt_i < generator.max_attempts; attempt_i++){
+                const size_t axis = random::uniform_int_distribution(random_dev, (TI)0, (TI)1, rng); // normal along x or y
+                const size_t along = 1 - axis;
+                const T half_length = random::uniform_real_distribution(random_dev, (T)generator.min_plane_length, (T)generator.max_plane_length, rng) / 2;
+                T center[2];
+                for(size_t dim_i = 0; dim_i < 2; dim_i++){
+                    center[dim_i] = random::uniform_real_distribution(random_dev, (T)generator.lower[dim_i], (T)generator.upper[dim_i], rng);
+                }
+                for(size_t dim_i = 0; dim_i < 3; dim_i++){
+                    course.normal[dim_i][i] = dim_i == axis ? 1 : 0;
+                }
+                course.point[0][i] = center[0];
+                course.point[1][i] = center[1];
+                course.point[2][i] = ((T)generator.lower[2] + (T)generator.upper[2]) / 2;
+                course.thickness[i] = generator.plane_thickness;
+                course.lower[axis][i] = center[axis] - generator.plane_thickness;
+                course.upper[axis][i] = center[axis] + generator.plane_thickness;
+                course.lower[along][i] = center[along] - half_length;
+                course.upper[along][i] = center[along] + half_length;
+                course.lower[2][i] = generator.lower[2];
+                course.upper[2][i] = generator.upper[2];
+                if(internal::clear(device, course.plane(i), spawn, target, clearance)){
+                    course.num_planes++;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,394 @@
+#ifndef LEARNING_TO_FLY_IN_SECONDS_SIMULATOR_OBSTACLE_FIELD_H
+#define LEARNING_TO_FLY_IN_SECONDS_SIMULATOR_OBSTACLE_FIELD_H
+
+#include <stddef.h>
+
+#ifndef RL_TOOLS_FUNCTION_PLACEMENT
+#define RL_TOOLS_FUNCTION_PLACEMENT
+#endif
+
+// Obstacle geometry as a signed-distance field. The obstacle course (Scene) is loaded at runtime (cf. src/obstacle_scene.h)
+// into compact, cache-line aligned records that all environments share read-only. evaluate() computes the signed distance
+// to the nearest obstacle surface (negative inside an obstacle), the index of the nearest obstacle and the proximity penalty
+// by looping over all cylinders and walls. bake() samples these three quantities once on a regular grid, after which query()
+// costs one lookup of 8 nodes (trilinear for distance and penalty, closest node for the index) independent of the number
+// of obstacles.
+
+namespace rl_tools::rl::environments::multirotor::obstacles{
+    // vertical pipe
+    struct alignas(32) Cylinder{
+        float x;
+        float y;
+        float radius;
+        float z_min;
+        float z_max;
+    };
+    // wall: point on the plane, unit normal, half-thickness and the bounding box limiting its extent
+    struct alignas(64) Plane{
+        float point_x, point_y, point_z;
+        float normal_x, normal_y, normal_z;
+        float thickness;
+        float x_min, x_max;
+        float y_min, y_max;
+        float z_min, z_max;
+    };
+    // non-owning view of an obstacle course
+    struct Scene{
+        const Cylinder* cylinders = nullptr;
+        size_t num_cylinders = 0;
+        const Plane* planes = nullptr;
+        size_t num_planes = 0;
+        RL_TOOLS_FUNCTION_PLACEMENT const Cylinder& cylinder(size_t i) const { return cylinders[i]; }
+        RL_TOOLS_FUNCTION_PLACEMENT const Plane& plane(size_t i) const { return planes[i]; }
+    };
+    // obstacle index: cylinders first, then planes (i.e. plane i has the index num_cylinders + i)
+    static constexpr int NONE = -1;
+    template <typename T>
+    struct Node{
+        T distance;
+        T penalty;
+        int nearest; // index of the obstacle closest to the position, NONE if there are no obstacles
+    };
+    template <typename T>
+    struct Sample: Node<T>{
+        T gradient[3]; // gradient of the signed distance (points away from the nearest obstacle)
+    };
+    template <typename T>
+    struct Field{
+        T origin[3];
+        T spacing;
+        size_t size[3] = {0, 0, 0}; // number of nodes per axis
+        Node<T>* nodes = nullptr;   // x-major: nodes[(x * size[1] + y) * size[2] + z]
+    };
+    // proximity penalty and collision rules (shared by the exact evaluation and the baked field)
+    static constexpr double CYLINDER_DANGER_ZONE_FACTOR = 2.0; // times the pipe radius
+    static constexpr double PLANE_DANGER_ZONE_FACTOR = 3.0;    // times the wall thickness
+    static constexpr double PENALTY_SCALE = 3.0;
+    // distance reported when there are no obstacles at all
+    static constexpr double FAR = 1e6;
+
+    namespace internal{
+        template <typename DEVICE, typename T>
+        RL_TOOLS_FUNCTION_PLACEMENT T length(DEVICE& device, T a, T b){
+            a = math::max(device.math, a, (T)0);
+            b = math::max(device.math, b, (T)0);
+            return math::sqrt(device.math, a * a + b * b);
+        }
+        template <typename DEVICE, typename T>
+        RL_TOOLS_FUNCTION_PLACEMENT T length(DEVICE& device, T a, T b, T c){
+            a = math::max(device.math, a, (T)0);
+            b = math::max(device.math, b, (T)0);
+            c = math::max(device.math, c, (T)0);
+            return math::sqrt(device.math, a * a + b * b + c * c);
+        }
+        // signed distance to an axis aligned box
+        template <typename DEVICE, typename T>
+        RL_TOOLS_FUNCTION_PLACEMENT T box(DEVICE& device, const T position[3], const T lower[3], const T upper[3]){
+            T q[3];
+            for(size_t i = 0; i < 3; i++){
+                q[i] = math::max(device.math, lower[i] - position[i], position[i] - upper[i]);
+            }
+            T inside = math::min(device.math, math::max(device.math, q[0], math::max(device.math, q[1], q[2])), (T)0);
+            return inside + length(device, q[0], q[1], q[2]);
+        }
+    }
+
+    namespace internal{
+        // CYLINDER/PLANE: any type with the members of Cylinder/Plane
+        template <typename DEVICE, typename T, typename CYLINDER>
+        RL_TOOLS_FUNCTION_PLACEMENT void add_cylinder(DEVICE& device, const T position[3], const CYLINDER& cylinder, int index, Node<T>& node){
+            T dx = position[0] - (T)cylinder.x;
+            T dy = position[1] - (T)cylinder.y;
+            T horizontal_distance = math::sqrt(device.math, dx * dx + dy * dy);
+            T q_horizontal = horizontal_distance - (T)cylinder.radius;
+            T q_vertical = math::max(device.math, (T)cylinder.z_min - position[2], position[2] - (T)cylinder.z_max);
+            T distance = math::min(device.math, math::max(device.math, q_horizontal, q_vertical), (T)0) + length(device, q_horizontal, q_vertical);
+            if(distance < node.distance){
+                node.distance = distance;
+                node.nearest = index;
+            }
+            if(q_vertical <= 0){
+                T danger_zone_radius = (T)cylinder.radius * (T)CYLINDER_DANGER_ZONE_FACTOR;
+                if(horizontal_distance < danger_zone_radius){
+                    T proximity_factor = (danger_zone_radius - horizontal_distance) / danger_zone_radius;
+                    node.penalty += proximity_factor * proximity_factor * (T)PENALTY_SCALE;
+                }
+            }
+        }
+        template <typename DEVICE, typename T, typename PLANE>
+        RL_TOOLS_FUNCTION_PLACEMENT void add_plane(DEVICE& device, const T position[3], const PLANE& plane, int index, Node<T>& node){
+            T lower[3] = {(T)plane.x_min, (T)plane.y_min, (T)plane.z_min};
+            T upper[3] = {(T)plane.x_max, (T)plane.y_max, (T)plane.z_max};
+            T bounds_distance = box(device, position, lower, upper);
+            T signed_distance = (position[0] - (T)plane.point_x) * (T)plane.normal_x + (position[1] - (T)plane.point_y) * (T)plane.normal_y + (position[2] - (T)plane.point_z) * (T)plane.normal_z;
+            T distance_to_plane = math::abs(device.math, signed_distance);
+            T distance = math::max(device.math, distance_to_plane - (T)plane.thickness, bounds_distance);
+            if(distance < node.distance){
+                node.distance = distance;
+                node.nearest = index;
+            }
+            if(bounds_distance <= 0){
+                T danger_zone_thickness = (T)plane.thickness * (T)PLANE_DANGER_ZONE_FACTOR;
+                if(distance_to_plane < danger_zone_thickness){
+                    T proximity_factor = (danger_zone_thickness - distance_to_plane) / danger_zone_thickness;
+                    node.penalty += proximity_factor * proximity_factor * (T)PENALTY_SCALE;
+                }
+            }
+        }
+        template <typename T>
+        RL_TOOLS_FUNCTION_PLACEMENT Node<T> empty_node(){
+            Node<T> node;
+            node.distance = (T)FAR;
+            node.penalty = 0;
+            node.nearest = NONE;
+            return node;
+        }
+    }
+
+    template <typename DEVICE, typename T, typename CYLINDER, typename PLANE>
+    RL_TOOLS_FUNCTION_PLACEMENT Node<T> evaluate(DEVICE& device, const T position[3], const CYLINDER* cylinders, size_t num_cylinders, const PLANE* planes, size_t num_planes){
+        Node<T> node = internal::empty_node<T>();
+        for(size_t obstacle_i = 0; obstacle_i < num_cylinders; obstacle_i++){
+            internal::add_cylinder(device, position, cylinders[obstacle_i], (int)obstacle_i, node);
+        }
+        for(size_t plane_i = 0; plane_i < num_planes; plane_i++){
+            internal::add_plane(device, position, planes[plane_i], (int)(num_cylinders + plane_i), node);
+        }
+        return node;
+    }
+    // SCENE: Scene or any other obstacle store with num_cylinders, num_planes, cylinder(i) and plane(i) (cf. obstacle_course.h)
+    template <typename DEVICE, typename T, typename SCENE>
+    RL_TOOLS_FUNCTION_PLACEMENT Node<T> evaluate(DEVICE& device, const T position[3], const SCENE& scene){
+        Node<T> node = internal::empty_node<T>();
+        for(size_t obstacle_i = 0; obstacle_i < scene.num_cylinders; obstacle_i++){
+            internal::add_cylinder(device, position, scene.cylinder(obstacle_i), (int)obstacle_i, node);
+        }
+        for(size_t plane_i = 0; plane_i < scene.num_planes; plane_i++){
+            internal::add_plane(device, position, scene.plane(plane_i), (int)(scene.num_cylinders + plane_i), node);
+        }
+        return node;
+    }
+    namespace internal{
+        // reciprocal that stays finite for (near) axis-parallel rays: the resulting entry/exit distances are huge instead of inf/nan
+        template <typename T>
+        RL_TOOLS_FUNCTION_PLACEMENT T safe_reciprocal(T x){
+            constexpr T EPSILON = (T)1e-6;
+            return (T)1 / (x >= 0 ? (x < EPSILON ? EPSILON : x) : (x > -EPSILON ? -EPSILON : x));
+        }
+        template <typename DEVICE, typename T, typename TI>
+        RL_TOOLS_FUNCTION_PLACEMENT void raycast(DEVICE& device, const T origin[3], const T* direction_x, const T* direction_y, const T* direction_z, TI N, const Cylinder& cylinder, T max_range, T* ranges){
+            const T px = origin[0] - (T)cylinder.x;
+            const T py = origin[1] - (T)cylinder.y;
+            const T radius_sq = (T)cylinder.radius * (T)cylinder.radius;
+            const T pz = origin[2];
+            const T z_min = cylinder.z_min;
+            const T z_max = cylinder.z_max;
+            const T c = px * px + py * py - radius_sq;
+            // zero if the origin is inside of the pipe (selecting on a loop invariant bool would prevent the vectorization)
+            const T t_miss = c <= 0 && pz >= z_min && pz <= z_max ? (T)0 : max_range;
+            for(TI ray_i = 0; ray_i < N; ray_i++){
+                const T dx = direction_x[ray_i];
+                const T dy = direction_y[ray_i];
+                const T dz = direction_z[ray_i];
+                // mantle: |(p + t d)_xy|^2 = r^2, entering root
+                const T a = dx * dx + dy * dy;
+                const T b = px * dx + py * dy;
+                const T discriminant = b * b - a * c;
+                const T t_side = (-b - math::sqrt(device.math, math::max(device.math, discriminant, (T)0))) / math::max(device.math, a, (T)1e-12);
+                const T z_side = pz + t_side * dz;
+                const bool side_hit = (discriminant >= 0) & (a > (T)1e-12) & (t_side >= 0) & (z_side >= z_min) & (z_side <= z_max);
+                // caps
+                const T inverse_dz = safe_reciprocal(dz);
+                const T t_bottom = (z_min - pz) * inverse_dz;
+                const T t_top = (z_max - pz) * inverse_dz;
+                const T xb = px + t_bottom * dx, yb = py + t_bottom * dy;
+                const T xt = px + t_top * dx, yt = py + t_top * dy;
+                const bool bottom_hit = (t_bottom >= 0) & (xb * xb + yb * yb <= radius_sq);
+                const bool top_hit = (t_top >= 0) & (xt * xt + yt * yt <= radius_sq);
+                T t = side_hit ? t_side : t_miss;
+                t = bottom_hit & (t_bottom < t) ? t_bottom : t;
+                t = top_hit & (t_top < t) ? t_top : t;
+                t = t < t_miss ? t : t_miss;
+                ranges[ray_i] = t < ranges[ray_i] ? t : ranges[ray_i];
+            }
+        }
+        template <typename DEVICE, typename T, typename TI>
+        RL_TOOLS_FUNCTION_PLACEMENT void raycast(DEVICE& device, const T origin[3], const T* direction_x, const T* direction_y, const T* direction_z, TI N, const Plane& plane, T max_range, T* ranges){
+            // the wall is the intersection of the slab |n.(p - p0)| <= thickness with its bounding box: clip the ray against all four slabs
+            const T lower[3] = {(T)plane.x_min, (T)plane.y_min, (T)plane.z_min};
+            const T upper[3] = {(T)plane.x_max, (T)plane.y_max, (T)plane.z_max};
+            const T normal[3] = {(T)plane.normal_x, (T)plane.normal_y, (T)plane.normal_z};
+            const T thickness = plane.thickness;
+            const T offset = (origin[0] - (T)plane.point_x) * normal[0] + (origin[1] - (T)plane.point_y) * normal[1] + (origin[2] - (T)plane.point_z) * normal[2];
+            for(TI ray_i = 0; ray_i < N; ray_i++){
+                const T direction[3] = {direction_x[ray_i], direction_y[ray_i], direction_z[ray_i]};
+                T t_enter = 0;
+                T t_exit = max_range;
+                for(TI axis_i = 0; axis_i < 3; axis_i++){
+                    const T inverse = safe_reciprocal(direction[axis_i]);
+                    const T t_0 = (lower[axis_i] - origin[axis_i]) * inverse;
+                    const T t_1 = (upper[axis_i] - origin[axis_i]) * inverse;
+                    t_enter = math::max(device.math, t_enter, math::min(device.math, t_0, t_1));
+                    t_exit = math::min(device.math, t_exit, math::max(device.math, t_0, t_1));
+                }
+                const T inverse = safe_reciprocal(direction[0] * normal[0] + direction[1] * normal[1] + direction[2] * normal[2]);
+                const T t_0 = (-thickness - offset) * inverse;
+                const T t_1 = (thickness - offset) * inverse;
+                t_enter = math::max(device.math, t_enter, math::min(device.math, t_0, t_1));
+                t_exit = math::min(device.math, t_exit, math::max(device.math, t_0, t_1));
+                const bool hit = t_enter <= t_exit;
+                ranges[ray_i] = hit & (t_enter < ranges[ray_i]) ? t_enter : ranges[ray_i];
+            }
+        }
+    }
+    // Casts N rays from origin and writes the distance to the first obstacle surface along each of them into ranges (at most
+    // max_range, zero if the origin is inside of an obstacle). The directions (unit length) are passed as structure of arrays
+    // and the rays form the inner loop: per obstacle the same branch-free arithmetic is applied to all rays, which the
+    // compiler vectorizes (the selects become blends).
+    template <typename DEVICE, typename T, typename TI, typename SCENE>
+    RL_TOOLS_FUNCTION_PLACEMENT void raycast(DEVICE& device, const T origin[3], const T* direction_x, const T* direction_y, const T* direction_z, TI N, const SCENE& scene, T max_range, T* ranges){
+        for(TI ray_i = 0; ray_i < N; ray_i++){
+            ranges[ray_i] = max_range;
+        }
+        for(size_t obstacle_i = 0; obstacle_i < scene.num_cylinders; obstacle_i++){
+            internal::raycast(device, origin, direction_x, direction_y, direction_z, N, scene.cylinder(obstacle_i), max_range, ranges);
+        }
+        for(size_t plane_i = 0; plane_i < scene.num_planes; plane_i++){
+            internal::raycast(device, origin, direction_x, direction_y, direction_z, N, scene.plane(plane_i), max_range, ranges);
+        }
+    }
+    // bounds of the obstacle course including the danger zones
+    template <typename T, typename CYLINDER, typename PLANE>
+    void bounds(const CYLINDER* cylinders, size_t num_cylinders, const PLANE* planes, size_t num_planes, T lower[3], T upper[3]){
+        for(size_t i = 0; i < 3; i++){
+            lower[i] = 0;
+            upper[i] = 0;
+        }
+        bool first = true;
+        auto extend = [&](T lo[3], T hi[3]){
+            for(size_t i = 0; i < 3; i++){
+                lower[i] = first || lo[i] < lower[i] ? lo[i] : lower[i];
+                upper[i] = first || hi[i] > upper[i] ? hi[i] : upper[i];
+            }
+            first = false;
+        };
+        for(size_t obstacle_i = 0; obstacle_i < num_cylinders; obstacle_i++){
+            const CYLINDER& c = cylinders[obstacle_i];
+            T reach = (T)c.radius * (T)CYLINDER_DANGER_ZONE_FACTOR;
+            T lo[3] = {(T)c.x - reach, (T)c.y - reach, (T)c.z_min};
+            T hi[3] = {(T)c.x + reach, (T)c.y + reach, (T)c.z_max};
+            extend(lo, hi);
+        }
+        for(size_t plane_i = 0; plane_i < num_planes; plane_i++){
+            const PLANE& p = planes[plane_i];
+            T lo[3] = {(T)p.x_min, (T)p.y_min, (T)p.z_min};
+            T hi[3] = {(T)p.x_max, (T)p.y_max, (T)p.z_max};
+            extend(lo, hi);
+        }
+    }
+}
+
+namespace rl_tools{
+    template <typename DEVICE, typename T>
+    void malloc(DEVICE& device, rl::environments::multirotor::obstacles::Field<T>& field){
+        field.nodes = new rl::environments::multirotor::obstacles::Node<T>[field.size[0] * field.size[1] * field.size[2]];
+    }
+    template <typename DEVICE, typename T>
+    void free(DEVICE& device, rl::environments::multirotor::obstacles::Field<T>& field){
+        delete[] field.nodes;
+        field.nodes = nullptr;
+    }
+    // Samples the obstacle course on a grid with the given spacing that covers the obstacles, their danger zones and a margin.
+    // Allocates the field (free it with free(device, field)).
+    template <typename DEVICE, typename T, typename CYLINDER, typename PLANE>
+    void bake(DEVICE& device, rl::environments::multirotor::obstacles::Field<T>& field, const CYLINDER* cylinders, size_t num_cylinders, const PLANE* planes, size_t num_planes, T spacing, T margin){
+        namespace obstacles = rl::environments::multirotor::obstacles;
+        T lower[3], upper[3];
+        obstacles::bounds(cylinders, num_cylinders, planes, num_planes, lower, upper);
+        field.spacing = spacing;
+        for(size_t i = 0; i < 3; i++){
+            // two extra cells so that the outermost nodes are outside of all danger zones
+            field.origin[i] = lower[i] - margin - 2 * spacing;
+            field.size[i] = (size_t)((upper[i] + margin + 2 * spacing - field.origin[i]) / spacing) + 2;
+        }
+        malloc(device, field);
+        for(size_t x_i = 0; x_i < field.size[0]; x_i++){
+            for(size_t y_i = 0; y_i < field.size[1]; y_i++){
+                for(size_t z_i = 0; z_i < field.size[2]; z_i++){
+                    T position[3] = {field.origin[0] + x_i * spacing, field.origin[1] + y_i * spacing, field.origin[2] + z_i * spacing};
+                    field.nodes[(x_i * field.size[1] + y_i) * field.size[2] + z_i] = obstacles::evaluate(device, position, cylinders, num_cylinders, planes, num_planes);
+                }
+            }
+        }
+    }
+    template <typename DEVICE, typename T>
+    void bake(DEVICE& device, rl::environments::multirotor::obstacles::Field<T>& field, const rl::environments::multirotor::obstacles::Scene& scene, T spacing, T margin){
+        bake(device, field, scene.cylinders, scene.num_cylinders, scene.planes, scene.num_planes, spacing, margin);
+    }
+    // Trilinear lookup of distance, penalty and the distance gradient (the nearest obstacle is taken from the closest node). Outside of the baked volume there are no danger zones:
+    // the penalty is zero and the distance is a lower bound of the true distance (all obstacles are inside of the volume).
+    template <typename DEVICE, typename T>
+    RL_TOOLS_FUNCTION_PLACEMENT rl::environments::multirotor::obstacles::Sample<T> query(DEVICE& device, const rl::environments::multirotor::obstacles::Field<T>& field, const T position[3]){
+        using Node = rl::environments::multirotor::obstacles::Node<T>;
+        rl::environments::multirotor::obstacles::Sample<T> sample;
+        size_t base[3];
+        T fraction[3];
+        T outside[3];
+        T outside_distance_sq = 0;
+        for(size_t i = 0; i < 3; i++){
+            T upper = field.origin[i] + (field.size[i] - 1) * field.spacing;
+            T clamped = math::clamp(device.math, position[i], field.origin[i], upper);
+            outside[i] = position[i] - clamped;
+            outside_distance_sq += outside[i] * outside[i];
+            T coordinate = (clamped - field.origin[i]) / field.spacing;
+            // coordinate >= 0, hence the truncation is the floor
+            base[i] = (size_t)coordinate;
+            base[i] = base[i] > field.size[i] - 2 ? field.size[i] - 2 : base[i];
+            fraction[i] = coordinate - (T)base[i];
+        }
+        const size_t stride_x = field.size[1] * field.size[2];
+        const size_t stride_y = field.size[2];
+        const Node* n = field.nodes + base[0] * stride_x + base[1] * stride_y + base[2];
+        const Node& n000 = n[0];
+        const Node& n001 = n[1];
+        const Node& n010 = n[stride_y];
+        const Node& n011 = n[stride_y + 1];
+        const Node& n100 = n[stride_x];
+        const Node& n101 = n[stride_x + 1];
+        const Node& n110 = n[stride_x + stride_y];
+        const Node& n111 = n[stride_x + stride_y + 1];
+        T fx = fraction[0], fy = fraction[1], fz = fraction[2];
+        auto lerp = [](T a, T b, T f){ return a + (b - a) * f; };
+        // distance and its analytic trilinear gradient
+        T d00 = lerp(n000.distance, n001.distance, fz);
+        T d01 = lerp(n010.distance, n011.distance, fz);
+        T d10 = lerp(n100.distance, n101.distance, fz);
+        T d11 = lerp(n110.distance, n111.distance, fz);
+        T d0 = lerp(d00, d01, fy);
+        T d1 = lerp(d10, d11, fy);
+        T distance = lerp(d0, d1, fx);
+        sample.gradient[0] = (d1 - d0) / field.spacing;
+        sample.gradient[1] = lerp(d01 - d00, d11 - d10, fx) / field.spacing;
+        sample.gradient[2] = lerp(lerp(n001.distance - n000.distance, n011.distance - n010.distance, fy), lerp(n101.distance - n100.distance, n111.distance - n110.distance, fy), fx) / field.spacing;
+        sample.nearest = n[(fx >= (T)0.5 ? stride_x : 0) + (fy >= (T)0.5 ? stride_y : 0) + (fz >= (T)0.5 ? 1 : 0)].nearest;
+        if(outside_distance_sq > 0){
+            T outside_distance = math::sqrt(device.math, outside_distance_sq);
+            sample.distance = math::max(device.math, outside_distance, distance - outside_distance);
+            sample.penalty = 0;
+            for(size_t i = 0; i < 3; i++){
+                sample.gradient[i] = outside[i] / outside_distance;
+            }
+        }
+        else{
+            sample.distance = distance;
+            T p00 = lerp(n000.penalty, n001.penalty, fz);
+            T p01 = lerp(n010.penalty, n011.penalty, fz);
+            T p10 = lerp(n100.penalty, n101.penalty, fz);
+            T p11 = lerp(n110.penalty, n111.penalty, fz);
+            sample.penalty = lerp(lerp(p00, p01, fy), lerp(p10, p11, fy), fx);
+        }
+        return sample;
+    }
+}
+
+#endif
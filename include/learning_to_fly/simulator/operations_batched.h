@@ -0,0 +1,433 @@
+#ifndef LEARNING_TO_FLY_IN_SECONDS_SIMULATOR_OPERATIONS_BATCHED_H
+#define LEARNING_TO_FLY_IN_SECONDS_SIMULATOR_OPERATIONS_BATCHED_H
+
+#include "operations_generic.h"
+
+// Batched (structure-of-arrays) stepping of BATCH_SIZE multirotors that share the same parameters.
+// Every field is stored as [component][lane] so that all inner loops run over the lane index with unit stride and can be
+// vectorized by the compiler (AVX2: 8 floats, AVX-512: 16 floats per instruction) without resorting to intrinsics.
+// The arithmetic mirrors multirotor_dynamics + rk4 + post_integration from operations_generic.h so that the results match the scalar path.
+// The derived quantities of the state (rotation matrix and obstacle query, cf. update_derived_quantities and update_obstacle_cache)
+// are part of the batch and are refreshed by every step, so that a batch that is stepped repeatedly without being stored stays consistent.
+// All lanes share env.parameters, hence the off-policy runner and the evaluation, whose environments each carry their own
+// parameters (obstacle course, curriculum) and RNG, still step the environments one by one through the scalar step; nothing
+// in the training uses this stepper yet. src/batched_stepping_benchmark.cpp measures it against the scalar step.
+
+namespace rl_tools::rl::environments::multirotor{
+    template <typename STATE>
+    struct StateTraits;
+    template <typename T, typename TI>
+    struct StateTraits<StateBase<T, TI>>{
+        static constexpr bool ROTORS = false;
+        static constexpr bool RANDOM_FORCE = false;
+    };
+    template <typename T, typename TI, typename NEXT_COMPONENT>
+    struct StateTraits<StateRotors<T, TI, NEXT_COMPONENT>>{
+        static constexpr bool ROTORS = true;
+        static constexpr bool RANDOM_FORCE = StateTraits<NEXT_COMPONENT>::RANDOM_FORCE;
+    };
+    template <typename T, typename TI, TI HISTORY_LENGTH, typename NEXT_COMPONENT>
+    struct StateTraits<StateRotorsHistory<T, TI, HISTORY_LENGTH, NEXT_COMPONENT>>: StateTraits<StateRotors<T, TI, NEXT_COMPONENT>>{};
+    template <typename T, typename TI, typename NEXT_COMPONENT>
+    struct StateTraits<StateRandomForce<T, TI, NEXT_COMPONENT>>{
+        static constexpr bool ROTORS = StateTraits<NEXT_COMPONENT>::ROTORS;
+        static constexpr bool RANDOM_FORCE = true;
+    };
+
+    template <typename T_STATE, typename T_STATE::TI T_BATCH_SIZE>
+    struct StateBatched{
+        using STATE = T_STATE;
+        using T = typename STATE::T;
+        using TI = typename STATE::TI;
+        static constexpr TI BATCH_SIZE = T_BATCH_SIZE;
+        static constexpr bool ROTORS = StateTraits<STATE>::ROTORS;
+        static constexpr bool RANDOM_FORCE = StateTraits<STATE>::RANDOM_FORCE;
+        // the integrated part of the state
+        alignas(64) T position[3][BATCH_SIZE];
+        alignas(64) T orientation[4][BATCH_SIZE];
+        alignas(64) T linear_velocity[3][BATCH_SIZE];
+        alignas(64) T angular_velocity[3][BATCH_SIZE];
+        alignas(64) T rpm[ROTORS ? 4 : 1][BATCH_SIZE];
+        // constant during integration
+        alignas(64) T force[RANDOM_FORCE ? 3 : 1][BATCH_SIZE];
+        alignas(64) T torque[RANDOM_FORCE ? 3 : 1][BATCH_SIZE];
+        // derived, refreshed by post_integration_batched (not integrated)
+        alignas(64) T rotation_matrix[3][3][BATCH_SIZE];
+        alignas(64) T obstacle_distance[BATCH_SIZE];
+        int obstacle_id[BATCH_SIZE];
+        bool obstacle_collision[BATCH_SIZE];
+    };
+    template <typename T, typename TI, TI BATCH_SIZE>
+    struct ActionBatched{
+        alignas(64) T rpm[4][BATCH_SIZE];
+    };
+
+    // load / store: convert between the scalar state (array-of-structures) and one lane of the batch
+    template<typename DEVICE, typename T, typename TI, typename BATCH>
+    RL_TOOLS_FUNCTION_PLACEMENT void load(DEVICE& device, const StateBase<T, TI>& state, BATCH& batch, TI lane_i){
+        for(TI i = 0; i < 3; i++){
+            batch.position[i][lane_i] = state.position[i];
+            batch.linear_velocity[i][lane_i] = state.linear_velocity[i];
+            batch.angular_velocity[i][lane_i] = state.angular_velocity[i];
+        }
+        for(TI i = 0; i < 4; i++){
+            batch.orientation[i][lane_i] = state.orientation[i];
+        }
+        for(TI i = 0; i < 3; i++){
+            for(TI j = 0; j < 3; j++){
+                batch.rotation_matrix[i][j][lane_i] = state.rotation_matrix[i][j];
+            }
+        }
+        batch.obstacle_distance[lane_i] = state.obstacle_distance;
+        batch.obstacle_id[lane_i] = state.obstacle_id;
+        batch.obstacle_collision[lane_i] = state.obstacle_collision;
+    }
+    template<typename DEVICE, typename T, typename TI, typename NEXT_COMPONENT, typename BATCH>
+    RL_TOOLS_FUNCTION_PLACEMENT void load(DEVICE& device, const StateRotors<T, TI, NEXT_COMPONENT>& state, BATCH& batch, TI lane_i){
+        load(device, static_cast<const NEXT_COMPONENT&>(state), batch, lane_i);
+        for(TI i = 0; i < 4; i++){
+            batch.rpm[i][lane_i] = state.rpm[i];
+        }
+    }
+    template<typename DEVICE, typename T, typename TI, TI HISTORY_LENGTH, typename NEXT_COMPONENT, typename BATCH>
+    RL_TOOLS_FUNCTION_PLACEMENT void load(DEVICE& device, const StateRotorsHistory<T, TI, HISTORY_LENGTH, NEXT_COMPONENT>& state, BATCH& batch, TI lane_i){
+        // the action history is not integrated and is updated per lane in post_integration
+        load(device, static_cast<const StateRotors<T, TI, NEXT_COMPONENT>&>(state), batch, lane_i);
+    }
+    template<typename DEVICE, typename T, typename TI, typename NEXT_COMPONENT, typename BATCH>
+    RL_TOOLS_FUNCTION_PLACEMENT void load(DEVICE& device, const StateRandomForce<T, TI, NEXT_COMPONENT>& state, BATCH& batch, TI lane_i){
+        load(device, static_cast<const NEXT_COMPONENT&>(state), batch, lane_i);
+        for(TI i = 0; i < 3; i++){
+            batch.force[i][lane_i] = state.force[i];
+            batch.torque[i][lane_i] = state.torque[i];
+        }
+    }
+    template<typename DEVICE, typename T, typename TI, typename BATCH>
+    RL_TOOLS_FUNCTION_PLACEMENT void store(DEVICE& device, const BATCH& batch, TI lane_i, StateBase<T, TI>& state){
+        for(TI i = 0; i < 3; i++){
+            state.position[i] = batch.position[i][lane_i];
+            state.linear_velocity[i] = batch.linear_velocity[i][lane_i];
+            state.angular_velocity[i] = batch.angular_velocity[i][lane_i];
+        }
+        for(TI i = 0; i < 4; i++){
+            state.orientation[i] = batch.orientation[i][lane_i];
+        }
+        for(TI i = 0; i < 3; i++){
+            for(TI j = 0; j < 3; j++){
+                state.rotation_matrix[i][j] = batch.rotation_matrix[i][j][lane_i];
+            }
+        }
+        state.obstacle_distance = batch.obstacle_distance[lane_i];
+        state.obstacle_id = batch.obstacle_id[lane_i];
+        state.obstacle_collision = batch.obstacle_collision[lane_i];
+    }
+    template<typename DEVICE, typename T, typename TI, typename NEXT_COMPONENT, typename BATCH>
+    RL_TOOLS_FUNCTION_PLACEMENT void store(DEVICE& device, const BATCH& batch, TI lane_i, StateRotors<T, TI, NEXT_COMPONENT>& state){
+        store(device, batch, lane_i, static_cast<NEXT_COMPONENT&>(state));
+        for(TI i = 0; i < 4; i++){
+            state.rpm[i] = batch.rpm[i][lane_i];
+        }
+    }
+    template<typename DEVICE, typename T, typename TI, TI HISTORY_LENGTH, typename NEXT_COMPONENT, typename BATCH>
+    RL_TOOLS_FUNCTION_PLACEMENT void store(DEVICE& device, const BATCH& batch, TI lane_i, StateRotorsHistory<T, TI, HISTORY_LENGTH, NEXT_COMPONENT>& state){
+        store(device, batch, lane_i, static_cast<StateRotors<T, TI, NEXT_COMPONENT>&>(state));
+    }
+    template<typename DEVICE, typename T, typename TI, typename NEXT_COMPONENT, typename BATCH>
+    RL_TOOLS_FUNCTION_PLACEMENT void store(DEVICE& device, const BATCH& batch, TI lane_i, StateRandomForce<T, TI, NEXT_COMPONENT>& state){
+        store(device, batch, lane_i, static_cast<NEXT_COMPONENT&>(state));
+        for(TI i = 0; i < 3; i++){
+            state.force[i] = batch.force[i][lane_i];
+            state.torque[i] = batch.torque[i][lane_i];
+        }
+    }
+
+    // Batched counterpart of multirotor_dynamics. "state" only needs to provide the integrated fields, force and torque are always read from "constant_state"
+    // state_change must not alias the inputs (__restrict): otherwise the compiler does not vectorize the lane loop, which writes
+    // a dozen output arrays while reading the inputs
+    template<bool INTEGRATE_ROTORS, typename DEVICE, typename PARAMETERS, typename BATCH>
+    RL_TOOLS_FUNCTION_PLACEMENT void multirotor_dynamics_batched(DEVICE& device, const PARAMETERS& params, const BATCH& constant_state, const BATCH& state, const ActionBatched<typename BATCH::T, typename BATCH::TI, BATCH::BATCH_SIZE>& action, BATCH& __restrict state_change){
+        using T = typename BATCH::T;
+        using TI = typename BATCH::TI;
+        constexpr TI BATCH_SIZE = BATCH::BATCH_SIZE;
+        const auto& dynamics = params.dynamics;
+        const auto& wrench = dynamics.wrench_mixing;
+        const T c0 = dynamics.thrust_constants[0];
+        const T c1 = dynamics.thrust_constants[1];
+        const T c2 = dynamics.thrust_constants[2];
+        const T mass_inv = 1 / dynamics.mass;
+        const T rpm_time_constant_inv = 1 / dynamics.rpm_time_constant;
+        T J[3][3], J_inv[3][3];
+        for(TI i = 0; i < 3; i++){
+            for(TI j = 0; j < 3; j++){
+                J[i][j] = dynamics.J[i][j];
+                J_inv[i][j] = dynamics.J_inv[i][j];
+            }
+        }
+        const T (*rpm)[BATCH_SIZE] = BATCH::ROTORS ? state.rpm : action.rpm;
+        for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+            T f[3] = {0, 0, 0};
+            T tau[3] = {0, 0, 0};
+            for(TI rotor_i = 0; rotor_i < 4; rotor_i++){
+                T r = rpm[rotor_i][lane_i];
+                T thrust_magnitude = c0 + c1 * r + c2 * r * r;
+                for(TI i = 0; i < 3; i++){
+                    f[i] += wrench[0 + i][rotor_i] * thrust_magnitude;
+                    tau[i] += wrench[3 + i][rotor_i] * thrust_magnitude;
+                }
+            }
+            T qw = state.orientation[0][lane_i];
+            T qx = state.orientation[1][lane_i];
+            T qy = state.orientation[2][lane_i];
+            T qz = state.orientation[3][lane_i];
+            T wx = state.angular_velocity[0][lane_i];
+            T wy = state.angular_velocity[1][lane_i];
+            T wz = state.angular_velocity[2][lane_i];
+
+            state_change.position[0][lane_i] = state.linear_velocity[0][lane_i];
+            state_change.position[1][lane_i] = state.linear_velocity[1][lane_i];
+            state_change.position[2][lane_i] = state.linear_velocity[2][lane_i];
+
+            // quaternion_derivative
+            state_change.orientation[0][lane_i] = (-qx*wx - qy*wy - qz*wz) * (T)0.5;
+            state_change.orientation[1][lane_i] = ( qw*wx + qy*wz - qz*wy) * (T)0.5;
+            state_change.orientation[2][lane_i] = ( qw*wy + qz*wx - qx*wz) * (T)0.5;
+            state_change.orientation[3][lane_i] = ( qw*wz + qx*wy - qy*wx) * (T)0.5;
+
+            // rotate_vector_by_quaternion
+            T v0 = 2 * (qy*f[2] - qz*f[1]);
+            T v1 = 2 * (qz*f[0] - qx*f[2]);
+            T v2 = 2 * (qx*f[1] - qy*f[0]);
+            T a0 = qy*v2 - qz*v1 + qw*v0 + f[0];
+            T a1 = qz*v0 - qx*v2 + qw*v1 + f[1];
+            T a2 = qx*v1 - qy*v0 + qw*v2 + f[2];
+            state_change.linear_velocity[0][lane_i] = a0 * mass_inv + dynamics.gravity[0];
+            state_change.linear_velocity[1][lane_i] = a1 * mass_inv + dynamics.gravity[1];
+            state_change.linear_velocity[2][lane_i] = a2 * mass_inv + dynamics.gravity[2];
+
+            // J_inv * (torque - omega x (J * omega))
+            T Jw0 = J[0][0]*wx + J[0][1]*wy + J[0][2]*wz;
+            T Jw1 = J[1][0]*wx + J[1][1]*wy + J[1][2]*wz;
+            T Jw2 = J[2][0]*wx + J[2][1]*wy + J[2][2]*wz;
+            T m0 = tau[0] - (wy*Jw2 - wz*Jw1);
+            T m1 = tau[1] - (wz*Jw0 - wx*Jw2);
+            T m2 = tau[2] - (wx*Jw1 - wy*Jw0);
+            if constexpr(BATCH::RANDOM_FORCE){
+                state_change.linear_velocity[0][lane_i] += constant_state.force[0][lane_i] * mass_inv;
+                state_change.linear_velocity[1][lane_i] += constant_state.force[1][lane_i] * mass_inv;
+                state_change.linear_velocity[2][lane_i] += constant_state.force[2][lane_i] * mass_inv;
+                m0 += constant_state.torque[0][lane_i];
+                m1 += constant_state.torque[1][lane_i];
+                m2 += constant_state.torque[2][lane_i];
+            }
+            state_change.angular_velocity[0][lane_i] = J_inv[0][0]*m0 + J_inv[0][1]*m1 + J_inv[0][2]*m2;
+            state_change.angular_velocity[1][lane_i] = J_inv[1][0]*m0 + J_inv[1][1]*m1 + J_inv[1][2]*m2;
+            state_change.angular_velocity[2][lane_i] = J_inv[2][0]*m0 + J_inv[2][1]*m1 + J_inv[2][2]*m2;
+        }
+        if constexpr(BATCH::ROTORS && INTEGRATE_ROTORS){
+            for(TI rotor_i = 0; rotor_i < 4; rotor_i++){
+                for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+                    state_change.rpm[rotor_i][lane_i] = (action.rpm[rotor_i][lane_i] - state.rpm[rotor_i][lane_i]) * rpm_time_constant_inv;
+                }
+            }
+        }
+    }
+
+    // the action history is not part of the batch, it is shifted per lane after the batch has been stored
+    template<typename DEVICE, typename SPEC, typename STATE, typename ACTION_SPEC>
+    RL_TOOLS_FUNCTION_PLACEMENT void post_integration_history(DEVICE& device, const Multirotor<SPEC>& env, const STATE& state, const Matrix<ACTION_SPEC>& action, STATE& next_state){ }
+    template<typename DEVICE, typename SPEC, typename T, typename TI, TI HISTORY_LENGTH, typename NEXT_COMPONENT, typename ACTION_SPEC>
+    RL_TOOLS_FUNCTION_PLACEMENT void post_integration_history(DEVICE& device, const Multirotor<SPEC>& env, const StateRotorsHistory<T, TI, HISTORY_LENGTH, NEXT_COMPONENT>& state, const Matrix<ACTION_SPEC>& action, StateRotorsHistory<T, TI, HISTORY_LENGTH, NEXT_COMPONENT>& next_state){
+        push_action_history(device, state, action, next_state);
+    }
+
+    // out = a + scalar * b over all integrated fields
+    template<bool INTEGRATE_ROTORS, typename DEVICE, typename BATCH, typename T>
+    RL_TOOLS_FUNCTION_PLACEMENT void multiply_add_batched(DEVICE& device, const BATCH& a, T scalar, const BATCH& b, BATCH& out){
+        using TI = typename BATCH::TI;
+        constexpr TI BATCH_SIZE = BATCH::BATCH_SIZE;
+        for(TI i = 0; i < 3; i++){
+            for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+                out.position[i][lane_i] = a.position[i][lane_i] + scalar * b.position[i][lane_i];
+                out.linear_velocity[i][lane_i] = a.linear_velocity[i][lane_i] + scalar * b.linear_velocity[i][lane_i];
+                out.angular_velocity[i][lane_i] = a.angular_velocity[i][lane_i] + scalar * b.angular_velocity[i][lane_i];
+            }
+        }
+        for(TI i = 0; i < 4; i++){
+            for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+                out.orientation[i][lane_i] = a.orientation[i][lane_i] + scalar * b.orientation[i][lane_i];
+            }
+        }
+        if constexpr(BATCH::ROTORS && INTEGRATE_ROTORS){
+            for(TI i = 0; i < 4; i++){
+                for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+                    out.rpm[i][lane_i] = a.rpm[i][lane_i] + scalar * b.rpm[i][lane_i];
+                }
+            }
+        }
+    }
+    // quaternion normalization, rotor speed clamping and the derived quantities (cf. post_integration), applied after every (sub-)step
+    template<typename DEVICE, typename SPEC, typename BATCH>
+    RL_TOOLS_FUNCTION_PLACEMENT void post_integration_batched(DEVICE& device, const Multirotor<SPEC>& env, BATCH& next_state){
+        using T = typename BATCH::T;
+        using TI = typename BATCH::TI;
+        constexpr TI BATCH_SIZE = BATCH::BATCH_SIZE;
+        for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+            T quaternion_norm = 0;
+            for(TI i = 0; i < 4; i++){
+                quaternion_norm += next_state.orientation[i][lane_i] * next_state.orientation[i][lane_i];
+            }
+            quaternion_norm = math::sqrt(device.math, quaternion_norm);
+            for(TI i = 0; i < 4; i++){
+                next_state.orientation[i][lane_i] /= quaternion_norm;
+            }
+        }
+        // quaternion_to_rotation_matrix
+        auto& R = next_state.rotation_matrix;
+        for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+            T qw = next_state.orientation[0][lane_i];
+            T qx = next_state.orientation[1][lane_i];
+            T qy = next_state.orientation[2][lane_i];
+            T qz = next_state.orientation[3][lane_i];
+            R[0][0][lane_i] = 1 - 2*qy*qy - 2*qz*qz;
+            R[0][1][lane_i] = 2*qx*qy - 2*qw*qz;
+            R[0][2][lane_i] = 2*qx*qz + 2*qw*qy;
+            R[1][0][lane_i] = 2*qx*qy + 2*qw*qz;
+            R[1][1][lane_i] = 1 - 2*qx*qx - 2*qz*qz;
+            R[1][2][lane_i] = 2*qy*qz - 2*qw*qx;
+            R[2][0][lane_i] = 2*qx*qz - 2*qw*qy;
+            R[2][1][lane_i] = 2*qy*qz + 2*qw*qx;
+            R[2][2][lane_i] = 1 - 2*qx*qx - 2*qy*qy;
+        }
+        // the obstacle query is not vectorized (query_obstacles is found through ADL, cf. update_obstacle_cache)
+        for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+            T position[3] = {next_state.position[0][lane_i], next_state.position[1][lane_i], next_state.position[2][lane_i]};
+            auto obstacle = query_obstacles(device, env.parameters.mdp.reward, position);
+            next_state.obstacle_distance[lane_i] = obstacle.distance;
+            next_state.obstacle_id[lane_i] = obstacle.nearest;
+            next_state.obstacle_collision[lane_i] = obstacle.distance < 0;
+        }
+        if constexpr(BATCH::ROTORS){
+            for(TI i = 0; i < 4; i++){
+                for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+                    next_state.rpm[i][lane_i] = math::clamp(typename DEVICE::SPEC::MATH{}, next_state.rpm[i][lane_i], env.parameters.dynamics.action_limit.min, env.parameters.dynamics.action_limit.max);
+                }
+            }
+        }
+    }
+    // out = setpoint + (state - setpoint) * decay, the exact solution of the rotor lag (cf. rotor_speeds_closed_form)
+    template<typename DEVICE, typename BATCH, typename T>
+    RL_TOOLS_FUNCTION_PLACEMENT void rotor_speeds_closed_form_batched(DEVICE& device, const BATCH& state, const ActionBatched<typename BATCH::T, typename BATCH::TI, BATCH::BATCH_SIZE>& action, T decay, BATCH& out){
+        using TI = typename BATCH::TI;
+        for(TI rotor_i = 0; rotor_i < 4; rotor_i++){
+            for(TI lane_i = 0; lane_i < BATCH::BATCH_SIZE; lane_i++){
+                out.rpm[rotor_i][lane_i] = action.rpm[rotor_i][lane_i] + (state.rpm[rotor_i][lane_i] - action.rpm[rotor_i][lane_i]) * decay;
+            }
+        }
+    }
+    // classic RK4: next = state + dt/6 * (k1 + 2*k2 + 2*k3 + k4)
+    // With CLOSED_FORM_ROTOR_DELAY the rotor speeds of the stages are set from the exact solution instead of being integrated
+    template<bool CLOSED_FORM_ROTOR_DELAY, typename DEVICE, typename PARAMETERS, typename BATCH>
+    RL_TOOLS_FUNCTION_PLACEMENT void rk4_batched(DEVICE& device, const PARAMETERS& params, const BATCH& state, const ActionBatched<typename BATCH::T, typename BATCH::TI, BATCH::BATCH_SIZE>& action, typename BATCH::T dt, BATCH& next_state){
+        using T = typename BATCH::T;
+        constexpr bool CLOSED_FORM = CLOSED_FORM_ROTOR_DELAY && BATCH::ROTORS;
+        constexpr bool INTEGRATE_ROTORS = !CLOSED_FORM;
+        T decay_half = 0;
+        if constexpr(CLOSED_FORM){
+            decay_half = math::exp(device.math, -dt / (2 * params.dynamics.rpm_time_constant));
+        }
+        BATCH k, var, acc;
+        multirotor_dynamics_batched<INTEGRATE_ROTORS>(device, params, state, state, action, k);   // k1
+        multiply_add_batched<INTEGRATE_ROTORS>(device, state, dt/6, k, acc);
+        multiply_add_batched<INTEGRATE_ROTORS>(device, state, dt/2, k, var);
+        if constexpr(CLOSED_FORM){
+            rotor_speeds_closed_form_batched(device, state, action, decay_half, var);
+        }
+        multirotor_dynamics_batched<INTEGRATE_ROTORS>(device, params, state, var, action, k);     // k2
+        multiply_add_batched<INTEGRATE_ROTORS>(device, acc, dt/3, k, acc);
+        multiply_add_batched<INTEGRATE_ROTORS>(device, state, dt/2, k, var);
+        multirotor_dynamics_batched<INTEGRATE_ROTORS>(device, params, state, var, action, k);     // k3 (var.rpm is still at t + dt/2)
+        multiply_add_batched<INTEGRATE_ROTORS>(device, acc, dt/3, k, acc);
+        multiply_add_batched<INTEGRATE_ROTORS>(device, state, dt, k, var);
+        if constexpr(CLOSED_FORM){
+            rotor_speeds_closed_form_batched(device, state, action, decay_half * decay_half, var);
+        }
+        multirotor_dynamics_batched<INTEGRATE_ROTORS>(device, params, state, var, action, k);     // k4
+        multiply_add_batched<INTEGRATE_ROTORS>(device, acc, dt/6, k, next_state);
+        if constexpr(CLOSED_FORM){
+            rotor_speeds_closed_form_batched(device, state, action, decay_half * decay_half, next_state);
+        }
+        if constexpr(BATCH::RANDOM_FORCE){
+            for(typename BATCH::TI i = 0; i < 3; i++){
+                for(typename BATCH::TI lane_i = 0; lane_i < BATCH::BATCH_SIZE; lane_i++){
+                    next_state.force[i][lane_i] = state.force[i][lane_i];
+                    next_state.torque[i][lane_i] = state.torque[i][lane_i];
+                }
+            }
+        }
+    }
+}
+
+namespace rl_tools{
+    // Steps a batch that lives in the structure-of-arrays layout. Row i of "action" is the normalized action of lane i.
+    // The action history (StateRotorsHistory) is not part of the batch, use the array-of-structures overload below if it is required
+    template<typename DEVICE, typename SPEC, typename STATE, typename STATE::TI BATCH_SIZE, typename ACTION_SPEC, typename RNG>
+    RL_TOOLS_FUNCTION_PLACEMENT static typename SPEC::T step(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::StateBatched<STATE, BATCH_SIZE>& state, const Matrix<ACTION_SPEC>& action, rl::environments::multirotor::StateBatched<STATE, BATCH_SIZE>& next_state, RNG& rng){
+        using T = typename SPEC::T;
+        using TI = typename DEVICE::index_t;
+        using BATCH = rl::environments::multirotor::StateBatched<STATE, BATCH_SIZE>;
+        constexpr TI ACTION_DIM = rl::environments::Multirotor<SPEC>::ACTION_DIM;
+        static_assert(ACTION_SPEC::ROWS == BATCH_SIZE);
+        static_assert(ACTION_SPEC::COLS == ACTION_DIM);
+        rl::environments::multirotor::ActionBatched<T, typename STATE::TI, BATCH_SIZE> action_scaled;
+        const T half_range = (env.parameters.dynamics.action_limit.max - env.parameters.dynamics.action_limit.min) / 2;
+        // the action noise of the whole batch is drawn as one block (lane-major)
+        T action_noise[BATCH_SIZE][ACTION_DIM];
+        random::block::normal(device, &action_noise[0][0], BATCH_SIZE * ACTION_DIM, rng);
+        for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+            for(TI action_i = 0; action_i < ACTION_DIM; action_i++){
+                T action_noisy = get(action, lane_i, action_i);
+                action_noisy += env.parameters.mdp.action_noise.normalized_rpm * action_noise[lane_i][action_i];
+                action_noisy = math::clamp(device.math, action_noisy, -(T)1, (T)1);
+                action_scaled.rpm[action_i][lane_i] = action_noisy * half_range + env.parameters.dynamics.action_limit.min + half_range;
+            }
+        }
+        // env.parameters.integration.dt is the control period, the physics are integrated in PHYSICS_SUBSTEPS sub-steps with the same (zero-order hold) action
+        constexpr TI PHYSICS_SUBSTEPS = SPEC::STATIC_PARAMETERS::PHYSICS_SUBSTEPS;
+        static_assert(PHYSICS_SUBSTEPS >= 1);
+        const T dt = env.parameters.integration.dt / PHYSICS_SUBSTEPS;
+        rl::environments::multirotor::rk4_batched<SPEC::STATIC_PARAMETERS::CLOSED_FORM_ROTOR_DELAY>(device, env.parameters, state, action_scaled, dt, next_state);
+        rl::environments::multirotor::post_integration_batched(device, env, next_state);
+        if constexpr(PHYSICS_SUBSTEPS > 1){
+            // a collision at an intermediate sub-step is kept (same as the scalar step)
+            BATCH substep_state;
+            for(TI substep_i = 1; substep_i < PHYSICS_SUBSTEPS; substep_i++){
+                substep_state = next_state;
+                rl::environments::multirotor::rk4_batched<SPEC::STATIC_PARAMETERS::CLOSED_FORM_ROTOR_DELAY>(device, env.parameters, substep_state, action_scaled, dt, next_state);
+                rl::environments::multirotor::post_integration_batched(device, env, next_state);
+                for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+                    next_state.obstacle_collision[lane_i] = next_state.obstacle_collision[lane_i] || substep_state.obstacle_collision[lane_i];
+                }
+            }
+        }
+        return env.parameters.integration.dt;
+    }
+    // Convenience overload for states kept as arrays of structures (e.g. in the off-policy runner): gathers into the batch, steps it, and scatters back.
+    // All lanes use env.parameters, hence this is only equivalent to the scalar step when the environments share their parameters.
+    template<typename DEVICE, typename SPEC, typename STATE, typename STATE::TI BATCH_SIZE, typename ACTION_SPEC, typename RNG>
+    RL_TOOLS_FUNCTION_PLACEMENT static typename SPEC::T step(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const STATE (&state)[BATCH_SIZE], const Matrix<ACTION_SPEC>& action, STATE (&next_state)[BATCH_SIZE], rl::environments::multirotor::StateBatched<STATE, BATCH_SIZE> (&buffer)[2], RNG& rng){
+        using TI = typename STATE::TI;
+        static_assert(utils::typing::is_same_v<STATE, typename rl::environments::Multirotor<SPEC>::State>);
+        for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+            rl::environments::multirotor::load(device, state[lane_i], buffer[0], lane_i);
+        }
+        auto dt = step(device, env, buffer[0], action, buffer[1], rng);
+        for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+            rl::environments::multirotor::store(device, buffer[1], lane_i, next_state[lane_i]);
+            auto lane_action = view(device, action, matrix::ViewSpec<1, ACTION_SPEC::COLS>{}, lane_i, 0);
+            rl::environments::multirotor::post_integration_history(device, env, state[lane_i], lane_action, next_state[lane_i]);
+        }
+        return dt;
+    }
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "operations_generic.h"
+#include "operations_batched.h"
 
 #include <random>
 namespace rl_tools{
@@ -5,6 +5,8 @@
 
 #include <rl_tools/utils/generic/vector_operations.h>
 #include "quaternion_helper.h"
+#include "random_block.h"
+#include "obstacle_field.h"
 
 #include <rl_tools/utils/generic/typing.h>
 
@@ -118,6 +120,36 @@ namespace rl_tools {
 
 
 namespace rl_tools::rl::environments::multirotor {
+    template<typename DEVICE, typename DYNAMICS>
+    RL_TOOLS_FUNCTION_PLACEMENT void update_wrench_mixing(DEVICE& device, DYNAMICS& dynamics){
+        // has to be called whenever parameters are assigned or the rotor geometry or the torque constant changes (the parameter sets
+        // leave it zero). initial_parameters takes care of it at every reset, states that are set directly need an explicit call
+        using T = decltype(dynamics.torque_constant);
+        constexpr auto N = sizeof(dynamics.rotor_positions) / sizeof(dynamics.rotor_positions[0]);
+        for(typename DEVICE::index_t i_rotor = 0; i_rotor < N; i_rotor++){
+            T moment_arm[3];
+            utils::vector_operations::cross_product<DEVICE, T>(dynamics.rotor_positions[i_rotor], dynamics.rotor_thrust_directions[i_rotor], moment_arm);
+            for(typename DEVICE::index_t i = 0; i < 3; i++){
+                dynamics.wrench_mixing[0 + i][i_rotor] = dynamics.rotor_thrust_directions[i_rotor][i];
+                dynamics.wrench_mixing[3 + i][i_rotor] = dynamics.rotor_torque_directions[i_rotor][i] * dynamics.torque_constant + moment_arm[i];
+            }
+        }
+    }
+    template<typename DEVICE, typename T, typename TI>
+    RL_TOOLS_FUNCTION_PLACEMENT void update_derived_quantities(DEVICE& device, StateBase<T, TI>& state){
+        // has to be called whenever the orientation is changed outside of initial_state, sample_initial_state and step
+        quaternion_to_rotation_matrix<DEVICE, T>(state.orientation, state.rotation_matrix);
+    }
+    template<typename DEVICE, typename SPEC, typename T, typename TI>
+    RL_TOOLS_FUNCTION_PLACEMENT void update_obstacle_cache(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, StateBase<T, TI>& state){
+        // The obstacle course is queried once per step here; reward, terminated, metrics and the UI read the cached result.
+        // has to be called whenever the position is changed outside of initial_state, sample_initial_state and step.
+        // query_obstacles is found through ADL at instantiation (cf. parameters/reward_functions/position_to_position.h)
+        auto obstacle = query_obstacles(device, env.parameters.mdp.reward, state.position);
+        state.obstacle_distance = obstacle.distance;
+        state.obstacle_id = obstacle.nearest;
+        state.obstacle_collision = obstacle.distance < 0;
+    }
     template<typename DEVICE, typename T, typename TI, typename PARAMETERS>
     RL_TOOLS_FUNCTION_PLACEMENT void multirotor_dynamics(DEVICE& device, const PARAMETERS& params, const StateBase<T, TI>& state, const T* action, StateBase<T, TI>& state_change) {
         using STATE = StateBase<T, TI>;
@@ -130,17 +162,16 @@ namespace rl_tools::rl::environments::multirotor {
         torque[0] = 0;
         torque[1] = 0;
         torque[2] = 0;
-        // flops: N*23 => 4 * 23 = 92
+        // flops: N*(5 + 12) => 4 * 17 = 68
         for(typename DEVICE::index_t i_rotor = 0; i_rotor < 4; i_rotor++){
-            // flops: 3 + 1 + 3 + 3 + 3 + 4 + 6 = 23
+            // flops: 5
             T rpm = action[i_rotor];
             T thrust_magnitude = params.dynamics.thrust_constants[0] + params.dynamics.thrust_constants[1] * rpm + params.dynamics.thrust_constants[2] * rpm * rpm;
-            T rotor_thrust[3];
-            utils::vector_operations::scalar_multiply<DEVICE, T, 3>(params.dynamics.rotor_thrust_directions[i_rotor], thrust_magnitude, rotor_thrust);
-            utils::vector_operations::add_accumulate<DEVICE, T, 3>(rotor_thrust, thrust);
-
-            utils::vector_operations::scalar_multiply_accumulate<DEVICE, T, 3>(params.dynamics.rotor_torque_directions[i_rotor], thrust_magnitude * params.dynamics.torque_constant, torque);
-            utils::vector_operations::cross_product_accumulate<DEVICE, T>(params.dynamics.rotor_positions[i_rotor], rotor_thrust, torque);
+            // flops: 12
+            for(typename DEVICE::index_t i = 0; i < 3; i++){
+                thrust[i] += params.dynamics.wrench_mixing[0 + i][i_rotor] * thrust_magnitude;
+                torque[i] += params.dynamics.wrench_mixing[3 + i][i_rotor] * thrust_magnitude;
+            }
         }
 
         // linear_velocity_global
@@ -170,7 +201,7 @@ namespace rl_tools::rl::environments::multirotor {
         utils::vector_operations::sub<DEVICE, T, 3>(torque, vector2, vector);
         // flops: 9
         utils::vector_operations::matrix_vector_product<DEVICE, T, 3, 3>(params.dynamics.J_inv, vector, state_change.angular_velocity);
-        // total flops: (quadrotor): 92 + 16 + 21 + 4 + 9 + 6 + 9 = 157
+        // total flops: (quadrotor): 68 + 16 + 21 + 4 + 9 + 6 + 9 = 133
 //        multirotor_dynamics<DEVICE, T, TI, PARAMETERS>(device, params, (const typename STATE::LATENT_STATE&)state, action, state_change);
 //        multirotor_dynamics(device, params, (const typename STATE::LATENT_STATE&)state, action, state_change);
     }
@@ -225,6 +256,7 @@ namespace rl_tools{
 //        T mass_factor = random::uniform_real_distribution(random_dev, (T)0.5, (T)1.5, rng);
 //        env.current_dynamics.mass *= mass_factor;
 //        printf("initial state: %f %f %f %f %f %f %f %f %f %f %f %f %f\n", state.state[0], state.state[1], state.state[2], state.state[3], state.state[4], state.state[5], state.state[6], state.state[7], state.state[8], state.state[9], state.state[10], state.state[11], state.state[12]);
+        rl::environments::multirotor::update_wrench_mixing(device, env.parameters.dynamics);
         env.current_dynamics = env.parameters.dynamics;
     }
     template<typename DEVICE, typename T, typename TI, typename SPEC>
@@ -243,6 +275,8 @@ namespace rl_tools{
         for(typename DEVICE::index_t i = 0; i < 3; i++){
             state.angular_velocity[i] = 0;
         }
+        rl::environments::multirotor::update_derived_quantities(device, state);
+        rl::environments::multirotor::update_obstacle_cache(device, env, state);
         initial_parameters(device, env, state);
     }
     template<typename DEVICE, typename T, typename TI, typename SPEC, typename NEXT_COMPONENT>
@@ -272,6 +306,7 @@ namespace rl_tools{
                 state.action_history[step_i][action_i] = (state.rpm[action_i] - env.parameters.dynamics.action_limit.min) / (env.parameters.dynamics.action_limit.max - env.parameters.dynamics.action_limit.min) * 2 - 1;
             }
         }
+        state.action_history_head = 0;
     }
     template<typename DEVICE, typename T, typename TI, typename SPEC, typename RNG, bool INHERIT_GUIDANCE = false>
     RL_TOOLS_FUNCTION_PLACEMENT static void sample_initial_state(DEVICE& device, rl::environments::Multirotor<SPEC>& env, typename rl::environments::multirotor::StateBase<T, TI>& state, RNG& rng, bool inherited_guidance = false){
@@ -315,6 +350,10 @@ namespace rl_tools{
         for(TI i = 0; i < 3; i++){
             state.angular_velocity[i] = random::uniform_real_distribution(random_dev, -env.parameters.mdp.init.max_angular_velocity, env.parameters.mdp.init.max_angular_velocity, rng);
         }
+        rl::environments::multirotor::update_derived_quantities(device, state);
+        // procedural obstacle courses are redrawn per episode, keeping the spawn position and the target clear (found through ADL, cf. parameters/reward_functions/position_to_position.h)
+        sample_obstacle_course(device, env.parameters.mdp.reward, state.position, rng);
+        rl::environments::multirotor::update_obstacle_cache(device, env, state);
         initial_parameters(device, env, state);
     }
     template<typename DEVICE, typename T_S, typename TI_S, typename SPEC, typename NEXT_COMPONENT, typename RNG>
@@ -324,17 +363,19 @@ namespace rl_tools{
 //        bool guidance = random::uniform_real_distribution(random_dev, (T)0, (T)1, rng) < env.parameters.mdp.init.guidance;
         sample_initial_state(device, env, static_cast<NEXT_COMPONENT&>(state), rng);
 //        if(!guidance){
+        T disturbance[6];
+        random::block::normal(device, disturbance, (TI_S)6, rng);
         {
             auto distribution = env.parameters.disturbances.random_force;
-            state.force[0] = random::normal_distribution::sample(random_dev, (T)distribution.mean, (T)distribution.std, rng);
-            state.force[1] = random::normal_distribution::sample(random_dev, (T)distribution.mean, (T)distribution.std, rng);
-            state.force[2] = random::normal_distribution::sample(random_dev, (T)distribution.mean, (T)distribution.std, rng);
+            for(TI_S i = 0; i < 3; i++){
+                state.force[i] = (T)distribution.mean + (T)distribution.std * disturbance[i];
+            }
         }
         {
             auto distribution = env.parameters.disturbances.random_torque;
-            state.torque[0] = random::normal_distribution::sample(random_dev, (T)distribution.mean, (T)distribution.std, rng);
-            state.torque[1] = random::normal_distribution::sample(random_dev, (T)distribution.mean, (T)distribution.std, rng);
-            state.torque[2] = random::normal_distribution::sample(random_dev, (T)distribution.mean, (T)distribution.std, rng);
+            for(TI_S i = 0; i < 3; i++){
+                state.torque[i] = (T)distribution.mean + (T)distribution.std * disturbance[3 + i];
+            }
         }
 //        }
 //        else{
@@ -379,162 +420,138 @@ namespace rl_tools{
                 state.action_history[step_i][action_i] = (state.rpm[action_i] - env.parameters.dynamics.action_limit.min) / (env.parameters.dynamics.action_limit.max - env.parameters.dynamics.action_limit.min) * 2 - 1;
             }
         }
+        state.action_history_head = 0;
     }
     namespace rl::environments::multirotor{
-        template<typename DEVICE, typename SPEC, typename STATE, typename OBSERVATION_TI, typename OBS_SPEC, typename RNG>
-        RL_TOOLS_FUNCTION_PLACEMENT static void observe(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const STATE& state, rl::environments::multirotor::observation::LastComponent<OBSERVATION_TI>, Matrix<OBS_SPEC>& observation, RNG& rng){
-            static_assert(OBS_SPEC::COLS == 0);
-            static_assert(OBS_SPEC::ROWS == 1);
-        }
-        template<typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC, typename RNG>
-        RL_TOOLS_FUNCTION_PLACEMENT static void observe(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::Position<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, RNG& rng){
-            using OBSERVATION = rl::environments::multirotor::observation::Position<OBSERVATION_SPEC>;
-            static_assert(OBS_SPEC::COLS >= OBSERVATION::CURRENT_DIM);
-            static_assert(OBS_SPEC::ROWS == 1);
-            using T = typename SPEC::T;
-            using TI = typename DEVICE::index_t;
-
-            for(TI i = 0; i < 3; i++){
-                if constexpr(OBSERVATION_SPEC::PRIVILEGED && !SPEC::STATIC_PARAMETERS::PRIVILEGED_OBSERVATION_NOISE){
-                    set(observation, 0, i, state.position[i]);
+        // The observation row is filled in a single pass: the column (and noise) offsets of all components are resolved
+        // at compile time through observation::Layout, hence no sub-matrix views are created while walking the chain.
+        template<typename LAYOUT, typename OBS_SPEC, typename T>
+        RL_TOOLS_FUNCTION_PLACEMENT static void write_observation_block(Matrix<OBS_SPEC>& observation, const T* values, T noise_std, const T* noise){
+            using TI = typename OBS_SPEC::TI;
+            for(TI i = 0; i < LAYOUT::COMPONENT::CURRENT_DIM; i++){
+                if constexpr(LAYOUT::NOISE_DIM > 0){
+                    set(observation, 0, LAYOUT::OFFSET + i, values[i] + noise_std * noise[LAYOUT::NOISE_OFFSET + i]);
                 }
                 else{
-                    T noise = random::normal_distribution::sample(typename DEVICE::SPEC::RANDOM{}, (T)0, env.parameters.mdp.observation_noise.position, rng);
-                    set(observation, 0, i, state.position[i] + noise);
+                    set(observation, 0, LAYOUT::OFFSET + i, values[i]);
                 }
             }
-            auto next_observation = view(device, observation, matrix::ViewSpec<1, OBS_SPEC::COLS - OBSERVATION::CURRENT_DIM>{}, 0, OBSERVATION::CURRENT_DIM);
-            observe(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, next_observation, rng);
         }
-        template<typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC, typename RNG>
-        RL_TOOLS_FUNCTION_PLACEMENT static void observe(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::OrientationQuaternion<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, RNG& rng){
-            using T = typename SPEC::T;
-            using TI = typename DEVICE::index_t;
+        template<typename LAYOUT, typename DEVICE, typename SPEC, typename STATE, typename OBSERVATION_TI, typename OBS_SPEC, typename T>
+        RL_TOOLS_FUNCTION_PLACEMENT static void write_observation(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const STATE& state, rl::environments::multirotor::observation::LastComponent<OBSERVATION_TI>, Matrix<OBS_SPEC>& observation, const T* noise){
+            static_assert(LAYOUT::OFFSET == OBS_SPEC::COLS);
+        }
+        template<typename LAYOUT, typename DEVICE, typename SPEC, typename STATE, typename OBSERVATION_TI, typename OBS_SPEC, typename T>
+        RL_TOOLS_FUNCTION_PLACEMENT static void write_observation(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const STATE& state, rl::environments::multirotor::observation::NONE<OBSERVATION_TI>, Matrix<OBS_SPEC>& observation, const T* noise){
+            static_assert(OBS_SPEC::COLS == 0);
+        }
+        template<typename LAYOUT, typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC>
+        RL_TOOLS_FUNCTION_PLACEMENT static void write_observation(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::Position<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, const typename SPEC::T* noise){
+            using OBSERVATION = rl::environments::multirotor::observation::Position<OBSERVATION_SPEC>;
+            write_observation_block<LAYOUT>(observation, state.position, env.parameters.mdp.observation_noise.position, noise);
+            write_observation<typename LAYOUT::NEXT>(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, observation, noise);
+        }
+        template<typename LAYOUT, typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC>
+        RL_TOOLS_FUNCTION_PLACEMENT static void write_observation(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::OrientationQuaternion<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, const typename SPEC::T* noise){
             using OBSERVATION = rl::environments::multirotor::observation::OrientationQuaternion<OBSERVATION_SPEC>;
-            static_assert(OBS_SPEC::COLS >= OBSERVATION::CURRENT_DIM);
-            static_assert(OBS_SPEC::ROWS == 1);
-            for(TI i = 0; i < OBSERVATION::CURRENT_DIM; i++){
-                if constexpr(OBSERVATION_SPEC::PRIVILEGED && !SPEC::STATIC_PARAMETERS::PRIVILEGED_OBSERVATION_NOISE){
-                    set(observation, 0, i, state.orientation[i]);
-                }
-                else{
-                    T noise = random::normal_distribution::sample(typename DEVICE::SPEC::RANDOM{}, (T)0, env.parameters.mdp.observation_noise.orientation, rng);
-                    set(observation, 0, i, state.orientation[i] + noise);
-                }
-            }
-            auto next_observation = view(device, observation, matrix::ViewSpec<1, OBS_SPEC::COLS - OBSERVATION::CURRENT_DIM>{}, 0, OBSERVATION::CURRENT_DIM);
-            observe(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, next_observation, rng);
+            write_observation_block<LAYOUT>(observation, state.orientation, env.parameters.mdp.observation_noise.orientation, noise);
+            write_observation<typename LAYOUT::NEXT>(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, observation, noise);
         }
-        template<typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC, typename RNG>
-        RL_TOOLS_FUNCTION_PLACEMENT static void observe(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::OrientationRotationMatrix<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, RNG& rng){
-            using T = typename SPEC::T;
-            using TI = typename DEVICE::index_t;
+        template<typename LAYOUT, typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC>
+        RL_TOOLS_FUNCTION_PLACEMENT static void write_observation(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::OrientationRotationMatrix<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, const typename SPEC::T* noise){
             using OBSERVATION = rl::environments::multirotor::observation::OrientationRotationMatrix<OBSERVATION_SPEC>;
-            static_assert(OBS_SPEC::COLS >= OBSERVATION::CURRENT_DIM);
-            static_assert(OBS_SPEC::ROWS == 1);
-            const typename SPEC::T* q = state.orientation;
-            set(observation, 0, 0, (1 - 2*q[2]*q[2] - 2*q[3]*q[3]));
-            set(observation, 0, 1, (    2*q[1]*q[2] - 2*q[0]*q[3]));
-            set(observation, 0, 2, (    2*q[1]*q[3] + 2*q[0]*q[2]));
-            set(observation, 0, 3, (    2*q[1]*q[2] + 2*q[0]*q[3]));
-            set(observation, 0, 4, (1 - 2*q[1]*q[1] - 2*q[3]*q[3]));
-            set(observation, 0, 5, (    2*q[2]*q[3] - 2*q[0]*q[1]));
-            set(observation, 0, 6, (    2*q[1]*q[3] - 2*q[0]*q[2]));
-            set(observation, 0, 7, (    2*q[2]*q[3] + 2*q[0]*q[1]));
-            set(observation, 0, 8, (1 - 2*q[1]*q[1] - 2*q[2]*q[2]));
-            if constexpr(!OBSERVATION_SPEC::PRIVILEGED || SPEC::STATIC_PARAMETERS::PRIVILEGED_OBSERVATION_NOISE){
-                for(TI i = 0; i < OBSERVATION::CURRENT_DIM; i++){
-                    T noise;
-                    noise = random::normal_distribution::sample(typename DEVICE::SPEC::RANDOM(), (T)0, env.parameters.mdp.observation_noise.orientation, rng);
-                    increment(observation, 0, i, noise);
-                }
-            }
-            auto next_observation = view(device, observation, matrix::ViewSpec<1, OBS_SPEC::COLS - OBSERVATION::CURRENT_DIM>{}, 0, OBSERVATION::CURRENT_DIM);
-            observe(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, next_observation, rng);
+            // the rows of the cached rotation matrix are contiguous, hence it is written as one block of 9
+            write_observation_block<LAYOUT>(observation, &state.rotation_matrix[0][0], env.parameters.mdp.observation_noise.orientation, noise);
+            write_observation<typename LAYOUT::NEXT>(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, observation, noise);
         }
-        template<typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC, typename RNG>
-        RL_TOOLS_FUNCTION_PLACEMENT static void observe(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::LinearVelocity<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, RNG& rng){
-            using T = typename SPEC::T;
-            using TI = typename DEVICE::index_t;
+        template<typename LAYOUT, typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC>
+        RL_TOOLS_FUNCTION_PLACEMENT static void write_observation(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::LinearVelocity<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, const typename SPEC::T* noise){
             using OBSERVATION = rl::environments::multirotor::observation::LinearVelocity<OBSERVATION_SPEC>;
-            static_assert(OBS_SPEC::COLS >= OBSERVATION::CURRENT_DIM);
-            static_assert(OBS_SPEC::ROWS == 1);
-            for(TI i = 0; i < OBSERVATION::CURRENT_DIM; i++){
-                if constexpr(OBSERVATION_SPEC::PRIVILEGED && !SPEC::STATIC_PARAMETERS::PRIVILEGED_OBSERVATION_NOISE){
-                    set(observation, 0, i, state.linear_velocity[i]);
-                }
-                else{
-                    T noise = random::normal_distribution::sample(typename DEVICE::SPEC::RANDOM{}, (T)0, env.parameters.mdp.observation_noise.linear_velocity, rng);
-                    set(observation, 0, i, state.linear_velocity[i] + noise);
-                }
-            }
-            auto next_observation = view(device, observation, matrix::ViewSpec<1, OBS_SPEC::COLS - OBSERVATION::CURRENT_DIM>{}, 0, OBSERVATION::CURRENT_DIM);
-            observe(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, next_observation, rng);
+            write_observation_block<LAYOUT>(observation, state.linear_velocity, env.parameters.mdp.observation_noise.linear_velocity, noise);
+            write_observation<typename LAYOUT::NEXT>(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, observation, noise);
         }
-        template<typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC, typename RNG>
-        RL_TOOLS_FUNCTION_PLACEMENT static void observe(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::AngularVelocity<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, RNG& rng){
-            using T = typename SPEC::T;
-            using TI = typename DEVICE::index_t;
+        template<typename LAYOUT, typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC>
+        RL_TOOLS_FUNCTION_PLACEMENT static void write_observation(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::AngularVelocity<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, const typename SPEC::T* noise){
             using OBSERVATION = rl::environments::multirotor::observation::AngularVelocity<OBSERVATION_SPEC>;
-            static_assert(OBS_SPEC::COLS >= OBSERVATION::CURRENT_DIM);
-            static_assert(OBS_SPEC::ROWS == 1);
-            for(TI i = 0; i < OBSERVATION::CURRENT_DIM; i++){
-                if constexpr(OBSERVATION_SPEC::PRIVILEGED && !SPEC::STATIC_PARAMETERS::PRIVILEGED_OBSERVATION_NOISE){
-                    set(observation, 0, i, state.angular_velocity[i]);
-                }
-                else{
-                    T noise = random::normal_distribution::sample(typename DEVICE::SPEC::RANDOM{}, (T)0, env.parameters.mdp.observation_noise.angular_velocity, rng);
-                    set(observation, 0, i, state.angular_velocity[i] + noise);
-                }
-            }
-            auto next_observation = view(device, observation, matrix::ViewSpec<1, OBS_SPEC::COLS - OBSERVATION::CURRENT_DIM>{}, 0, OBSERVATION::CURRENT_DIM);
-            observe(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, next_observation, rng);
+            write_observation_block<LAYOUT>(observation, state.angular_velocity, env.parameters.mdp.observation_noise.angular_velocity, noise);
+            write_observation<typename LAYOUT::NEXT>(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, observation, noise);
         }
-        template<typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC, typename RNG>
-        RL_TOOLS_FUNCTION_PLACEMENT static void observe(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::RotorSpeeds<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, RNG& rng){
+        template<typename LAYOUT, typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC>
+        RL_TOOLS_FUNCTION_PLACEMENT static void write_observation(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::RotorSpeeds<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, const typename SPEC::T* noise){
             using T = typename SPEC::T;
             using TI = typename DEVICE::index_t;
             using OBSERVATION = rl::environments::multirotor::observation::RotorSpeeds<OBSERVATION_SPEC>;
-            static_assert(OBS_SPEC::COLS >= OBSERVATION::CURRENT_DIM);
-            static_assert(OBS_SPEC::ROWS == 1);
             for(TI action_i = 0; action_i < OBSERVATION::CURRENT_DIM; action_i++){
                 T action_value = (state.rpm[action_i] - env.parameters.dynamics.action_limit.min)/(env.parameters.dynamics.action_limit.max - env.parameters.dynamics.action_limit.min) * 2 - 1;
-                set(observation, 0, action_i, action_value);
+                set(observation, 0, LAYOUT::OFFSET + action_i, action_value);
             }
-            auto next_observation = view(device, observation, matrix::ViewSpec<1, OBS_SPEC::COLS - OBSERVATION::CURRENT_DIM>{}, 0, OBSERVATION::CURRENT_DIM);
-            observe(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, next_observation, rng);
+            write_observation<typename LAYOUT::NEXT>(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, observation, noise);
         }
-        template<typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC, typename RNG>
-        RL_TOOLS_FUNCTION_PLACEMENT static void observe(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::ActionHistory<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, RNG& rng){
-            using T = typename SPEC::T;
+        template<typename LAYOUT, typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC>
+        RL_TOOLS_FUNCTION_PLACEMENT static void write_observation(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::ActionHistory<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, const typename SPEC::T* noise){
             using TI = typename DEVICE::index_t;
             using OBSERVATION = rl::environments::multirotor::observation::ActionHistory<OBSERVATION_SPEC>;
-            static_assert(OBS_SPEC::COLS >= OBSERVATION::CURRENT_DIM);
-            static_assert(OBS_SPEC::ROWS == 1);
             static_assert(rl::environments::Multirotor<SPEC>::State::HISTORY_LENGTH == OBSERVATION::HISTORY_LENGTH);
             static_assert(rl::environments::Multirotor<SPEC>::State::ACTION_DIM == OBSERVATION::ACTION_DIM);
             static_assert(rl::environments::Multirotor<SPEC>::ACTION_DIM == OBSERVATION::ACTION_DIM);
-            for(TI step_i = 0; step_i < OBSERVATION::HISTORY_LENGTH; step_i++){
-                for(TI action_i = 0; action_i < OBSERVATION::ACTION_DIM; action_i++){
-                    set(observation, 0, step_i*OBSERVATION::ACTION_DIM + action_i, state.action_history[step_i][action_i]);
-                }
+            // unroll the ring buffer from the oldest to the newest action: two contiguous runs [head, H) and [0, head)
+            const TI head = state.action_history_head;
+            const TI first_run = (OBSERVATION::HISTORY_LENGTH - head) * OBSERVATION::ACTION_DIM;
+            const auto* history = &state.action_history[0][0];
+            for(TI i = 0; i < first_run; i++){
+                set(observation, 0, LAYOUT::OFFSET + i, history[head * OBSERVATION::ACTION_DIM + i]);
+            }
+            for(TI i = 0; i < OBSERVATION::CURRENT_DIM - first_run; i++){
+                set(observation, 0, LAYOUT::OFFSET + first_run + i, history[i]);
             }
-            auto next_observation = view(device, observation, matrix::ViewSpec<1, OBS_SPEC::COLS - OBSERVATION::CURRENT_DIM>{}, 0, OBSERVATION::CURRENT_DIM);
-            observe(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, next_observation, rng);
+            write_observation<typename LAYOUT::NEXT>(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, observation, noise);
         }
-        template<typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC, typename RNG>
-        RL_TOOLS_FUNCTION_PLACEMENT static void observe(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::RandomForce<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, RNG& rng){
-            using T = typename SPEC::T;
+        template<typename LAYOUT, typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC>
+        RL_TOOLS_FUNCTION_PLACEMENT static void write_observation(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::RandomForce<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, const typename SPEC::T* noise){
             using TI = typename DEVICE::index_t;
             using OBSERVATION = rl::environments::multirotor::observation::RandomForce<OBSERVATION_SPEC>;
-            static_assert(OBS_SPEC::COLS >= OBSERVATION::CURRENT_DIM);
-            static_assert(OBS_SPEC::ROWS == 1);
             for(TI i = 0; i < 3; i++){
-                set(observation, 0, i, state.force[i]);
-                set(observation, 0, 3 + i, state.torque[i]);
+                set(observation, 0, LAYOUT::OFFSET + i, state.force[i]);
+                set(observation, 0, LAYOUT::OFFSET + 3 + i, state.torque[i]);
             }
-            auto next_observation = view(device, observation, matrix::ViewSpec<1, OBS_SPEC::COLS - OBSERVATION::CURRENT_DIM>{}, 0, OBSERVATION::CURRENT_DIM);
-            observe(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, next_observation, rng);
+            write_observation<typename LAYOUT::NEXT>(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, observation, noise);
+        }
+        template<typename LAYOUT, typename DEVICE, typename SPEC, typename OBSERVATION_SPEC, typename OBS_SPEC>
+        RL_TOOLS_FUNCTION_PLACEMENT static void write_observation(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, rl::environments::multirotor::observation::RangeSensor<OBSERVATION_SPEC>, Matrix<OBS_SPEC>& observation, const typename SPEC::T* noise){
+            using T = typename SPEC::T;
+            using TI = typename DEVICE::index_t;
+            using OBSERVATION = rl::environments::multirotor::observation::RangeSensor<OBSERVATION_SPEC>;
+            constexpr TI N = OBSERVATION::NUM_RAYS;
+            // ray i points along cos(phi_i) * body x + sin(phi_i) * body y, i.e. a combination of the first two columns of the cached rotation matrix
+            T direction_x[N], direction_y[N], direction_z[N], ranges[N];
+            for(TI ray_i = 0; ray_i < N; ray_i++){
+                T phi = 2 * math::PI<T> * ray_i / N;
+                T c = math::cos(device.math, phi);
+                T s = math::sin(device.math, phi);
+                direction_x[ray_i] = state.rotation_matrix[0][0] * c + state.rotation_matrix[0][1] * s;
+                direction_y[ray_i] = state.rotation_matrix[1][0] * c + state.rotation_matrix[1][1] * s;
+                direction_z[ray_i] = state.rotation_matrix[2][0] * c + state.rotation_matrix[2][1] * s;
+            }
+            // the obstacle course is provided by the reward function (found through ADL, cf. parameters/reward_functions/position_to_position.h)
+            raycast_obstacles(device, env.parameters.mdp.reward, state.position, direction_x, direction_y, direction_z, N, (T)OBSERVATION::MAX_RANGE, ranges);
+            for(TI ray_i = 0; ray_i < N; ray_i++){
+                set(observation, 0, LAYOUT::OFFSET + ray_i, ranges[ray_i] / OBSERVATION::MAX_RANGE);
+            }
+            write_observation<typename LAYOUT::NEXT>(device, env, state, typename OBSERVATION::NEXT_COMPONENT{}, observation, noise);
+        }
+        template<typename OBSERVATION, typename DEVICE, typename SPEC, typename STATE, typename OBS_SPEC, typename RNG>
+        RL_TOOLS_FUNCTION_PLACEMENT static void observe_flat(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const STATE& state, Matrix<OBS_SPEC>& observation, RNG& rng){
+            using T = typename SPEC::T;
+            using TI = typename SPEC::TI;
+            using LAYOUT = rl::environments::multirotor::observation::Layout<TI, OBSERVATION, SPEC::STATIC_PARAMETERS::PRIVILEGED_OBSERVATION_NOISE>;
+            static_assert(OBS_SPEC::ROWS == 1);
+            static_assert(OBS_SPEC::COLS == LAYOUT::DIM);
+            // the standard normal samples for all noisy components are drawn as one block (see random_block.h) and scaled by the per-component standard deviation in the writer
+            T noise[LAYOUT::TOTAL_NOISE_DIM > 0 ? LAYOUT::TOTAL_NOISE_DIM : 1];
+            if constexpr(LAYOUT::TOTAL_NOISE_DIM > 0){
+                random::block::normal(device, noise, (TI)LAYOUT::TOTAL_NOISE_DIM, rng);
+            }
+            write_observation<LAYOUT>(device, env, state, OBSERVATION{}, observation, noise);
         }
     }
     template<typename DEVICE, typename SPEC, typename STATE, typename OBS_SPEC, typename RNG>
@@ -542,14 +559,14 @@ namespace rl_tools{
         using ENVIRONMENT = rl::environments::Multirotor<SPEC>;
         static_assert(OBS_SPEC::COLS == ENVIRONMENT::OBSERVATION_DIM);
         static_assert(OBS_SPEC::ROWS == 1);
-        rl::environments::multirotor::observe(device, env, state, typename ENVIRONMENT::Observation{}, observation, rng);
+        rl::environments::multirotor::observe_flat<typename ENVIRONMENT::Observation>(device, env, state, observation, rng);
     }
     template<typename DEVICE, typename SPEC, typename STATE, typename OBS_SPEC, typename RNG>
     RL_TOOLS_FUNCTION_PLACEMENT static void observe_privileged(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const STATE& state, Matrix<OBS_SPEC>& observation, RNG& rng){
         using ENVIRONMENT = rl::environments::Multirotor<SPEC>;
         static_assert(OBS_SPEC::COLS == ENVIRONMENT::OBSERVATION_DIM_PRIVILEGED);
         static_assert(OBS_SPEC::ROWS == 1);
-        rl::environments::multirotor::observe(device, env, state, typename ENVIRONMENT::ObservationPrivileged{}, observation, rng);
+        rl::environments::multirotor::observe_flat<typename ENVIRONMENT::ObservationPrivileged>(device, env, state, observation, rng);
     }
 //    template<typename DEVICE, typename T, typename TI, typename SPEC, typename OBS_SPEC, typename RNG>
 //    RL_TOOLS_FUNCTION_PLACEMENT static void observe_privileged(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::StateLatentEmpty<T, TI>& state, Matrix<OBS_SPEC>& observation, RNG& rng){
@@ -602,6 +619,91 @@ namespace rl_tools{
 //            set(rpm_observation, 0, action_i, action_value);
 //        }
 //    }
+    namespace rl::environments::multirotor{
+        // Overwrites the oldest entry of the ring buffer with the (normalized) action and advances the head.
+        // The history is part of the state (by value), so when next_state is a different object it still has to be copied
+        // (HISTORY_LENGTH x 4 values, without the slot that is overwritten). Only stepping in place writes a single slot.
+        template<typename DEVICE, typename T, typename TI, TI HISTORY_LENGTH, typename NEXT_COMPONENT, typename ACTION_SPEC>
+        RL_TOOLS_FUNCTION_PLACEMENT void push_action_history(DEVICE& device, const StateRotorsHistory<T, TI, HISTORY_LENGTH, NEXT_COMPONENT>& state, const Matrix<ACTION_SPEC>& action, StateRotorsHistory<T, TI, HISTORY_LENGTH, NEXT_COMPONENT>& next_state){
+            static_assert(ACTION_SPEC::COLS == StateRotorsHistory<T, TI, HISTORY_LENGTH, NEXT_COMPONENT>::ACTION_DIM);
+            if constexpr(HISTORY_LENGTH > 0){
+                const TI head = state.action_history_head;
+                if(&next_state != &state){
+                    for(TI step_i = 0; step_i < HISTORY_LENGTH; step_i++){
+                        if(step_i == head){
+                            continue;
+                        }
+                        for(TI action_i = 0; action_i < ACTION_SPEC::COLS; action_i++){
+                            next_state.action_history[step_i][action_i] = state.action_history[step_i][action_i];
+                        }
+                    }
+                }
+                for(TI action_i = 0; action_i < ACTION_SPEC::COLS; action_i++){
+                    next_state.action_history[head][action_i] = get(action, 0, action_i);
+                }
+                next_state.action_history_head = head + 1 == HISTORY_LENGTH ? 0 : head + 1;
+            }
+        }
+        // The action history is maintained in post_integration, hence the integrator only has to carry the state it wraps
+        template <typename STATE>
+        struct IntegrationState{
+            using type = STATE;
+        };
+        template <typename T, typename TI, TI HISTORY_LENGTH, typename NEXT_COMPONENT>
+        struct IntegrationState<StateRotorsHistory<T, TI, HISTORY_LENGTH, NEXT_COMPONENT>>{
+            using type = StateRotors<T, TI, NEXT_COMPONENT>;
+        };
+        // First-order rotor lag with a setpoint that is constant over the step: rpm(t) = setpoint + (rpm(0) - setpoint) * exp(-t / rpm_time_constant)
+        template<typename T, typename TI>
+        RL_TOOLS_FUNCTION_PLACEMENT void rotor_speeds_closed_form(const T* rpm, const T* setpoint, T decay, T* out){
+            for(TI rotor_i = 0; rotor_i < 4; rotor_i++){
+                out[rotor_i] = setpoint[rotor_i] + (rpm[rotor_i] - setpoint[rotor_i]) * decay;
+            }
+        }
+        template<bool CLOSED_FORM_ROTOR_DELAY, typename DEVICE, typename T, typename PARAMETERS, typename STATE>
+        RL_TOOLS_FUNCTION_PLACEMENT void integrate(DEVICE& device, const PARAMETERS& params, const STATE& state, const T* action, T dt, STATE& next_state){
+            utils::integrators::rk4<DEVICE, T, PARAMETERS, STATE, 4, multirotor_dynamics_dispatch<DEVICE, T, PARAMETERS, STATE>>(device, params, state, action, dt, next_state);
+        }
+        // With CLOSED_FORM_ROTOR_DELAY the rotor speeds are advanced with the exact solution of the lag instead of being
+        // integrated by RK4. Only the rigid body is integrated, with the rotor speeds of the respective stage time (t, t + dt/2, t + dt).
+        template<bool CLOSED_FORM_ROTOR_DELAY, typename DEVICE, typename T, typename TI, typename NEXT_COMPONENT, typename PARAMETERS>
+        RL_TOOLS_FUNCTION_PLACEMENT void integrate(DEVICE& device, const PARAMETERS& params, const StateRotors<T, TI, NEXT_COMPONENT>& state, const T* action, T dt, StateRotors<T, TI, NEXT_COMPONENT>& next_state){
+            using STATE = StateRotors<T, TI, NEXT_COMPONENT>;
+            if constexpr(!CLOSED_FORM_ROTOR_DELAY){
+                utils::integrators::rk4<DEVICE, T, PARAMETERS, STATE, 4, multirotor_dynamics_dispatch<DEVICE, T, PARAMETERS, STATE>>(device, params, state, action, dt, next_state);
+            }
+            else{
+                const T decay_half = math::exp(device.math, -dt / (2 * params.dynamics.rpm_time_constant));
+                T rpm_half[4], rpm_full[4];
+                rotor_speeds_closed_form<T, TI>(state.rpm, action, decay_half, rpm_half);
+                rotor_speeds_closed_form<T, TI>(state.rpm, action, decay_half * decay_half, rpm_full);
+
+                const NEXT_COMPONENT& rigid_body = state;
+                NEXT_COMPONENT k1, k2, k3, k4;
+                NEXT_COMPONENT stage = rigid_body;
+                multirotor_dynamics(device, params, rigid_body, state.rpm, k1);
+                scalar_multiply(device, k1, dt/2, stage);
+                add_accumulate(device, rigid_body, stage);
+                multirotor_dynamics(device, params, stage, rpm_half, k2);
+                scalar_multiply(device, k2, dt/2, stage);
+                add_accumulate(device, rigid_body, stage);
+                multirotor_dynamics(device, params, stage, rpm_half, k3);
+                scalar_multiply(device, k3, dt, stage);
+                add_accumulate(device, rigid_body, stage);
+                multirotor_dynamics(device, params, stage, rpm_full, k4);
+
+                NEXT_COMPONENT& next_rigid_body = next_state;
+                next_rigid_body = rigid_body;
+                scalar_multiply_accumulate(device, k1, dt/6, next_rigid_body);
+                scalar_multiply_accumulate(device, k2, dt/3, next_rigid_body);
+                scalar_multiply_accumulate(device, k3, dt/3, next_rigid_body);
+                scalar_multiply_accumulate(device, k4, dt/6, next_rigid_body);
+                for(TI rotor_i = 0; rotor_i < 4; rotor_i++){
+                    next_state.rpm[rotor_i] = rpm_full[rotor_i];
+                }
+            }
+        }
+    }
 //    template<typename DEVICE, typename SPEC, typename T, typename TI>
 //    RL_TOOLS_FUNCTION_PLACEMENT void post_integration(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, rl::environments::multirotor::StateBase<T, TI>& state) {
     template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename T_S, typename TI_S, typename RNG>
@@ -616,6 +718,8 @@ namespace rl_tools{
         for(TI state_i = 0; state_i < 4; state_i++){
             next_state.orientation[state_i] /= quaternion_norm;
         }
+        rl::environments::multirotor::update_derived_quantities(device, next_state);
+        rl::environments::multirotor::update_obstacle_cache(device, env, next_state);
     }
 //    template<typename DEVICE, typename SPEC, typename T, typename TI, typename NEXT_COMPONENT>
 //    RL_TOOLS_FUNCTION_PLACEMENT void post_integration(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, rl::environments::multirotor::StateRotors<T, TI, NEXT_COMPONENT>& state) {
@@ -640,19 +744,9 @@ namespace rl_tools{
     template<typename DEVICE, typename T_S, typename TI_S, typename NEXT_STATE_COMPONENT, TI_S HISTORY_LENGTH, typename SPEC, typename ACTION_SPEC, typename RNG>
     RL_TOOLS_FUNCTION_PLACEMENT void post_integration(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::multirotor::StateRotorsHistory<T_S, TI_S, HISTORY_LENGTH, NEXT_STATE_COMPONENT>& state, const Matrix<ACTION_SPEC>& action, typename rl::environments::multirotor::StateRotorsHistory<T_S, TI_S, HISTORY_LENGTH, NEXT_STATE_COMPONENT>& next_state, RNG& rng) {
         using MULTIROTOR = rl::environments::Multirotor<SPEC>;
-        using TI = typename DEVICE::index_t;
         static_assert(ACTION_SPEC::COLS == MULTIROTOR::ACTION_DIM);
         post_integration(device, env, static_cast<const rl::environments::multirotor::StateRotors<T_S, TI_S, NEXT_STATE_COMPONENT>&>(state), action, static_cast<rl::environments::multirotor::StateRotors<T_S, TI_S, NEXT_STATE_COMPONENT>&>(next_state), rng);
-        if constexpr(HISTORY_LENGTH > 0){
-            for(TI step_i = 0; step_i < HISTORY_LENGTH-1; step_i++){
-                for(TI action_i = 0; action_i < MULTIROTOR::ACTION_DIM; action_i++){
-                    next_state.action_history[step_i][action_i] = state.action_history[step_i+1][action_i];
-                }
-            }
-            for(TI action_i = 0; action_i < MULTIROTOR::ACTION_DIM; action_i++){
-                next_state.action_history[HISTORY_LENGTH-1][action_i] = get(action, 0, action_i);
-            }
-        }
+        rl::environments::multirotor::push_action_history(device, state, action, next_state);
     }
 //    template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename T_S, typename TI_S, typename STATE, typename RNG>
 //    RL_TOOLS_FUNCTION_PLACEMENT void post_integration(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const STATE& state, const Matrix<ACTION_SPEC>& action, STATE& next_state, RNG& rng) {
@@ -670,19 +764,41 @@ namespace rl_tools{
         static_assert(ACTION_SPEC::ROWS == 1);
         static_assert(ACTION_SPEC::COLS == ACTION_DIM);
         T action_scaled[ACTION_DIM];
+        T action_noise[ACTION_DIM];
+        random::block::normal(device, action_noise, ACTION_DIM, rng);
 
         for(TI action_i = 0; action_i < ACTION_DIM; action_i++){
             T half_range = (env.parameters.dynamics.action_limit.max - env.parameters.dynamics.action_limit.min) / 2;
             T action_noisy = get(action, 0, action_i);
-            action_noisy += random::normal_distribution::sample(typename DEVICE::SPEC::RANDOM(), (T)0, env.parameters.mdp.action_noise.normalized_rpm, rng);
+            action_noisy += env.parameters.mdp.action_noise.normalized_rpm * action_noise[action_i];
             action_noisy = math::clamp(device.math, action_noisy, -(T)1, (T)1);
             action_scaled[action_i] = action_noisy * half_range + env.parameters.dynamics.action_limit.min + half_range;
 //            state.rpm[action_i] = action_scaled[action_i];
         }
-        utils::integrators::rk4  <DEVICE, typename SPEC::T, typename SPEC::PARAMETERS, STATE, ACTION_DIM, rl::environments::multirotor::multirotor_dynamics_dispatch<DEVICE, typename SPEC::T, typename SPEC::PARAMETERS, STATE>>(device, env.parameters, state, action_scaled, env.parameters.integration.dt, next_state);
+        using INTEGRATION_STATE = typename rl::environments::multirotor::IntegrationState<STATE>::type;
+        static_assert(ACTION_DIM == 4);
+        // env.parameters.integration.dt is the control period, the physics are integrated in PHYSICS_SUBSTEPS sub-steps with the same (zero-order hold) action
+        constexpr TI PHYSICS_SUBSTEPS = SPEC::STATIC_PARAMETERS::PHYSICS_SUBSTEPS;
+        static_assert(PHYSICS_SUBSTEPS >= 1);
+        const T dt = env.parameters.integration.dt / PHYSICS_SUBSTEPS;
+        INTEGRATION_STATE& next_integration_state = static_cast<INTEGRATION_STATE&>(next_state);
+        rl::environments::multirotor::integrate<SPEC::STATIC_PARAMETERS::CLOSED_FORM_ROTOR_DELAY>(device, env.parameters, static_cast<const INTEGRATION_STATE&>(state), (const T*)action_scaled, dt, next_integration_state);
+        // a collision at an intermediate sub-step is kept (the obstacle distance and id are the ones of the final position)
+        bool substep_collision = false;
+        if constexpr(PHYSICS_SUBSTEPS > 1){
+            // the integrators can not work in place, hence the intermediate state is copied (the action history is not part of it)
+            INTEGRATION_STATE substep_state;
+            for(TI substep_i = 1; substep_i < PHYSICS_SUBSTEPS; substep_i++){
+                post_integration(device, env, static_cast<const INTEGRATION_STATE&>(state), action, next_integration_state, rng);
+                substep_collision = substep_collision || next_integration_state.obstacle_collision;
+                substep_state = next_integration_state;
+                rl::environments::multirotor::integrate<SPEC::STATIC_PARAMETERS::CLOSED_FORM_ROTOR_DELAY>(device, env.parameters, substep_state, (const T*)action_scaled, dt, next_integration_state);
+            }
+        }
 //        utils::integrators::euler<DEVICE, typename SPEC::T, typename SPEC::PARAMETERS, STATE, ACTION_DIM, rl::environments::multirotor::multirotor_dynamics_dispatch<DEVICE, typename SPEC::T, typename SPEC::PARAMETERS, STATE>>(device, env.parameters, state, action_scaled, env.parameters.integration.dt, next_state);
 
         post_integration(device, env, state, action, next_state, rng);
+        next_state.obstacle_collision = next_state.obstacle_collision || substep_collision;
 
         return env.parameters.integration.dt;
     }
@@ -691,6 +807,9 @@ namespace rl_tools{
     RL_TOOLS_FUNCTION_PLACEMENT static bool terminated(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, RNG& rng){
         using T = typename SPEC::T;
         using TI = typename DEVICE::index_t;
+        if(state.obstacle_collision){
+            return true;
+        }
         if(env.parameters.mdp.termination.enabled){
             for(TI i = 0; i < 3; i++){
                 if(
@@ -715,6 +834,23 @@ namespace rl_tools{
     RL_TOOLS_FUNCTION_PLACEMENT void log_reward(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, const Matrix<ACTION_SPEC>& action, const typename rl::environments::Multirotor<SPEC>::State& next_state, RNG& rng) {
         rl::environments::multirotor::parameters::reward_functions::log_reward(device, env, env.parameters.mdp.reward, state, action, next_state, rng);
     }
+    template<typename DEVICE, typename SPEC, typename COMPONENTS>
+    RL_TOOLS_FUNCTION_PLACEMENT void log_reward(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const COMPONENTS& components) {
+        rl::environments::multirotor::parameters::reward_functions::log_reward(device, env, env.parameters.mdp.reward, components);
+    }
+    // step + terminated + reward in one pass: terminated() is evaluated once and handed to the reward function, the returned
+    // components can be passed to log_reward. Requires a reward function that provides reward_components (Squared, PositionToPosition).
+    template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename RNG>
+    RL_TOOLS_FUNCTION_PLACEMENT static rl::environments::multirotor::StepResult<typename SPEC::T, typename rl::environments::Multirotor<SPEC>::REWARD_FUNCTION::Components> step_full(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const typename rl::environments::Multirotor<SPEC>::State& state, const Matrix<ACTION_SPEC>& action, typename rl::environments::Multirotor<SPEC>::State& next_state, RNG& rng) {
+        rl::environments::multirotor::StepResult<typename SPEC::T, typename rl::environments::Multirotor<SPEC>::REWARD_FUNCTION::Components> result;
+        result.dt = step(device, env, state, action, next_state, rng);
+        bool terminated_flag = terminated(device, env, next_state, rng);
+        result.components = rl::environments::multirotor::parameters::reward_functions::reward_components(device, env, env.parameters.mdp.reward, state, action, next_state, terminated_flag);
+        result.reward = result.components.reward;
+        // includes conditions that only the reward function checks
+        result.terminated = result.components.terminated;
+        return result;
+    }
 }
 
 //template<typename DEVICE, typename T, typename TI, typename SPEC, typename LATENT_STATE>
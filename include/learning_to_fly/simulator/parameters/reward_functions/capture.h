@@ -0,0 +1,52 @@
+#ifndef LEARNING_TO_FLY_IN_SECONDS_SIMULATOR_PARAMETERS_REWARD_FUNCTIONS_CAPTURE_H
+#define LEARNING_TO_FLY_IN_SECONDS_SIMULATOR_PARAMETERS_REWARD_FUNCTIONS_CAPTURE_H
+
+#include <stddef.h>
+
+#ifndef RL_TOOLS_FUNCTION_PLACEMENT
+#define RL_TOOLS_FUNCTION_PLACEMENT
+#endif
+
+// Fixed-size ring (structure of arrays) that reward() writes the components of every transition it labels into, so that they
+// can be logged without recomputing them. Set through set_reward_capture (shared, not owned, nullptr: disabled). There is a
+// single writer and the consumer reduces the rows at its own cadence; rows it did not reach within CAPACITY transitions are
+// overwritten (written - CAPACITY is the oldest row that is still available).
+namespace rl_tools::rl::environments::multirotor::parameters::reward_functions{
+    template <typename T>
+    struct Capture{
+        static constexpr size_t CAPACITY = 4096;
+        size_t written = 0; // total number of captured transitions, the next row is written % CAPACITY
+        T orientation_cost[CAPACITY];
+        T position_cost[CAPACITY];
+        T linear_vel_cost[CAPACITY];
+        T angular_vel_cost[CAPACITY];
+        T linear_acc_cost[CAPACITY];
+        T angular_acc_cost[CAPACITY];
+        T action_cost[CAPACITY];
+        T weighted_cost[CAPACITY];
+        T scaled_weighted_cost[CAPACITY];
+        T reward[CAPACITY];
+        bool terminated[CAPACITY];
+    };
+    template <typename T, typename COMPONENTS>
+    RL_TOOLS_FUNCTION_PLACEMENT void capture(Capture<T>* capture, const COMPONENTS& components){
+        if(capture == nullptr){
+            return;
+        }
+        size_t row_i = capture->written % Capture<T>::CAPACITY;
+        capture->orientation_cost[row_i] = components.orientation_cost;
+        capture->position_cost[row_i] = components.position_cost;
+        capture->linear_vel_cost[row_i] = components.linear_vel_cost;
+        capture->angular_vel_cost[row_i] = components.angular_vel_cost;
+        capture->linear_acc_cost[row_i] = components.linear_acc_cost;
+        capture->angular_acc_cost[row_i] = components.angular_acc_cost;
+        capture->action_cost[row_i] = components.action_cost;
+        capture->weighted_cost[row_i] = components.weighted_cost;
+        capture->scaled_weighted_cost[row_i] = components.scaled_weighted_cost;
+        capture->reward[row_i] = components.reward;
+        capture->terminated[row_i] = components.terminated;
+        capture->written++;
+    }
+}
+
+#endif
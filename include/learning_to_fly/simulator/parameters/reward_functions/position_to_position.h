@@ -5,11 +5,15 @@
 #include <rl_tools/utils/generic/typing.h>
 #include <rl_tools/utils/generic/vector_operations.h>
 #include "squared.h"
-#include "../../../../../src/constants.h"  // Include obstacle definitions
+#include "../../obstacle_field.h"
+#include "../../obstacle_course.h"
 
 namespace rl_tools::rl::environments::multirotor::parameters::reward_functions{
-    template<typename T>
+    // T_TERMS: weighted cost terms that are evaluated (cf. terms.h). The distance to the target and the speed are always
+    // computed because the progress reward uses them
+    template<typename T, terms::Mask T_TERMS = terms::ALL>
     struct PositionToPosition {
+        static constexpr terms::Mask TERMS = T_TERMS;
         // Base Squared parameters
         bool non_negative;
         T scale;
@@ -29,13 +33,53 @@ namespace rl_tools::rl::environments::multirotor::parameters::reward_functions{
         T target_radius;
         T velocity_reward_scale;
         bool use_target_progress;
+        // obstacle course (shared, not owned). nullptr: no obstacles
+        const obstacles::Scene* obstacle_scene = nullptr;
+        // the same course baked into a signed-distance grid. nullptr: evaluate obstacle_scene exactly
+        const obstacles::Field<T>* obstacle_field = nullptr;
+        // procedural courses (shared, not owned). If set, a new course is drawn into course by every sample_initial_state
+        // and replaces obstacle_scene / obstacle_field for this environment
+        const obstacles::CourseGenerator* course_generator = nullptr;
+        obstacles::Course course = {};
+        // components of the labeled transitions (shared, not owned, cf. capture.h). nullptr: not captured
+        Capture<T>* capture = nullptr;
         
         // Use the same Components struct as Squared
         using Components = typename Squared<T>::Components;
     };
+    template<terms::Mask TERMS, typename T, terms::Mask SOURCE_TERMS>
+    constexpr PositionToPosition<T, TERMS> prune(const PositionToPosition<T, SOURCE_TERMS>& params){
+        PositionToPosition<T, TERMS> pruned = {};
+        pruned.non_negative = params.non_negative;
+        pruned.scale = params.scale;
+        pruned.constant = params.constant;
+        pruned.termination_penalty = params.termination_penalty;
+        pruned.position = params.position;
+        pruned.orientation = params.orientation;
+        pruned.linear_velocity = params.linear_velocity;
+        pruned.angular_velocity = params.angular_velocity;
+        pruned.linear_acceleration = params.linear_acceleration;
+        pruned.angular_acceleration = params.angular_acceleration;
+        pruned.action_baseline = params.action_baseline;
+        pruned.action = params.action;
+        for(int i = 0; i < 3; i++){
+            pruned.target_pos[i] = params.target_pos[i];
+        }
+        pruned.target_radius = params.target_radius;
+        pruned.velocity_reward_scale = params.velocity_reward_scale;
+        pruned.use_target_progress = params.use_target_progress;
+        pruned.obstacle_scene = params.obstacle_scene;
+        pruned.obstacle_field = params.obstacle_field;
+        pruned.course_generator = params.course_generator;
+        pruned.course = params.course;
+        pruned.capture = params.capture;
+        return pruned;
+    }
 
-    template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename T, typename RNG>
-    RL_TOOLS_FUNCTION_PLACEMENT typename rl::environments::multirotor::parameters::reward_functions::PositionToPosition<T>::Components reward_components(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::parameters::reward_functions::PositionToPosition<T>& params, const typename rl::environments::Multirotor<SPEC>::State& state, const Matrix<ACTION_SPEC>& action,  const typename rl::environments::Multirotor<SPEC>::State& next_state, RNG& rng){
+    // terminated_flag is the result of terminated(device, env, next_state, rng). The returned components.terminated additionally
+    // includes obstacle collisions (already part of terminated_flag unless the caller computed it differently).
+    template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename T, terms::Mask TERMS>
+    RL_TOOLS_FUNCTION_PLACEMENT typename rl::environments::multirotor::parameters::reward_functions::PositionToPosition<T>::Components reward_components(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::parameters::reward_functions::PositionToPosition<T, TERMS>& params, const typename rl::environments::Multirotor<SPEC>::State& state, const Matrix<ACTION_SPEC>& action,  const typename rl::environments::Multirotor<SPEC>::State& next_state, bool terminated_flag){
         using TI = typename DEVICE::index_t;
         constexpr TI ACTION_DIM = ACTION_SPEC::COLS;
         using Components = typename rl::environments::multirotor::parameters::reward_functions::Squared<T>::Components;
@@ -76,115 +120,60 @@ namespace rl_tools::rl::environments::multirotor::parameters::reward_functions{
         //     origin_repulsion_penalty = origin_proximity_factor * origin_proximity_factor * T(1.0); // Reduced from 3.0 to 1.0
         // }
         
-        // CHECK FOR COLLISION WITH CYLINDRICAL OBSTACLES (PIPES)
+        // CHECK FOR COLLISION WITH OBSTACLES (PIPES AND WALLS)
         // If drone collides with any obstacle, immediately terminate with crash penalty
-        bool obstacle_collision = false;
-        T obstacle_avoidance_penalty = T(0);
-        
-        for(size_t obs_idx = 0; obs_idx < learning_to_fly::constants::NUM_OBSTACLES; obs_idx++) {
-            const auto& obstacle = learning_to_fly::constants::OBSTACLES[obs_idx];
-            
-            // Check horizontal distance to pipe center (regardless of Z)
-            T dx = next_state.position[0] - T(obstacle.x);
-            T dy = next_state.position[1] - T(obstacle.y);
-            T horizontal_dist_sq = dx * dx + dy * dy;
-            T horizontal_dist = math::sqrt(device.math, horizontal_dist_sq);
-            
-            // Check if drone is within the Z range of the pipe for collision
-            T drone_z = next_state.position[2];
-            if(drone_z >= T(obstacle.z_min) && drone_z <= T(obstacle.z_max)) {
-                // Collision if within pipe radius
-                if(horizontal_dist < T(obstacle.radius)) {
-                    obstacle_collision = true;
-                    break;
-                }
-                
-                // PROXIMITY PENALTY: Penalize being near the obstacle (within danger zone)
-                // This creates a repulsive force to encourage going around
-                T danger_zone_radius = T(obstacle.radius) * T(2.0); // 2x the pipe radius
-                if(horizontal_dist < danger_zone_radius) {
-                    // Balanced penalty the closer to the obstacle
-                    T proximity_factor = (danger_zone_radius - horizontal_dist) / danger_zone_radius;
-                    obstacle_avoidance_penalty += proximity_factor * proximity_factor * T(3.0); // Reduced from 5.0
-                }
-            }
-        }
-        
-        // CHECK FOR COLLISION WITH PLANAR OBSTACLES (WALLS)
-        if(!obstacle_collision) {
-            for(size_t plane_idx = 0; plane_idx < learning_to_fly::constants::NUM_PLANAR_OBSTACLES; plane_idx++) {
-                const auto& plane = learning_to_fly::constants::PLANAR_OBSTACLES[plane_idx];
-                
-                T drone_x = next_state.position[0];
-                T drone_y = next_state.position[1];
-                T drone_z = next_state.position[2];
-                
-                // Check if drone is within bounding box of the plane
-                if(drone_x >= T(plane.x_min) && drone_x <= T(plane.x_max) &&
-                   drone_y >= T(plane.y_min) && drone_y <= T(plane.y_max) &&
-                   drone_z >= T(plane.z_min) && drone_z <= T(plane.z_max)) {
-                    
-                    // Calculate signed distance from drone to plane
-                    // Distance = (point - plane_point) · normal
-                    T dx_to_plane = drone_x - T(plane.point_x);
-                    T dy_to_plane = drone_y - T(plane.point_y);
-                    T dz_to_plane = drone_z - T(plane.point_z);
-                    
-                    T signed_distance = dx_to_plane * T(plane.normal_x) + 
-                                       dy_to_plane * T(plane.normal_y) + 
-                                       dz_to_plane * T(plane.normal_z);
-                    
-                    T distance_to_plane = math::abs(device.math, signed_distance);
-                    
-                    // Collision if within thickness
-                    if(distance_to_plane < T(plane.thickness)) {
-                        obstacle_collision = true;
-                        break;
-                    }
-                    
-                    // PROXIMITY PENALTY: Penalize being near the wall
-                    T danger_zone_thickness = T(plane.thickness) * T(3.0); // 3x the wall thickness
-                    if(distance_to_plane < danger_zone_thickness) {
-                        T proximity_factor = (danger_zone_thickness - distance_to_plane) / danger_zone_thickness;
-                        obstacle_avoidance_penalty += proximity_factor * proximity_factor * T(3.0);
-                    }
-                }
-            }
-        }
+        // The obstacle course has already been queried in step (cf. update_obstacle_cache)
+        bool obstacle_collision = next_state.obstacle_collision;
         
         // Calculate orientation error (quaternion to desired "facing target" orientation)
+        // Terms that are disabled at compile time (TERMS) are skipped and stay 0
         T orientation_error_sq = 0;
-        for(TI i = 0; i < 4; i++){
-            T target_quat = (i == 0) ? 1 : 0; // Identity quaternion (hover orientation)
-            T diff = next_state.orientation[i] - target_quat;
-            orientation_error_sq += diff * diff;
+        if constexpr((TERMS & terms::ORIENTATION) != 0){
+            for(TI i = 0; i < 4; i++){
+                T target_quat = (i == 0) ? 1 : 0; // Identity quaternion (hover orientation)
+                T diff = next_state.orientation[i] - target_quat;
+                orientation_error_sq += diff * diff;
+            }
         }
         
-        // Calculate velocity costs
+        // Calculate velocity costs (the speed is also used by the progress reward)
         T linear_vel_cost = 0;
         T angular_vel_cost = 0;
         for(TI i = 0; i < 3; i++){
             linear_vel_cost += next_state.linear_velocity[i] * next_state.linear_velocity[i];
-            angular_vel_cost += next_state.angular_velocity[i] * next_state.angular_velocity[i];
+        }
+        if constexpr((TERMS & terms::ANGULAR_VELOCITY) != 0){
+            for(TI i = 0; i < 3; i++){
+                angular_vel_cost += next_state.angular_velocity[i] * next_state.angular_velocity[i];
+            }
         }
         
         // Calculate linear and angular acceleration costs
         T linear_acc_cost = 0;
         T angular_acc_cost = 0;
-        for(TI i = 0; i < 3; i++){
-            T lin_acc_diff = next_state.linear_velocity[i] - state.linear_velocity[i];
-            T ang_acc_diff = next_state.angular_velocity[i] - state.angular_velocity[i];
-            linear_acc_cost += lin_acc_diff * lin_acc_diff;
-            angular_acc_cost += ang_acc_diff * ang_acc_diff;
+        if constexpr((TERMS & terms::LINEAR_ACCELERATION) != 0){
+            for(TI i = 0; i < 3; i++){
+                T lin_acc_diff = next_state.linear_velocity[i] - state.linear_velocity[i];
+                linear_acc_cost += lin_acc_diff * lin_acc_diff;
+            }
+        }
+        if constexpr((TERMS & terms::ANGULAR_ACCELERATION) != 0){
+            for(TI i = 0; i < 3; i++){
+                T ang_acc_diff = next_state.angular_velocity[i] - state.angular_velocity[i];
+                angular_acc_cost += ang_acc_diff * ang_acc_diff;
+            }
         }
         
         // Calculate action cost
-        T action_diff[ACTION_DIM];
-        for(TI i = 0; i < ACTION_DIM; i++){
-            action_diff[i] = get(action, 0, i) - params.action_baseline;
+        T action_cost = 0;
+        if constexpr((TERMS & terms::ACTION) != 0){
+            T action_diff[ACTION_DIM];
+            for(TI i = 0; i < ACTION_DIM; i++){
+                action_diff[i] = get(action, 0, i) - params.action_baseline;
+            }
+            action_cost = rl_tools::utils::vector_operations::norm<DEVICE, T, ACTION_DIM>(action_diff);
+            action_cost *= action_cost;
         }
-        T action_cost = rl_tools::utils::vector_operations::norm<DEVICE, T, ACTION_DIM>(action_diff);
-        action_cost *= action_cost;
         
         // Store individual components
         components.position_cost = target_distance_sq; // Use distance to target instead of distance from origin
@@ -288,19 +277,20 @@ namespace rl_tools::rl::environments::multirotor::parameters::reward_functions{
             }
         }
         
-        components.weighted_cost = params.position * components.position_cost + 
-                                  params.orientation * components.orientation_cost + 
-                                  params.linear_velocity * components.linear_vel_cost + 
-                                  params.angular_velocity * components.angular_vel_cost + 
-                                  params.linear_acceleration * components.linear_acc_cost + 
-                                  params.angular_acceleration * components.angular_acc_cost + 
-                                  params.action * components.action_cost;
+        components.weighted_cost = 0;
+        if constexpr((TERMS & terms::POSITION) != 0){ components.weighted_cost += params.position * components.position_cost; }
+        if constexpr((TERMS & terms::ORIENTATION) != 0){ components.weighted_cost += params.orientation * components.orientation_cost; }
+        if constexpr((TERMS & terms::LINEAR_VELOCITY) != 0){ components.weighted_cost += params.linear_velocity * components.linear_vel_cost; }
+        if constexpr((TERMS & terms::ANGULAR_VELOCITY) != 0){ components.weighted_cost += params.angular_velocity * components.angular_vel_cost; }
+        if constexpr((TERMS & terms::LINEAR_ACCELERATION) != 0){ components.weighted_cost += params.linear_acceleration * components.linear_acc_cost; }
+        if constexpr((TERMS & terms::ANGULAR_ACCELERATION) != 0){ components.weighted_cost += params.angular_acceleration * components.angular_acc_cost; }
+        if constexpr((TERMS & terms::ACTION) != 0){ components.weighted_cost += params.action * components.action_cost; }
                                   
-        bool terminated_flag = terminated(device, env, next_state, rng);
         components.scaled_weighted_cost = params.scale * components.weighted_cost;
+        components.terminated = terminated_flag || obstacle_collision;
 
         // Check for obstacle collision or other termination conditions
-        if(terminated_flag || obstacle_collision){
+        if(components.terminated){
             components.reward = params.termination_penalty;
         }
         else{
@@ -312,17 +302,94 @@ namespace rl_tools::rl::environments::multirotor::parameters::reward_functions{
         return components;
     }
 
-    template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename T, typename RNG>
-    RL_TOOLS_FUNCTION_PLACEMENT static typename SPEC::T reward(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::parameters::reward_functions::PositionToPosition<T>& params, const typename rl::environments::Multirotor<SPEC>::State& state, const Matrix<ACTION_SPEC>& action,  const typename rl::environments::Multirotor<SPEC>::State& next_state, RNG& rng) {
+    template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename T, terms::Mask TERMS, typename RNG>
+    RL_TOOLS_FUNCTION_PLACEMENT typename rl::environments::multirotor::parameters::reward_functions::PositionToPosition<T>::Components reward_components(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::parameters::reward_functions::PositionToPosition<T, TERMS>& params, const typename rl::environments::Multirotor<SPEC>::State& state, const Matrix<ACTION_SPEC>& action,  const typename rl::environments::Multirotor<SPEC>::State& next_state, RNG& rng){
+        return reward_components(device, env, params, state, action, next_state, terminated(device, env, next_state, rng));
+    }
+
+    // Collision query used by update_obstacle_cache (once per step). With a baked field this is a single trilinear lookup,
+    // otherwise all obstacles are evaluated
+    template<typename DEVICE, typename T, terms::Mask TERMS>
+    RL_TOOLS_FUNCTION_PLACEMENT obstacles::Node<T> query_obstacles(DEVICE& device, const PositionToPosition<T, TERMS>& params, const T position[3]){
+        if(params.course_generator != nullptr){
+            return obstacles::evaluate(device, position, params.course);
+        }
+        if(params.obstacle_field != nullptr){
+            return query(device, *params.obstacle_field, position);
+        }
+        if(params.obstacle_scene != nullptr){
+            return obstacles::evaluate(device, position, *params.obstacle_scene);
+        }
+        return {(T)obstacles::FAR, 0, obstacles::NONE};
+    }
+    // reward functions without obstacles
+    template<typename DEVICE, typename REWARD_FUNCTION, typename T>
+    RL_TOOLS_FUNCTION_PLACEMENT obstacles::Node<T> query_obstacles(DEVICE& device, const REWARD_FUNCTION& params, const T position[3]){
+        return {(T)obstacles::FAR, 0, obstacles::NONE};
+    }
+
+    // casts the rays of the range sensor (cf. observation::RangeSensor) against the obstacle course
+    template<typename DEVICE, typename T, terms::Mask TERMS>
+    RL_TOOLS_FUNCTION_PLACEMENT void raycast_obstacles(DEVICE& device, const PositionToPosition<T, TERMS>& params, const T origin[3], const T* direction_x, const T* direction_y, const T* direction_z, size_t N, T max_range, T* ranges){
+        if(params.course_generator != nullptr){
+            obstacles::raycast(device, origin, direction_x, direction_y, direction_z, N, params.course, max_range, ranges);
+        }
+        else{
+            obstacles::raycast(device, origin, direction_x, direction_y, direction_z, N, params.obstacle_scene != nullptr ? *params.obstacle_scene : obstacles::Scene{}, max_range, ranges);
+        }
+    }
+    template<typename DEVICE, typename REWARD_FUNCTION, typename T>
+    RL_TOOLS_FUNCTION_PLACEMENT void raycast_obstacles(DEVICE& device, const REWARD_FUNCTION& params, const T origin[3], const T* direction_x, const T* direction_y, const T* direction_z, size_t N, T max_range, T* ranges){
+        obstacles::raycast(device, origin, direction_x, direction_y, direction_z, N, obstacles::Scene{}, max_range, ranges);
+    }
+
+    // draws the course of the next episode around the spawn position (called by sample_initial_state)
+    template<typename DEVICE, typename T, terms::Mask TERMS, typename RNG>
+    RL_TOOLS_FUNCTION_PLACEMENT void sample_obstacle_course(DEVICE& device, PositionToPosition<T, TERMS>& params, const T position[3], RNG& rng){
+        if(params.course_generator != nullptr){
+            obstacles::sample(device, *params.course_generator, position, params.target_pos, params.course, rng);
+        }
+    }
+    template<typename DEVICE, typename REWARD_FUNCTION, typename T, typename RNG>
+    RL_TOOLS_FUNCTION_PLACEMENT void sample_obstacle_course(DEVICE& device, REWARD_FUNCTION& params, const T position[3], RNG& rng){ }
+
+    template<typename T, terms::Mask TERMS>
+    void set_obstacles(PositionToPosition<T, TERMS>& params, const obstacles::Scene* scene, const obstacles::Field<T>* field){
+        params.obstacle_scene = scene;
+        params.obstacle_field = field;
+    }
+    // reward functions without obstacles
+    template<typename REWARD_FUNCTION, typename T>
+    void set_obstacles(REWARD_FUNCTION& params, const obstacles::Scene* scene, const obstacles::Field<T>* field){ }
+
+    template<typename T, terms::Mask TERMS>
+    void set_course_generator(PositionToPosition<T, TERMS>& params, const obstacles::CourseGenerator* generator){
+        params.course_generator = generator;
+        params.course.num_cylinders = 0;
+        params.course.num_planes = 0;
+    }
+    template<typename REWARD_FUNCTION>
+    void set_course_generator(REWARD_FUNCTION& params, const obstacles::CourseGenerator* generator){ }
+
+    template<typename T, terms::Mask TERMS>
+    void set_reward_capture(PositionToPosition<T, TERMS>& params, Capture<T>* capture){
+        params.capture = capture;
+    }
+    // reward functions without components (abs_exp, sq_exp, absolute)
+    template<typename REWARD_FUNCTION, typename T>
+    void set_reward_capture(REWARD_FUNCTION& params, Capture<T>* capture){ }
+
+    template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename T, terms::Mask TERMS, typename RNG>
+    RL_TOOLS_FUNCTION_PLACEMENT static typename SPEC::T reward(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::parameters::reward_functions::PositionToPosition<T, TERMS>& params, const typename rl::environments::Multirotor<SPEC>::State& state, const Matrix<ACTION_SPEC>& action,  const typename rl::environments::Multirotor<SPEC>::State& next_state, RNG& rng) {
         auto components = reward_components(device, env, params, state, action, next_state, rng);
+        capture(params.capture, components);
         return components.reward;
     }
 
-    template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename T, typename RNG>
-    RL_TOOLS_FUNCTION_PLACEMENT void log_reward(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::parameters::reward_functions::PositionToPosition<T>& params, const typename rl::environments::Multirotor<SPEC>::State& state, const Matrix<ACTION_SPEC>& action,  const typename rl::environments::Multirotor<SPEC>::State& next_state, RNG& rng) {
+    template<typename DEVICE, typename SPEC, typename T, terms::Mask TERMS>
+    RL_TOOLS_FUNCTION_PLACEMENT void log_reward(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::parameters::reward_functions::PositionToPosition<T, TERMS>& params, const typename rl::environments::multirotor::parameters::reward_functions::PositionToPosition<T>::Components& components) {
         constexpr typename SPEC::TI cadence = 1;
-        auto components = reward_components(device, env, params, state, action, next_state, rng);
-        
+
         // Log target-specific metrics
         add_scalar(device, device.logger, "reward/target_distance", math::sqrt(device.math, components.position_cost), cadence);
         add_scalar(device, device.logger, "reward/position_cost",    components.position_cost, cadence);
@@ -337,6 +404,11 @@ namespace rl_tools::rl::environments::multirotor::parameters::reward_functions{
         add_scalar(device, device.logger, "reward/reward",               components.reward, cadence);
         add_scalar(device, device.logger, "reward/reward_zero",          components.reward == 0, cadence);
     }
+
+    template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename T, terms::Mask TERMS, typename RNG>
+    RL_TOOLS_FUNCTION_PLACEMENT void log_reward(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::parameters::reward_functions::PositionToPosition<T, TERMS>& params, const typename rl::environments::Multirotor<SPEC>::State& state, const Matrix<ACTION_SPEC>& action,  const typename rl::environments::Multirotor<SPEC>::State& next_state, RNG& rng) {
+        log_reward(device, env, params, reward_components(device, env, params, state, action, next_state, rng));
+    }
 }
 
 #endif
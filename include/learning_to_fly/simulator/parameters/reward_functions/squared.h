@@ -4,10 +4,28 @@
 #include "../../multirotor.h"
 #include <rl_tools/utils/generic/typing.h>
 #include <rl_tools/utils/generic/vector_operations.h>
+#include "terms.h"
+#include "capture.h"
 
 namespace rl_tools::rl::environments::multirotor::parameters::reward_functions{
     template<typename T>
+    struct SquaredComponents{
+        T orientation_cost;
+        T position_cost;
+        T linear_vel_cost;
+        T angular_vel_cost;
+        T linear_acc_cost;
+        T angular_acc_cost;
+        T action_cost;
+        T weighted_cost;
+        T scaled_weighted_cost;
+        T reward;
+        bool terminated;
+    };
+    // T_TERMS: weighted cost terms that are evaluated (cf. terms.h), the weights of the others are ignored
+    template<typename T, terms::Mask T_TERMS = terms::ALL>
     struct Squared{
+        static constexpr terms::Mask TERMS = T_TERMS;
         bool non_negative;
         T scale;
         T constant;
@@ -20,44 +38,62 @@ namespace rl_tools::rl::environments::multirotor::parameters::reward_functions{
         T angular_acceleration;
         T action_baseline;
         T action;
-        struct Components{
-            T orientation_cost;
-            T position_cost;
-            T linear_vel_cost;
-            T angular_vel_cost;
-            T linear_acc_cost;
-            T angular_acc_cost;
-            T action_cost;
-            T weighted_cost;
-            T scaled_weighted_cost;
-            T reward;
-        };
+        // components of the labeled transitions (shared, not owned, cf. capture.h). nullptr: not captured
+        Capture<T>* capture = nullptr;
+        // shared by all TERMS (reward_components always returns Squared<T>::Components)
+        using Components = SquaredComponents<T>;
     };
-    template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename T, typename RNG>
-    RL_TOOLS_FUNCTION_PLACEMENT typename rl::environments::multirotor::parameters::reward_functions::Squared<T>::Components reward_components(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::parameters::reward_functions::Squared<T>& params, const typename rl::environments::Multirotor<SPEC>::State& state, const Matrix<ACTION_SPEC>& action,  const typename rl::environments::Multirotor<SPEC>::State& next_state, RNG& rng){
+    template<terms::Mask TERMS, typename T, terms::Mask SOURCE_TERMS>
+    constexpr Squared<T, TERMS> prune(const Squared<T, SOURCE_TERMS>& params){
+        return {params.non_negative, params.scale, params.constant, params.termination_penalty, params.position, params.orientation, params.linear_velocity, params.angular_velocity, params.linear_acceleration, params.angular_acceleration, params.action_baseline, params.action, params.capture};
+    }
+    // terminated_flag is the result of terminated(device, env, next_state, rng), it is passed in so that a fused step (step_full) evaluates it only once
+    template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename T, terms::Mask TERMS>
+    RL_TOOLS_FUNCTION_PLACEMENT typename rl::environments::multirotor::parameters::reward_functions::Squared<T>::Components reward_components(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::parameters::reward_functions::Squared<T, TERMS>& params, const typename rl::environments::Multirotor<SPEC>::State& state, const Matrix<ACTION_SPEC>& action,  const typename rl::environments::Multirotor<SPEC>::State& next_state, bool terminated_flag){
         using TI = typename DEVICE::index_t;
         constexpr TI ACTION_DIM = rl::environments::Multirotor<SPEC>::ACTION_DIM;
-        typename rl::environments::multirotor::parameters::reward_functions::Squared<T>::Components components;
-        components.orientation_cost = 1 - state.orientation[0] * state.orientation[0]; //math::abs(device.math, 2 * math::acos(device.math, quaternion_w));
-        components.position_cost = state.position[0] * state.position[0] + state.position[1] * state.position[1] + state.position[2] * state.position[2];
-        components.linear_vel_cost = state.linear_velocity[0] * state.linear_velocity[0] + state.linear_velocity[1] * state.linear_velocity[1] + state.linear_velocity[2] * state.linear_velocity[2];
-        components.angular_vel_cost = state.angular_velocity[0] * state.angular_velocity[0] + state.angular_velocity[1] * state.angular_velocity[1] + state.angular_velocity[2] * state.angular_velocity[2];
-        T linear_acc[3];
-        T angular_acc[3];
-        utils::vector_operations::sub<DEVICE, T, 3>(next_state.linear_velocity, state.linear_velocity, linear_acc);
-        components.linear_acc_cost = (linear_acc[0] * linear_acc[0] + linear_acc[1] * linear_acc[1] + linear_acc[2] * linear_acc[2]) / (env.parameters.integration.dt * env.parameters.integration.dt);
-        utils::vector_operations::sub<DEVICE, T, 3>(next_state.angular_velocity, state.angular_velocity, angular_acc);
-        components.angular_acc_cost = (angular_acc[0] * angular_acc[0] + angular_acc[1] * angular_acc[1] + angular_acc[2] * angular_acc[2]) / (env.parameters.integration.dt * env.parameters.integration.dt);
-
-        T action_diff[ACTION_DIM];
-        for(TI i = 0; i < ACTION_DIM; i++){
-            action_diff[i] = get(action, 0, i) - params.action_baseline;
+        typename rl::environments::multirotor::parameters::reward_functions::Squared<T>::Components components = {};
+        // disabled terms are neither computed nor weighted (their components stay 0)
+        components.weighted_cost = 0;
+        if constexpr((TERMS & terms::POSITION) != 0){
+            components.position_cost = state.position[0] * state.position[0] + state.position[1] * state.position[1] + state.position[2] * state.position[2];
+            components.weighted_cost += params.position * components.position_cost;
+        }
+        if constexpr((TERMS & terms::ORIENTATION) != 0){
+            components.orientation_cost = 1 - state.orientation[0] * state.orientation[0]; //math::abs(device.math, 2 * math::acos(device.math, quaternion_w));
+            components.weighted_cost += params.orientation * components.orientation_cost;
+        }
+        if constexpr((TERMS & terms::LINEAR_VELOCITY) != 0){
+            components.linear_vel_cost = state.linear_velocity[0] * state.linear_velocity[0] + state.linear_velocity[1] * state.linear_velocity[1] + state.linear_velocity[2] * state.linear_velocity[2];
+            components.weighted_cost += params.linear_velocity * components.linear_vel_cost;
+        }
+        if constexpr((TERMS & terms::ANGULAR_VELOCITY) != 0){
+            components.angular_vel_cost = state.angular_velocity[0] * state.angular_velocity[0] + state.angular_velocity[1] * state.angular_velocity[1] + state.angular_velocity[2] * state.angular_velocity[2];
+            components.weighted_cost += params.angular_velocity * components.angular_vel_cost;
+        }
+        if constexpr((TERMS & terms::LINEAR_ACCELERATION) != 0){
+            T linear_acc[3];
+            utils::vector_operations::sub<DEVICE, T, 3>(next_state.linear_velocity, state.linear_velocity, linear_acc);
+            components.linear_acc_cost = (linear_acc[0] * linear_acc[0] + linear_acc[1] * linear_acc[1] + linear_acc[2] * linear_acc[2]) / (env.parameters.integration.dt * env.parameters.integration.dt);
+            components.weighted_cost += params.linear_acceleration * components.linear_acc_cost;
+        }
+        if constexpr((TERMS & terms::ANGULAR_ACCELERATION) != 0){
+            T angular_acc[3];
+            utils::vector_operations::sub<DEVICE, T, 3>(next_state.angular_velocity, state.angular_velocity, angular_acc);
+            components.angular_acc_cost = (angular_acc[0] * angular_acc[0] + angular_acc[1] * angular_acc[1] + angular_acc[2] * angular_acc[2]) / (env.parameters.integration.dt * env.parameters.integration.dt);
+            components.weighted_cost += params.angular_acceleration * components.angular_acc_cost;
+        }
+        if constexpr((TERMS & terms::ACTION) != 0){
+            T action_diff[ACTION_DIM];
+            for(TI i = 0; i < ACTION_DIM; i++){
+                action_diff[i] = get(action, 0, i) - params.action_baseline;
+            }
+            components.action_cost = utils::vector_operations::norm<DEVICE, T, ACTION_DIM>(action_diff);
+            components.action_cost *= components.action_cost;
+            components.weighted_cost += params.action * components.action_cost;
         }
-        components.action_cost = utils::vector_operations::norm<DEVICE, T, ACTION_DIM>(action_diff);
-        components.action_cost *= components.action_cost;
-        components.weighted_cost = params.position * components.position_cost + params.orientation * components.orientation_cost + params.linear_velocity * components.linear_vel_cost + params.angular_velocity * components.angular_vel_cost + params.linear_acceleration * components.linear_acc_cost + params.angular_acceleration * components.angular_acc_cost + params.action * components.action_cost;
-        bool terminated_flag = terminated(device, env, next_state, rng);
         components.scaled_weighted_cost = params.scale * components.weighted_cost;
+        components.terminated = terminated_flag;
 
         if(terminated_flag){
             components.reward = params.termination_penalty;
@@ -69,10 +105,13 @@ namespace rl_tools::rl::environments::multirotor::parameters::reward_functions{
 
         return components;
     }
-    template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename T, typename RNG>
-    RL_TOOLS_FUNCTION_PLACEMENT void log_reward(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::parameters::reward_functions::Squared<T>& params, const typename rl::environments::Multirotor<SPEC>::State& state, const Matrix<ACTION_SPEC>& action,  const typename rl::environments::Multirotor<SPEC>::State& next_state, RNG& rng) {
+    template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename T, terms::Mask TERMS, typename RNG>
+    RL_TOOLS_FUNCTION_PLACEMENT typename rl::environments::multirotor::parameters::reward_functions::Squared<T>::Components reward_components(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::parameters::reward_functions::Squared<T, TERMS>& params, const typename rl::environments::Multirotor<SPEC>::State& state, const Matrix<ACTION_SPEC>& action,  const typename rl::environments::Multirotor<SPEC>::State& next_state, RNG& rng){
+        return reward_components(device, env, params, state, action, next_state, terminated(device, env, next_state, rng));
+    }
+    template<typename DEVICE, typename SPEC, typename T, terms::Mask TERMS>
+    RL_TOOLS_FUNCTION_PLACEMENT void log_reward(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::parameters::reward_functions::Squared<T, TERMS>& params, const typename rl::environments::multirotor::parameters::reward_functions::Squared<T>::Components& components) {
         constexpr typename SPEC::TI cadence = 1;
-        auto components = reward_components(device, env, params, state, action, next_state, rng);
         add_scalar(device, device.logger, "reward/orientation_cost", components.orientation_cost, cadence);
         add_scalar(device, device.logger, "reward/position_cost",    components.position_cost, cadence);
         add_scalar(device, device.logger, "reward/linear_vel_cost",  components.linear_vel_cost, cadence);
@@ -104,11 +143,21 @@ namespace rl_tools::rl::environments::multirotor::parameters::reward_functions{
         add_scalar(device, device.logger, "reward/reward",               components.reward, cadence);
         add_scalar(device, device.logger, "reward/reward_zero",          components.reward == 0, cadence);
     }
-    template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename T, typename RNG>
-    RL_TOOLS_FUNCTION_PLACEMENT typename SPEC::T reward(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::parameters::reward_functions::Squared<T>& params, const typename rl::environments::Multirotor<SPEC>::State& state, const Matrix<ACTION_SPEC>& action,  const typename rl::environments::Multirotor<SPEC>::State& next_state, RNG& rng){
+    template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename T, terms::Mask TERMS, typename RNG>
+    RL_TOOLS_FUNCTION_PLACEMENT void log_reward(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::parameters::reward_functions::Squared<T, TERMS>& params, const typename rl::environments::Multirotor<SPEC>::State& state, const Matrix<ACTION_SPEC>& action,  const typename rl::environments::Multirotor<SPEC>::State& next_state, RNG& rng) {
+        log_reward(device, env, params, reward_components(device, env, params, state, action, next_state, rng));
+    }
+    template<typename DEVICE, typename SPEC, typename ACTION_SPEC, typename T, terms::Mask TERMS, typename RNG>
+    RL_TOOLS_FUNCTION_PLACEMENT typename SPEC::T reward(DEVICE& device, const rl::environments::Multirotor<SPEC>& env, const rl::environments::multirotor::parameters::reward_functions::Squared<T, TERMS>& params, const typename rl::environments::Multirotor<SPEC>::State& state, const Matrix<ACTION_SPEC>& action,  const typename rl::environments::Multirotor<SPEC>::State& next_state, RNG& rng){
         auto components = reward_components(device, env, params, state, action, next_state, rng);
+        capture(params.capture, components);
         return components.reward;
     }
+
+    template<typename T, terms::Mask TERMS>
+    void set_reward_capture(Squared<T, TERMS>& params, Capture<T>* capture){
+        params.capture = capture;
+    }
 }
 
 #endif
\ No newline at end of file
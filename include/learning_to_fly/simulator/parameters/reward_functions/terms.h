@@ -0,0 +1,32 @@
+#ifndef LEARNING_TO_FLY_IN_SECONDS_SIMULATOR_PARAMETERS_REWARD_FUNCTIONS_TERMS_H
+#define LEARNING_TO_FLY_IN_SECONDS_SIMULATOR_PARAMETERS_REWARD_FUNCTIONS_TERMS_H
+
+// Compile-time set of the weighted cost terms a reward function evaluates. Reward functions carry it as a template parameter
+// (default: ALL) and skip the computation of disabled terms in reward_components (their components are reported as 0).
+// Use prune<terms::nonzero(params) | RUNTIME_TERMS>(params) to drop the terms that have a zero weight in a constexpr
+// parameter set, keeping the ones whose weight is changed at runtime (e.g. by the curriculum).
+namespace rl_tools::rl::environments::multirotor::parameters::reward_functions::terms{
+    using Mask = unsigned;
+    static constexpr Mask POSITION             = 1 << 0;
+    static constexpr Mask ORIENTATION          = 1 << 1;
+    static constexpr Mask LINEAR_VELOCITY      = 1 << 2;
+    static constexpr Mask ANGULAR_VELOCITY     = 1 << 3;
+    static constexpr Mask LINEAR_ACCELERATION  = 1 << 4;
+    static constexpr Mask ANGULAR_ACCELERATION = 1 << 5;
+    static constexpr Mask ACTION               = 1 << 6;
+    static constexpr Mask ALL = POSITION | ORIENTATION | LINEAR_VELOCITY | ANGULAR_VELOCITY | LINEAR_ACCELERATION | ANGULAR_ACCELERATION | ACTION;
+
+    // terms with a non-zero weight
+    template<typename PARAMS>
+    constexpr Mask nonzero(const PARAMS& params){
+        return (params.position             != 0 ? POSITION             : 0)
+             | (params.orientation          != 0 ? ORIENTATION          : 0)
+             | (params.linear_velocity      != 0 ? LINEAR_VELOCITY      : 0)
+             | (params.angular_velocity     != 0 ? ANGULAR_VELOCITY     : 0)
+             | (params.linear_acceleration  != 0 ? LINEAR_ACCELERATION  : 0)
+             | (params.angular_acceleration != 0 ? ANGULAR_ACCELERATION : 0)
+             | (params.action               != 0 ? ACTION               : 0);
+    }
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef LEARNING_TO_FLY_IN_SECONDS_SIMULATOR_RANDOM_BLOCK_H
+#define LEARNING_TO_FLY_IN_SECONDS_SIMULATOR_RANDOM_BLOCK_H
+
+#include <stdint.h>
+
+#ifndef RL_TOOLS_FUNCTION_PLACEMENT
+#define RL_TOOLS_FUNCTION_PLACEMENT
+#endif
+
+// Block generation of Gaussian noise. Instead of drawing every sample through random::normal_distribution::sample (one call
+// into the sequential engine per element), a block of samples is produced from a counter-based generator (Philox4x32-10)
+// that is keyed by two draws from the engine that is passed in. The blocks are independent of each other, the inner loop
+// has no loop-carried dependency and every four Philox outputs yield four normal samples through Box-Muller.
+
+namespace rl_tools::random::block{
+    namespace philox{
+        static constexpr uint32_t M0 = 0xD2511F53;
+        static constexpr uint32_t M1 = 0xCD9E8D57;
+        static constexpr uint32_t W0 = 0x9E3779B9;
+        static constexpr uint32_t W1 = 0xBB67AE85;
+        static constexpr uint32_t ROUNDS = 10;
+        RL_TOOLS_FUNCTION_PLACEMENT inline void generate(const uint32_t counter_in[4], const uint32_t key_in[2], uint32_t out[4]){
+            uint32_t c[4] = {counter_in[0], counter_in[1], counter_in[2], counter_in[3]};
+            uint32_t k[2] = {key_in[0], key_in[1]};
+            for(uint32_t round_i = 0; round_i < ROUNDS; round_i++){
+                uint64_t p0 = (uint64_t)M0 * c[0];
+                uint64_t p1 = (uint64_t)M1 * c[2];
+                uint32_t c0 = (uint32_t)(p1 >> 32) ^ c[1] ^ k[0];
+                uint32_t c2 = (uint32_t)(p0 >> 32) ^ c[3] ^ k[1];
+                c[1] = (uint32_t)p1;
+                c[3] = (uint32_t)p0;
+                c[0] = c0;
+                c[2] = c2;
+                k[0] += W0;
+                k[1] += W1;
+            }
+            for(uint32_t i = 0; i < 4; i++){
+                out[i] = c[i];
+            }
+        }
+    }
+    struct Key{
+        uint32_t value[2];
+    };
+    // one key per block: two draws from the (sequential) engine instead of one per sample
+    template<typename DEVICE, typename RNG>
+    RL_TOOLS_FUNCTION_PLACEMENT Key key(DEVICE& device, RNG& rng){
+        using TI = typename DEVICE::index_t;
+        constexpr TI MAX = 0x7FFFFFFF;
+        Key key;
+        key.value[0] = (uint32_t)random::uniform_int_distribution(typename DEVICE::SPEC::RANDOM(), (TI)0, MAX, rng);
+        key.value[1] = (uint32_t)random::uniform_int_distribution(typename DEVICE::SPEC::RANDOM(), (TI)0, MAX, rng);
+        return key;
+    }
+    // Fills out[0, N) with standard normal samples derived from (key, offset + i). Samples for the same key and index are
+    // identical, hence a block can be filled piecewise (e.g. per lane) and reproduces the result of a single call.
+    template<typename DEVICE, typename T, typename TI>
+    RL_TOOLS_FUNCTION_PLACEMENT void normal(DEVICE& device, const Key& key, T* out, TI N, TI offset = 0){
+        constexpr T TWO_TO_MINUS_24 = (T)1 / (T)16777216;
+        const TI first_block = offset / 4;
+        const TI last_block = (offset + N + 3) / 4;
+        for(TI block_i = first_block; block_i < last_block; block_i++){
+            uint32_t counter[4] = {(uint32_t)block_i, (uint32_t)((uint64_t)block_i >> 32), 0, 0};
+            uint32_t bits[4];
+            philox::generate(counter, key.value, bits);
+            T z[4];
+            for(TI pair_i = 0; pair_i < 2; pair_i++){
+                // u1 in (0, 1] so that the logarithm is finite
+                T u1 = (T)((bits[2*pair_i + 0] >> 8) + 1) * TWO_TO_MINUS_24;
+                T u2 = (T)(bits[2*pair_i + 1] >> 8) * TWO_TO_MINUS_24;
+                T r = math::sqrt(device.math, -2 * math::log(device.math, u1));
+                T theta = 2 * math::PI<T> * u2;
+                z[2*pair_i + 0] = r * math::cos(device.math, theta);
+                z[2*pair_i + 1] = r * math::sin(device.math, theta);
+            }
+            for(TI i = 0; i < 4; i++){
+                TI sample_i = block_i * 4 + i;
+                if(sample_i >= offset && sample_i < offset + N){
+                    out[sample_i - offset] = z[i];
+                }
+            }
+        }
+    }
+    template<typename DEVICE, typename T, typename TI, typename RNG>
+    RL_TOOLS_FUNCTION_PLACEMENT void normal(DEVICE& device, T* out, TI N, RNG& rng){
+        normal(device, key(device, rng), out, N);
+    }
+    // Gaussian noise with standard deviation std, clipped to [-clip, clip], for all entries of a matrix (e.g. the TD3 target action noise)
+    template<typename DEVICE, typename SPEC, typename RNG>
+    void normal(DEVICE& device, Matrix<SPEC>& m, typename SPEC::T std, typename SPEC::T clip, RNG& rng){
+        using T = typename SPEC::T;
+        using TI = typename SPEC::TI;
+        constexpr TI BLOCK_SIZE = 256;
+        T block[BLOCK_SIZE];
+        TI block_fill = BLOCK_SIZE;
+        for(TI row_i = 0; row_i < SPEC::ROWS; row_i++){
+            for(TI col_i = 0; col_i < SPEC::COLS; col_i++){
+                if(block_fill == BLOCK_SIZE){
+                    normal(device, block, BLOCK_SIZE, rng);
+                    block_fill = 0;
+                }
+                set(m, row_i, col_i, math::clamp(device.math, block[block_fill++] * std, -clip, clip));
+            }
+        }
+    }
+}
+
+#endif
@@ -33,8 +33,7 @@ namespace rl_tools::rl::environments::multirotor {
         message["channel"] = "setDroneState";
         message["data"]["id"] = ui.id;
         message["data"]["data"]["pose"]["position"] = {state.position[0], state.position[1], state.position[2]};
-        typename ENVIRONMENT::T orientation[3][3];
-        quaternion_to_rotation_matrix<DEVICE, typename ENVIRONMENT::T>(state.orientation, orientation);
+        const auto& orientation = state.rotation_matrix;
         message["data"]["data"]["pose"]["orientation"] = {
                 {orientation[0][0], orientation[0][1], orientation[0][2]},
                 {orientation[1][0], orientation[1][1], orientation[1][2]},
@@ -47,6 +46,11 @@ namespace rl_tools::rl::environments::multirotor {
                 {"power", 0},
         };
         message["data"]["data"]["using_hover_actor"] = using_hover_actor;
+        message["data"]["data"]["obstacle"] = {
+                {"distance", state.obstacle_distance},
+                {"id", state.obstacle_id},
+                {"collision", state.obstacle_collision}
+        };
         return message;
     }
     template <typename DEVICE, typename ENVIRONMENT, typename ACTION_SPEC>
@@ -0,0 +1,274 @@
+#ifndef LEARNING_TO_FLY_ASYNC_COLLECTION_H
+#define LEARNING_TO_FLY_ASYNC_COLLECTION_H
+
+#include "policy_switching.h"
+#include "constants.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace learning_to_fly {
+/**
+ * Asynchronous data collection (CONFIG::ASYNC_COLLECTION). Collector threads step their share of the environments with the
+ * latest published snapshot of the actor and push the transitions through one lock-free single-producer single-consumer
+ * queue per collector. The training thread (learner) drains the queues into the replay buffers and runs the TD3 updates in
+ * the meantime, it publishes new actor weights into the idle half of a double buffer and swaps it in atomically
+ * (cf. steps/async_collection.h). The replay buffers, the episode bookkeeping of the off-policy runner, the reward capture
+ * and the relabeling versions are only touched by the learner.
+ */
+namespace async_collection {
+    // Bounded single-producer single-consumer ring. push/pop return false instead of blocking when the queue is full/empty
+    template <typename ELEMENT, size_t CAPACITY>
+    struct Queue {
+        static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY has to be a power of two");
+        ELEMENT slots[CAPACITY];
+        alignas(64) std::atomic<size_t> head{0}; // next slot to read, owned by the consumer
+        alignas(64) std::atomic<size_t> tail{0}; // next slot to write, owned by the producer
+        bool push(const ELEMENT& element) {
+            size_t current_tail = tail.load(std::memory_order_relaxed);
+            if (current_tail - head.load(std::memory_order_acquire) == CAPACITY) {
+                return false;
+            }
+            slots[current_tail % CAPACITY] = element;
+            tail.store(current_tail + 1, std::memory_order_release);
+            return true;
+        }
+        bool pop(ELEMENT& element) {
+            size_t current_head = head.load(std::memory_order_relaxed);
+            if (current_head == tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            element = slots[current_head % CAPACITY];
+            head.store(current_head + 1, std::memory_order_release);
+            return true;
+        }
+    };
+
+    // one replay buffer row plus the bookkeeping the learner needs to insert it
+    template <typename CONFIG>
+    struct Transition {
+        using T = typename CONFIG::T;
+        using TI = typename CONFIG::TI;
+        using ENVIRONMENT = typename CONFIG::ENVIRONMENT;
+        static constexpr TI OBSERVATION_DIM_PRIVILEGED = CONFIG::ASYMMETRIC_OBSERVATIONS ? ENVIRONMENT::OBSERVATION_DIM_PRIVILEGED : 1;
+        TI env_i;
+        uint32_t reward_version; // version of the reward parameters the reward was computed with (cf. reward_relabeling.h)
+        typename ENVIRONMENT::State state;
+        typename ENVIRONMENT::State next_state;
+        T observation[ENVIRONMENT::OBSERVATION_DIM];
+        T observation_privileged[OBSERVATION_DIM_PRIVILEGED];
+        T next_observation[ENVIRONMENT::OBSERVATION_DIM];
+        T next_observation_privileged[OBSERVATION_DIM_PRIVILEGED];
+        T action[ENVIRONMENT::ACTION_DIM];
+        T reward;
+        bool terminated;
+        bool truncated;
+        bool using_hover; // the action was taken by the hover actor (policy switching)
+        typename ENVIRONMENT::REWARD_FUNCTION::Components components;
+    };
+
+    // everything a collector takes from the learner. The environment parameters are adopted at the next episode start only,
+    // so that the obstacle course of a running episode is not replaced
+    template <typename CONFIG>
+    struct Snapshot {
+        typename CONFIG::ACTOR_TARGET_TYPE actor;
+        typename CONFIG::ENVIRONMENT::PARAMETERS parameters[CONFIG::N_ENVIRONMENTS];
+        uint32_t reward_version[CONFIG::N_ENVIRONMENTS];
+        typename CONFIG::T exploration_noise;
+    };
+
+    template <typename CONFIG>
+    struct Pipeline {
+        using T = typename CONFIG::T;
+        using TI = typename CONFIG::TI;
+        static constexpr TI NUM_COLLECTORS = std::min<TI>(CONFIG::ASYNC_COLLECTORS, CONFIG::N_ENVIRONMENTS);
+        static_assert(NUM_COLLECTORS > 0);
+        Queue<Transition<CONFIG>, CONFIG::ASYNC_QUEUE_CAPACITY> queues[NUM_COLLECTORS];
+        // double buffer: collectors copy from snapshots[published], the learner writes the other half once no collector reads it
+        Snapshot<CONFIG> snapshots[2];
+        std::atomic<uint32_t> published{0};
+        std::atomic<uint32_t> readers[2] = {};
+        std::atomic<uint64_t> version{0}; // number of publishes
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> collectors;
+        // read-only while the collectors run
+        const typename CONFIG::ACTOR_TYPE* hover_actor = nullptr;
+        bool use_policy_switching = false;
+        T policy_switch_threshold = 0;
+        // learner side
+        Transition<CONFIG> transition; // drain buffer (too large for the stack of the training loop)
+        TI next_queue = 0;
+        TI stalls = 0; // drains that had to wait for a collector since the last report
+        TI skipped_publishes = 0;
+    };
+
+    // Copies the current snapshot if a newer one was published since seen_version. Returns false if there is none.
+    template <typename DEVICE, typename CONFIG>
+    bool acquire(DEVICE& device, Pipeline<CONFIG>& pipeline, uint64_t& seen_version, typename CONFIG::ACTOR_TARGET_TYPE& actor, Snapshot<CONFIG>& target) {
+        uint64_t version = pipeline.version.load();
+        if (version == seen_version) {
+            return false;
+        }
+        while (true) {
+            uint32_t slot = pipeline.published.load();
+            pipeline.readers[slot].fetch_add(1);
+            // the learner only writes a slot that is not published and has no readers, re-check after registering
+            if (pipeline.published.load() == slot) {
+                const Snapshot<CONFIG>& snapshot = pipeline.snapshots[slot];
+                rlt::copy(device, device, snapshot.actor, actor);
+                for (typename CONFIG::TI env_i = 0; env_i < CONFIG::N_ENVIRONMENTS; env_i++) {
+                    target.parameters[env_i] = snapshot.parameters[env_i];
+                    target.reward_version[env_i] = snapshot.reward_version[env_i];
+                }
+                target.exploration_noise = snapshot.exploration_noise;
+                pipeline.readers[slot].fetch_sub(1);
+                break;
+            }
+            pipeline.readers[slot].fetch_sub(1);
+        }
+        seen_version = version;
+        return true;
+    }
+
+    // Collector thread: steps the environments collector_i, collector_i + NUM_COLLECTORS, ... in turn until pipeline.stop is set
+    template <typename CONFIG>
+    void collect(Pipeline<CONFIG>& pipeline, typename CONFIG::TI collector_i, typename CONFIG::TI seed) {
+        using T = typename CONFIG::T;
+        using TI = typename CONFIG::TI;
+        using DEVICE = typename CONFIG::DEVICE;
+        using ENVIRONMENT = typename CONFIG::ENVIRONMENT;
+        constexpr TI NUM_COLLECTORS = Pipeline<CONFIG>::NUM_COLLECTORS;
+        constexpr TI NUM_ENVIRONMENTS = (CONFIG::N_ENVIRONMENTS + NUM_COLLECTORS - 1) / NUM_COLLECTORS;
+        DEVICE device;
+        auto rng = rlt::random::default_engine(typename DEVICE::SPEC::RANDOM{}, seed);
+
+        typename CONFIG::ACTOR_TARGET_TYPE actor;
+        typename CONFIG::ACTOR_TARGET_TYPE::template DoubleBuffer<1> actor_buffer;
+        typename CONFIG::ACTOR_TYPE::template DoubleBuffer<1> hover_actor_buffer;
+        rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, ENVIRONMENT::OBSERVATION_DIM>> observation;
+        rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, ENVIRONMENT::OBSERVATION_DIM_PRIVILEGED>> observation_privileged;
+        rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, ENVIRONMENT::ACTION_DIM>> action;
+        rlt::malloc(device, actor);
+        rlt::malloc(device, actor_buffer);
+        rlt::malloc(device, hover_actor_buffer);
+        rlt::malloc(device, observation);
+        rlt::malloc(device, observation_privileged);
+        rlt::malloc(device, action);
+
+        Snapshot<CONFIG>* snapshot = new Snapshot<CONFIG>; // parameters only, the weights are copied into actor
+        uint64_t seen_version = 0;
+        while (!acquire(device, pipeline, seen_version, actor, *snapshot)) {
+            std::this_thread::yield();
+        }
+
+        TI env_indices[NUM_ENVIRONMENTS];
+        ENVIRONMENT envs[NUM_ENVIRONMENTS];
+        typename ENVIRONMENT::State states[NUM_ENVIRONMENTS];
+        TI episode_step[NUM_ENVIRONMENTS];
+        bool using_hover[NUM_ENVIRONMENTS];
+        uint32_t reward_version[NUM_ENVIRONMENTS];
+        TI num_environments = 0;
+        for (TI env_i = collector_i; env_i < CONFIG::N_ENVIRONMENTS; env_i += NUM_COLLECTORS) {
+            env_indices[num_environments] = env_i;
+            episode_step[num_environments] = 0;
+            num_environments++;
+        }
+
+        Transition<CONFIG>* transition = new Transition<CONFIG>;
+        auto& queue = pipeline.queues[collector_i];
+        while (!pipeline.stop.load(std::memory_order_relaxed)) {
+            acquire(device, pipeline, seen_version, actor, *snapshot);
+            for (TI local_i = 0; local_i < num_environments; local_i++) {
+                ENVIRONMENT& env = envs[local_i];
+                typename ENVIRONMENT::State& state = states[local_i];
+                if (episode_step[local_i] == 0) {
+                    env.parameters = snapshot->parameters[env_indices[local_i]];
+                    reward_version[local_i] = snapshot->reward_version[env_indices[local_i]];
+                    rlt::sample_initial_state(device, env, state, rng);
+                    using_hover[local_i] = false;
+                }
+                rlt::observe(device, env, state, observation, rng);
+                if constexpr (CONFIG::ASYMMETRIC_OBSERVATIONS) {
+                    rlt::observe_privileged(device, env, state, observation_privileged, rng);
+                }
+                for (TI i = 0; i < ENVIRONMENT::OBSERVATION_DIM; i++) {
+                    transition->observation[i] = rlt::get(observation, 0, i);
+                }
+                if constexpr (CONFIG::ASYMMETRIC_OBSERVATIONS) {
+                    for (TI i = 0; i < ENVIRONMENT::OBSERVATION_DIM_PRIVILEGED; i++) {
+                        transition->observation_privileged[i] = rlt::get(observation_privileged, 0, i);
+                    }
+                }
+
+                // same (sticky) policy switching as off_policy_runner::interlude_with_policy_switching
+                if (pipeline.use_policy_switching && !using_hover[local_i]) {
+                    using_hover[local_i] = policy_switching::calculate_distance_to_target<T>(state.position) < pipeline.policy_switch_threshold;
+                }
+                if (pipeline.use_policy_switching && using_hover[local_i]) {
+                    T target_pos[3];
+                    constants::get_target_position<T>(target_pos);
+                    policy_switching::transform_observation_to_target_relative(device, observation, target_pos);
+                    rlt::evaluate(device, *pipeline.hover_actor, observation, action, hover_actor_buffer);
+                }
+                else {
+                    rlt::evaluate(device, actor, observation, action, actor_buffer);
+                }
+                // Gaussian exploration noise, clipped to the action limits
+                T noise[ENVIRONMENT::ACTION_DIM];
+                rlt::random::block::normal(device, rlt::random::block::key(device, rng), noise, ENVIRONMENT::ACTION_DIM);
+                for (TI i = 0; i < ENVIRONMENT::ACTION_DIM; i++) {
+                    T value = rlt::get(action, 0, i) + snapshot->exploration_noise * noise[i];
+                    value = std::min<T>(std::max<T>(value, -1), 1);
+                    rlt::set(action, 0, i, value);
+                    transition->action[i] = value;
+                }
+
+                auto step_result = rlt::step_full(device, env, state, action, transition->next_state, rng);
+                rlt::observe(device, env, transition->next_state, observation, rng);
+                for (TI i = 0; i < ENVIRONMENT::OBSERVATION_DIM; i++) {
+                    transition->next_observation[i] = rlt::get(observation, 0, i);
+                }
+                if constexpr (CONFIG::ASYMMETRIC_OBSERVATIONS) {
+                    rlt::observe_privileged(device, env, transition->next_state, observation_privileged, rng);
+                    for (TI i = 0; i < ENVIRONMENT::OBSERVATION_DIM_PRIVILEGED; i++) {
+                        transition->next_observation_privileged[i] = rlt::get(observation_privileged, 0, i);
+                    }
+                }
+                episode_step[local_i]++;
+                transition->env_i = env_indices[local_i];
+                transition->reward_version = reward_version[local_i];
+                transition->state = state;
+                transition->reward = step_result.reward;
+                transition->terminated = step_result.terminated;
+                transition->truncated = !step_result.terminated && episode_step[local_i] >= CONFIG::ENVIRONMENT_STEP_LIMIT;
+                transition->using_hover = pipeline.use_policy_switching && using_hover[local_i];
+                transition->components = step_result.components;
+                state = transition->next_state;
+                if (transition->terminated || transition->truncated) {
+                    episode_step[local_i] = 0;
+                }
+                // back pressure: the collectors run at most ASYNC_QUEUE_CAPACITY transitions ahead of the learner
+                while (!queue.push(*transition)) {
+                    if (pipeline.stop.load(std::memory_order_relaxed)) {
+                        break;
+                    }
+                    std::this_thread::yield();
+                }
+            }
+        }
+        delete transition;
+        delete snapshot;
+        rlt::free(device, actor);
+        rlt::free(device, actor_buffer);
+        rlt::free(device, hover_actor_buffer);
+        rlt::free(device, observation);
+        rlt::free(device, observation_privileged);
+        rlt::free(device, action);
+    }
+}
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef LEARNING_TO_FLY_BACKGROUND_EVALUATION_H
+#define LEARNING_TO_FLY_BACKGROUND_EVALUATION_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace learning_to_fly {
+/**
+ * Deterministic evaluation off the training thread (CONFIG::BACKGROUND_EVALUATION, cf. steps/evaluation.h). The learner
+ * snapshots actor_target into a Job and submits it to a small pool of worker threads. The jobs only read the observation
+ * normalization of the training state; the learner delivers the finished jobs in submission order.
+ */
+namespace background_evaluation {
+    // fixed number of threads working off a FIFO of tasks
+    class WorkerPool {
+    public:
+        explicit WorkerPool(unsigned num_threads) {
+            for (unsigned thread_i = 0; thread_i < num_threads; thread_i++) {
+                threads.emplace_back([this]() { work(); });
+            }
+        }
+        ~WorkerPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            condition.notify_all();
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+        void submit(std::function<void()> task) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                tasks.push_back(std::move(task));
+            }
+            condition.notify_one();
+        }
+        unsigned size() const { return threads.size(); }
+    private:
+        void work() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                    // remaining tasks are finished before the pool shuts down
+                    if (tasks.empty()) {
+                        return;
+                    }
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+        std::vector<std::thread> threads;
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool stopping = false;
+    };
+
+    template <typename CONFIG, typename RESULT>
+    struct Job {
+        using TI = typename CONFIG::TI;
+        TI evaluation_i;
+        TI step; // training step at which actor was snapshotted
+        TI seed;
+        typename CONFIG::ACTOR_TARGET_TYPE actor;
+        typename CONFIG::ENVIRONMENT_EVALUATION env;
+        double best_return; // reference of the sequential evaluation
+        RESULT result;
+        TI episodes; // episodes the result is based on
+        std::atomic<bool> done{false};
+    };
+}
+}
+
+#endif
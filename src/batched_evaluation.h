@@ -0,0 +1,208 @@
+#ifndef LEARNING_TO_FLY_BATCHED_EVALUATION_H
+#define LEARNING_TO_FLY_BATCHED_EVALUATION_H
+
+#include "constants.h"
+#include "scenario_bank.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+namespace learning_to_fly {
+/**
+ * Drop-in for the deterministic rlt::evaluate of the training loop (CONFIG::BATCHED_EVALUATION). Instead of running the
+ * episodes one after another with one-row forward passes, the NUM_EVALUATION_EPISODES episodes are split into
+ * constants::EVALUATION_SHARDS contiguous shards that num_threads threads work off (the caller sizes num_threads to the
+ * threads it may use, cf. steps/evaluation.h). Each shard steps all of its episodes in lockstep with one batched forward
+ * pass of the actor per timestep. Finished episodes are masked out (their rows are still
+ * part of the forward pass but they are neither stepped nor accounted) and a shard stops once all of its episodes are done.
+ * Only the aggregates of RESULT (returns_mean/std, episode_length_mean/std) are filled, which is all ts.evaluation_results
+ * is read for. sequential_evaluate runs the episodes in rounds and stops early once the result is settled. With a scenario
+ * bank (cf. scenario_bank.h) episode i replays scenario i, independent of the sharding and the rounds.
+ */
+namespace batched_evaluation {
+    template <typename CONFIG, typename CONFIG::TI NUM_EPISODES>
+    struct Shard {
+        using T = typename CONFIG::T;
+        using TI = typename CONFIG::TI;
+        static constexpr TI SIZE = (NUM_EPISODES + constants::EVALUATION_SHARDS - 1) / constants::EVALUATION_SHARDS;
+        std::vector<double> returns;
+        std::vector<double> episode_lengths;
+    };
+
+    // steps the episodes [begin, end) in lockstep, one batched forward pass per timestep
+    template <typename CONFIG, typename CONFIG::TI NUM_EPISODES, typename DEVICE, typename ENVIRONMENT, typename ACTOR, typename OBSERVATIONS_MEAN, typename OBSERVATIONS_STD>
+    void evaluate_shard(DEVICE& device, const ENVIRONMENT& env_template, const ACTOR& actor, const OBSERVATIONS_MEAN& observations_mean, const OBSERVATIONS_STD& observations_std, const scenario_bank::Bank<ENVIRONMENT>* bank, typename CONFIG::TI begin, typename CONFIG::TI end, typename CONFIG::TI seed, Shard<CONFIG, NUM_EPISODES>& shard) {
+        using T = typename CONFIG::T;
+        using TI = typename CONFIG::TI;
+        constexpr TI SIZE = Shard<CONFIG, NUM_EPISODES>::SIZE;
+        const TI num_episodes = end - begin;
+        auto rng = rlt::random::default_engine(typename DEVICE::SPEC::RANDOM{}, seed);
+        typename ACTOR::template DoubleBuffer<SIZE> actor_buffer;
+        rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, SIZE, ENVIRONMENT::OBSERVATION_DIM>> observations;
+        rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, SIZE, ENVIRONMENT::ACTION_DIM>> actions;
+        rlt::malloc(device, actor_buffer);
+        rlt::malloc(device, observations);
+        rlt::malloc(device, actions);
+        rlt::set_all(device, observations, 0);
+
+        // every episode draws its own course (sample_initial_state writes it into the parameters)
+        std::vector<ENVIRONMENT> envs(num_episodes, env_template);
+        std::vector<typename ENVIRONMENT::State> states(num_episodes), next_states(num_episodes);
+        std::vector<bool> running(num_episodes, true);
+        // one RNG per episode, so that an episode from the scenario bank does not depend on the shard layout
+        std::vector<decltype(rng)> rngs(num_episodes, rng);
+        shard.returns.assign(num_episodes, 0);
+        shard.episode_lengths.assign(num_episodes, 0);
+        for (TI episode_i = 0; episode_i < num_episodes; episode_i++) {
+            if (bank != nullptr) {
+                scenario_bank::apply(device, envs[episode_i], (*bank)[begin + episode_i], states[episode_i], rngs[episode_i]);
+            }
+            else {
+                TI episode_seed = rlt::random::uniform_int_distribution(device.random, (TI)0, (TI)0x7FFFFFFF, rng);
+                rngs[episode_i] = rlt::random::default_engine(typename DEVICE::SPEC::RANDOM{}, episode_seed);
+                rlt::sample_initial_state(device, envs[episode_i], states[episode_i], rngs[episode_i]);
+            }
+        }
+        TI num_running = num_episodes;
+        for (TI step_i = 0; step_i < CONFIG::ENVIRONMENT_STEP_LIMIT_EVALUATION && num_running > 0; step_i++) {
+            for (TI episode_i = 0; episode_i < num_episodes; episode_i++) {
+                if (!running[episode_i]) {
+                    continue;
+                }
+                auto observation = rlt::row(device, observations, episode_i);
+                rlt::observe(device, envs[episode_i], states[episode_i], observation, rngs[episode_i]);
+                for (TI i = 0; i < ENVIRONMENT::OBSERVATION_DIM; i++) {
+                    rlt::set(observations, episode_i, i, (rlt::get(observations, episode_i, i) - rlt::get(observations_mean, 0, i)) / rlt::get(observations_std, 0, i));
+                }
+            }
+            rlt::evaluate(device, actor, observations, actions, actor_buffer);
+            for (TI episode_i = 0; episode_i < num_episodes; episode_i++) {
+                if (!running[episode_i]) {
+                    continue;
+                }
+                auto action = rlt::row(device, actions, episode_i);
+                auto step_result = rlt::step_full(device, envs[episode_i], states[episode_i], action, next_states[episode_i], rngs[episode_i]);
+                shard.returns[episode_i] += step_result.reward;
+                shard.episode_lengths[episode_i]++;
+                states[episode_i] = next_states[episode_i];
+                if (step_result.terminated) {
+                    running[episode_i] = false;
+                    num_running--;
+                }
+            }
+        }
+        rlt::free(device, actor_buffer);
+        rlt::free(device, observations);
+        rlt::free(device, actions);
+    }
+
+    // runs NUM_EPISODES episodes and appends their returns and lengths. With a bank these are the scenarios episode_offset,
+    // episode_offset + 1, ..., otherwise the shards draw them from the seeds seed, seed + 1, ... Thread i works off the shards
+    // i, i + num_threads, ..., the result does not depend on num_threads
+    template <typename CONFIG, typename CONFIG::TI NUM_EPISODES, typename DEVICE, typename ENVIRONMENT, typename ACTOR, typename OBSERVATIONS_MEAN, typename OBSERVATIONS_STD>
+    void run_episodes(const ENVIRONMENT& env, const ACTOR& actor, const OBSERVATIONS_MEAN& observations_mean, const OBSERVATIONS_STD& observations_std, const scenario_bank::Bank<ENVIRONMENT>* bank, typename CONFIG::TI episode_offset, typename CONFIG::TI seed, unsigned num_threads, std::vector<double>& returns, std::vector<double>& episode_lengths) {
+        using TI = typename CONFIG::TI;
+        using SHARD = Shard<CONFIG, NUM_EPISODES>;
+        constexpr TI NUM_SHARDS = (NUM_EPISODES + SHARD::SIZE - 1) / SHARD::SIZE;
+        const TI num_workers = std::max<TI>(std::min<TI>(num_threads, NUM_SHARDS), 1);
+        SHARD shards[NUM_SHARDS];
+        auto work = [&](TI worker_i) {
+            DEVICE shard_device;
+            for (TI shard_i = worker_i; shard_i < NUM_SHARDS; shard_i += num_workers) {
+                TI begin = shard_i * SHARD::SIZE;
+                TI end = std::min(begin + SHARD::SIZE, NUM_EPISODES);
+                evaluate_shard<CONFIG, NUM_EPISODES>(shard_device, env, actor, observations_mean, observations_std, bank, episode_offset + begin, episode_offset + end, seed + shard_i, shards[shard_i]);
+            }
+        };
+        std::vector<std::thread> workers;
+        for (TI worker_i = 1; worker_i < num_workers; worker_i++) {
+            workers.emplace_back(work, worker_i);
+        }
+        work(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        for (const auto& shard : shards) {
+            returns.insert(returns.end(), shard.returns.begin(), shard.returns.end());
+            episode_lengths.insert(episode_lengths.end(), shard.episode_lengths.begin(), shard.episode_lengths.end());
+        }
+    }
+
+    // population mean and standard deviation (same as rlt::evaluate)
+    inline void mean_std(const std::vector<double>& values, double& mean, double& standard_deviation) {
+        double sum = 0, sum_squared = 0;
+        for (double value : values) {
+            sum += value;
+            sum_squared += value * value;
+        }
+        mean = sum / values.size();
+        standard_deviation = std::sqrt(std::max(sum_squared / values.size() - mean * mean, 0.0));
+    }
+
+    template <typename RESULT>
+    void summarize(const std::vector<double>& returns, const std::vector<double>& episode_lengths, RESULT& result) {
+        double mean, standard_deviation;
+        mean_std(returns, mean, standard_deviation);
+        result.returns_mean = mean;
+        result.returns_std = standard_deviation;
+        mean_std(episode_lengths, mean, standard_deviation);
+        result.episode_length_mean = mean;
+        result.episode_length_std = standard_deviation;
+    }
+
+    template <typename CONFIG, typename DEVICE, typename ENVIRONMENT, typename ACTOR, typename OBSERVATIONS_MEAN, typename OBSERVATIONS_STD, typename RESULT>
+    void evaluate(DEVICE& device, const ENVIRONMENT& env, const ACTOR& actor, const OBSERVATIONS_MEAN& observations_mean, const OBSERVATIONS_STD& observations_std, const scenario_bank::Bank<ENVIRONMENT>* bank, typename CONFIG::TI seed, unsigned num_threads, RESULT& result) {
+        std::vector<double> returns, episode_lengths;
+        run_episodes<CONFIG, CONFIG::NUM_EVALUATION_EPISODES, DEVICE>(env, actor, observations_mean, observations_std, bank, 0, seed, num_threads, returns, episode_lengths);
+        summarize(returns, episode_lengths, result);
+    }
+
+    /**
+     * Sequential evaluation (CONFIG::SEQUENTIAL_EVALUATION): runs rounds of constants::SEQUENTIAL_EVALUATION_ROUND episodes
+     * and stops as soon as the confidence interval of the mean return (constants::SEQUENTIAL_EVALUATION_Z standard errors)
+     * lies entirely above or below each reference return, i.e. when comparing against the best return so far and the target
+     * return cannot change anymore. References that are not finite are ignored, without any finite reference nothing can be
+     * settled. Otherwise it stops once NUM_EVALUATION_EPISODES episodes have been run (the last round is shortened to the
+     * remaining episodes). Returns the number of episodes used.
+     * The interval is checked after every round without correcting for the repeated looks, hence the conservative default z.
+     */
+    template <typename CONFIG, typename DEVICE, typename ENVIRONMENT, typename ACTOR, typename OBSERVATIONS_MEAN, typename OBSERVATIONS_STD, typename RESULT>
+    typename CONFIG::TI sequential_evaluate(DEVICE& device, const ENVIRONMENT& env, const ACTOR& actor, const OBSERVATIONS_MEAN& observations_mean, const OBSERVATIONS_STD& observations_std, const scenario_bank::Bank<ENVIRONMENT>* bank, typename CONFIG::TI seed, unsigned num_threads, double best_return, double target_return, RESULT& result) {
+        using TI = typename CONFIG::TI;
+        constexpr TI ROUND = std::min<TI>(constants::SEQUENTIAL_EVALUATION_ROUND, CONFIG::NUM_EVALUATION_EPISODES);
+        constexpr TI LAST_ROUND = CONFIG::NUM_EVALUATION_EPISODES % ROUND;
+        constexpr TI NUM_SHARDS = (ROUND + Shard<CONFIG, ROUND>::SIZE - 1) / Shard<CONFIG, ROUND>::SIZE;
+        std::vector<double> returns, episode_lengths;
+        for (TI round_i = 0; returns.size() < CONFIG::NUM_EVALUATION_EPISODES; round_i++) {
+            if (CONFIG::NUM_EVALUATION_EPISODES - returns.size() >= ROUND) {
+                run_episodes<CONFIG, ROUND, DEVICE>(env, actor, observations_mean, observations_std, bank, returns.size(), seed + round_i * NUM_SHARDS, num_threads, returns, episode_lengths);
+            }
+            else {
+                if constexpr (LAST_ROUND > 0) {
+                    run_episodes<CONFIG, LAST_ROUND, DEVICE>(env, actor, observations_mean, observations_std, bank, returns.size(), seed + round_i * NUM_SHARDS, num_threads, returns, episode_lengths);
+                }
+            }
+            double mean, standard_deviation;
+            mean_std(returns, mean, standard_deviation);
+            double half_width = constants::SEQUENTIAL_EVALUATION_Z * standard_deviation / std::sqrt((double)returns.size());
+            bool has_reference = false;
+            bool separated = true;
+            for (double reference : {best_return, target_return}) {
+                if (std::isfinite(reference)) {
+                    has_reference = true;
+                    separated = separated && (mean - half_width > reference || mean + half_width < reference);
+                }
+            }
+            if (has_reference && separated) {
+                break;
+            }
+        }
+        summarize(returns, episode_lengths, result);
+        return returns.size();
+    }
+}
+}
+
+#endif
@@ -0,0 +1,165 @@
+#include "training.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Throughput of the multirotor simulation: the scalar step (one environment after another, as in the off-policy runner and
+ * the evaluation) against the structure-of-arrays step of operations_batched.h with 1, 8 and 16 lanes. The batched step is
+ * vectorized by the compiler over the lanes, a batch of one lane runs the same code without anything to vectorize across and
+ * separates the gain of the layout from the gain of the vector width. batched_stepping_benchmark_novec is the same program
+ * built without auto-vectorization (cf. src/CMakeLists.txt), its batched rows should fall back to about the 1 lane rate.
+ * "soa" steps the batches directly, "aos" goes through the overload that gathers and scatters arrays of states (including the
+ * action history), which is what a caller keeping its states as structures would pay.
+ *
+ * Usage: batched_stepping_benchmark [num_steps]
+ */
+namespace batched_stepping_benchmark{
+    using CONFIG = learning_to_fly::config::Config<learning_to_fly::config::DEFAULT_ABLATION_SPEC>;
+    using DEVICE = typename CONFIG::DEVICE;
+    using T = typename CONFIG::T;
+    using TI = typename CONFIG::TI;
+    using ENVIRONMENT = typename CONFIG::ENVIRONMENT;
+    using STATE = typename ENVIRONMENT::State;
+    static_assert(std::is_same_v<T, float>);
+    constexpr TI NUM_ENVIRONMENTS = 64; // multiple of all lane counts
+    constexpr TI EPISODE_STEP_LIMIT = 100; // the states are reset to the initial states, so that random actions do not make them diverge
+    using ACTIONS = rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, NUM_ENVIRONMENTS, ENVIRONMENT::ACTION_DIM>>;
+    using CLOCK = std::chrono::high_resolution_clock;
+
+    struct Result{
+        double steps_per_second;
+        T checksum;
+    };
+    Result result(CLOCK::time_point start, TI num_steps, T checksum){
+        double seconds = std::chrono::duration<double>(CLOCK::now() - start).count();
+        return {num_steps * NUM_ENVIRONMENTS / seconds, checksum};
+    }
+
+    Result scalar(DEVICE& device, const ENVIRONMENT& env, const std::vector<STATE>& initial_states, const ACTIONS& actions, TI num_steps){
+        auto rng = rlt::random::default_engine(typename DEVICE::SPEC::RANDOM{}, 1);
+        std::vector<STATE> states(NUM_ENVIRONMENTS), next_states(NUM_ENVIRONMENTS);
+        auto start = CLOCK::now();
+        for(TI step_i = 0; step_i < num_steps; step_i++){
+            if(step_i % EPISODE_STEP_LIMIT == 0){
+                states = initial_states;
+            }
+            for(TI env_i = 0; env_i < NUM_ENVIRONMENTS; env_i++){
+                auto action = rlt::view(device, actions, rlt::matrix::ViewSpec<1, ENVIRONMENT::ACTION_DIM>{}, env_i, 0);
+                rlt::step(device, env, states[env_i], action, next_states[env_i], rng);
+            }
+            std::swap(states, next_states);
+        }
+        return result(start, num_steps, states[0].position[2]);
+    }
+
+    template <TI LANES>
+    Result structure_of_arrays(DEVICE& device, const ENVIRONMENT& env, const std::vector<STATE>& initial_states, const ACTIONS& actions, TI num_steps){
+        using BATCH = rlt::rl::environments::multirotor::StateBatched<STATE, LANES>;
+        constexpr TI NUM_BATCHES = NUM_ENVIRONMENTS / LANES;
+        auto rng = rlt::random::default_engine(typename DEVICE::SPEC::RANDOM{}, 1);
+        std::vector<BATCH> initial_batches(NUM_BATCHES), batches(NUM_BATCHES), next_batches(NUM_BATCHES);
+        for(TI env_i = 0; env_i < NUM_ENVIRONMENTS; env_i++){
+            rlt::rl::environments::multirotor::load(device, initial_states[env_i], initial_batches[env_i / LANES], env_i % LANES);
+        }
+        auto start = CLOCK::now();
+        for(TI step_i = 0; step_i < num_steps; step_i++){
+            if(step_i % EPISODE_STEP_LIMIT == 0){
+                batches = initial_batches;
+            }
+            for(TI batch_i = 0; batch_i < NUM_BATCHES; batch_i++){
+                auto batch_actions = rlt::view(device, actions, rlt::matrix::ViewSpec<LANES, ENVIRONMENT::ACTION_DIM>{}, batch_i * LANES, 0);
+                rlt::step(device, env, batches[batch_i], batch_actions, next_batches[batch_i], rng);
+            }
+            std::swap(batches, next_batches);
+        }
+        return result(start, num_steps, batches[0].position[2][0]);
+    }
+
+    template <TI LANES>
+    Result array_of_structures(DEVICE& device, const ENVIRONMENT& env, const std::vector<STATE>& initial_states, const ACTIONS& actions, TI num_steps){
+        using BATCH = rlt::rl::environments::multirotor::StateBatched<STATE, LANES>;
+        constexpr TI NUM_BATCHES = NUM_ENVIRONMENTS / LANES;
+        struct Group{
+            STATE states[LANES];
+        };
+        struct Buffer{
+            BATCH batches[2];
+        };
+        auto rng = rlt::random::default_engine(typename DEVICE::SPEC::RANDOM{}, 1);
+        std::vector<Group> initial_groups(NUM_BATCHES), groups(NUM_BATCHES), next_groups(NUM_BATCHES);
+        for(TI env_i = 0; env_i < NUM_ENVIRONMENTS; env_i++){
+            initial_groups[env_i / LANES].states[env_i % LANES] = initial_states[env_i];
+        }
+        auto buffer = std::make_unique<Buffer>();
+        auto start = CLOCK::now();
+        for(TI step_i = 0; step_i < num_steps; step_i++){
+            if(step_i % EPISODE_STEP_LIMIT == 0){
+                groups = initial_groups;
+            }
+            for(TI batch_i = 0; batch_i < NUM_BATCHES; batch_i++){
+                auto batch_actions = rlt::view(device, actions, rlt::matrix::ViewSpec<LANES, ENVIRONMENT::ACTION_DIM>{}, batch_i * LANES, 0);
+                rlt::step(device, env, groups[batch_i].states, batch_actions, next_groups[batch_i].states, buffer->batches, rng);
+            }
+            std::swap(groups, next_groups);
+        }
+        return result(start, num_steps, groups[0].states[0].position[2]);
+    }
+
+    const char* instruction_set(){
+#if defined(__AVX512F__)
+        return "AVX-512 (16 floats)";
+#elif defined(__AVX2__)
+        return "AVX2 (8 floats)";
+#elif defined(__AVX__)
+        return "AVX (8 floats)";
+#elif defined(__SSE2__)
+        return "SSE2 (4 floats)";
+#elif defined(__ARM_NEON)
+        return "NEON (4 floats)";
+#else
+        return "unknown";
+#endif
+    }
+
+    void report(const std::string& name, const Result& result, double scalar_steps_per_second){
+        std::cout << std::left << std::setw(16) << name << std::right << std::setw(14) << std::fixed << std::setprecision(0) << result.steps_per_second << " steps/s" << std::setw(10) << std::setprecision(2) << result.steps_per_second / scalar_steps_per_second << "x" << "   (checksum: " << std::setprecision(4) << result.checksum << ")" << std::endl;
+    }
+}
+
+int main(int argc, char** argv){
+    using namespace batched_stepping_benchmark;
+    TI num_steps = argc > 1 ? std::stoul(argv[1]) : 10000;
+    DEVICE device;
+    auto rng = rlt::random::default_engine(typename DEVICE::SPEC::RANDOM{}, 0);
+    ENVIRONMENT env;
+    env.parameters = parameters::environment<T, TI, CONFIG::ABLATION_SPEC>::parameters;
+    rlt::rl::environments::multirotor::update_wrench_mixing(device, env.parameters.dynamics);
+    std::vector<STATE> initial_states(NUM_ENVIRONMENTS);
+    for(auto& state: initial_states){
+        rlt::sample_initial_state(device, env, state, rng);
+    }
+    ACTIONS actions;
+    rlt::malloc(device, actions);
+    rlt::randn(device, actions, rng);
+
+#ifdef LEARNING_TO_FLY_BENCHMARK_NO_VECTORIZE
+    std::cout << "auto-vectorization: disabled" << std::endl;
+#else
+    std::cout << "auto-vectorization: " << instruction_set() << std::endl;
+#endif
+    std::cout << NUM_ENVIRONMENTS << " environments, " << num_steps << " steps, float" << std::endl;
+    Result scalar_result = scalar(device, env, initial_states, actions, num_steps);
+    report("scalar", scalar_result, scalar_result.steps_per_second);
+    report("soa 1 lane", structure_of_arrays<1>(device, env, initial_states, actions, num_steps), scalar_result.steps_per_second);
+    report("soa 8 lanes", structure_of_arrays<8>(device, env, initial_states, actions, num_steps), scalar_result.steps_per_second);
+    report("soa 16 lanes", structure_of_arrays<16>(device, env, initial_states, actions, num_steps), scalar_result.steps_per_second);
+    report("aos 8 lanes", array_of_structures<8>(device, env, initial_states, actions, num_steps), scalar_result.steps_per_second);
+    report("aos 16 lanes", array_of_structures<16>(device, env, initial_states, actions, num_steps), scalar_result.steps_per_second);
+    rlt::free(device, actions);
+    return 0;
+}
@@ -22,7 +22,7 @@ namespace learning_to_fly::config{
         static constexpr bool ROTOR_DELAY = true;
         static constexpr bool ACTION_HISTORY = true;
         static constexpr bool ENABLE_CURRICULUM = false;  // DISABLED: Causes policy collapse at 100k steps
-        static constexpr bool RECALCULATE_REWARDS = false;  // DISABLED: Breaks replay buffer consistency
+        static constexpr bool RECALCULATE_REWARDS = true;  // relabeled lazily at sample time (LAZY_REWARD_RELABELING), only active with the curriculum
         static constexpr bool USE_INITIAL_REWARD_FUNCTION = true;
         static constexpr bool USE_POSITION_TO_POSITION_REWARD = true;
         static constexpr bool INIT_NORMAL = true;
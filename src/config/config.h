@@ -5,6 +5,7 @@
 #include <rl_tools/rl/components/off_policy_runner/off_policy_runner.h>
 
 #include "ablation.h"
+#include <limits>
 
 namespace learning_to_fly{
     namespace config {
@@ -82,16 +83,38 @@ namespace learning_to_fly{
             static constexpr bool DETERMINISTIC_EVALUATION = !BENCHMARK;
             static constexpr TI EVALUATION_INTERVAL = 10000;
             static constexpr TI NUM_EVALUATION_EPISODES = 1000;
+            // run the evaluation on a snapshot of actor_target on worker threads instead of blocking training (cf. steps/evaluation.h)
+            static constexpr bool BACKGROUND_EVALUATION = true;
+            // step the evaluation episodes in lockstep with batched actor forward passes, sharded over threads (cf. batched_evaluation.h)
+            static constexpr bool BATCHED_EVALUATION = true;
+            // stop the (batched) evaluation early once its mean return is confidently above or below the best return so far and
+            // SEQUENTIAL_EVALUATION_TARGET_RETURN (ignored if not finite), cf. batched_evaluation.h. The learning curves get noisier
+            static constexpr bool SEQUENTIAL_EVALUATION = false;
+            static constexpr T SEQUENTIAL_EVALUATION_TARGET_RETURN = -std::numeric_limits<T>::infinity();
+            // replay the same initial states, disturbances, courses and noise seeds in every evaluation (common random numbers, cf. scenario_bank.h)
+            static constexpr bool SCENARIO_BANK = true;
             static constexpr bool COLLECT_EPISODE_STATS = false;
             static constexpr TI EPISODE_STATS_BUFFER_SIZE = 1000;
-            static constexpr TI N_ENVIRONMENTS = 1;  // Cannot increase due to simu            cd /home/shaked/Projects/RL-Flight-Crazyflie && ./build_firmware_with_policy_switching.sh actors/position_to_position_2m_good_agents/actor_000000002400000.h actors/hover_actors/new2/actor_000000001600000.hlator constraints
+            static constexpr TI N_ENVIRONMENTS = 1;  // Parallel environments of the off-policy runner, each contributes one transition per step to its own replay buffer (of capacity REPLAY_BUFFER_CAP)
             static constexpr TI STEP_LIMIT = 2000001;
 //            static constexpr TI REPLAY_BUFFER_LIMIT = 3000000;
-            static constexpr TI REPLAY_BUFFER_CAP = STEP_LIMIT;
+            // per environment, so that the replay buffers hold STEP_LIMIT transitions in total independent of N_ENVIRONMENTS
+            static constexpr TI REPLAY_BUFFER_CAP = (STEP_LIMIT + N_ENVIRONMENTS - 1) / N_ENVIRONMENTS;
             static constexpr TI ENVIRONMENT_STEP_LIMIT = 1000;  // Episode length for training
             static constexpr TI ENVIRONMENT_STEP_LIMIT_EVALUATION = 1000;  // Longer for evaluation to show sustained hovering
             static constexpr TI BASE_SEED = 0;
             static constexpr bool CONSTRUCT_LOGGER = false;
+            // RECALCULATE_REWARDS: instead of rewriting the whole replay buffer when the curriculum changes the reward weights, only
+            // bump a version and relabel stale rows when gather_batch samples them (cf. steps/reward_relabeling.h)
+            static constexpr bool LAZY_REWARD_RELABELING = true;
+            // dump the replay buffers at every checkpoint and at the end of the training (large: two states per transition), cf. steps/transition_dump.h
+            static constexpr bool DUMP_TRANSITIONS = false;
+            // step the environments on ASYNC_COLLECTORS threads with a snapshot of the actor (republished every ASYNC_PUBLISH_INTERVAL
+            // steps) while the training thread runs the TD3 updates, cf. async_collection.h. Not deterministic across runs
+            static constexpr bool ASYNC_COLLECTION = false;
+            static constexpr TI ASYNC_COLLECTORS = 1;
+            static constexpr TI ASYNC_QUEUE_CAPACITY = 64; // per collector, power of two
+            static constexpr TI ASYNC_PUBLISH_INTERVAL = TD3_PARAMETERS::ACTOR_TRAINING_INTERVAL;
             using OFF_POLICY_RUNNER_SPEC = rlt::rl::components::off_policy_runner::Specification<T, TI, ENVIRONMENT, N_ENVIRONMENTS, ASYMMETRIC_OBSERVATIONS, REPLAY_BUFFER_CAP, ENVIRONMENT_STEP_LIMIT, rlt::rl::components::off_policy_runner::DefaultParameters<T>, false, true, 1000>;
             using OFF_POLICY_RUNNER_TYPE = rlt::rl::components::OffPolicyRunner<OFF_POLICY_RUNNER_SPEC>;
             static constexpr rlt::rl::components::off_policy_runner::DefaultParameters<T> off_policy_runner_parameters = {
@@ -32,13 +32,17 @@ namespace parameters{
     namespace builder {
         namespace rlt = RL_TOOLS_NAMESPACE_WRAPPER::rl_tools;
         using namespace rlt::rl::environments::multirotor;
+        namespace reward_functions = rl_tools::rl::environments::multirotor::parameters::reward_functions;
         template<typename T, typename TI, typename T_ABLATION_SPEC>
         struct environment {
             using ABLATION_SPEC = T_ABLATION_SPEC;
             static constexpr auto initial_reward_function = rl_tools::rl::environments::multirotor::parameters::reward_functions::reward_squared_position_only_torque<T>;
             static constexpr auto target_reward_function = rl_tools::rl::environments::multirotor::parameters::reward_functions::reward_squared_position_only_torque_curriculum_target<T>;
-            static constexpr auto position_to_position_reward_function = rl_tools::rl::environments::multirotor::parameters::reward_functions::reward_position_to_position_smooth<T>;
-            static constexpr auto precision_hover_reward_function = rl_tools::rl::environments::multirotor::parameters::reward_functions::reward_precision_hover<T>;  // High-precision hovering at origin
+            // Zero-weight cost terms are dropped from reward_components at compile time. The curriculum (steps/curriculum.h) scales
+            // the position, action and linear velocity weights at runtime, hence these terms are always kept
+            static constexpr auto CURRICULUM_REWARD_TERMS = reward_functions::terms::POSITION | reward_functions::terms::ACTION | reward_functions::terms::LINEAR_VELOCITY;
+            static constexpr auto position_to_position_reward_function = reward_functions::prune<reward_functions::terms::nonzero(reward_functions::reward_position_to_position_smooth<T>) | CURRICULUM_REWARD_TERMS>(reward_functions::reward_position_to_position_smooth<T>);
+            static constexpr auto precision_hover_reward_function = reward_functions::prune<reward_functions::terms::nonzero(reward_functions::reward_precision_hover<T>) | CURRICULUM_REWARD_TERMS>(reward_functions::reward_precision_hover<T>);  // High-precision hovering at origin
             
             // Select reward function based on ablation spec
             template<typename T_SPEC>
@@ -154,6 +158,8 @@ namespace parameters{
                     observation::NONE<TI>
                 >;
                 static constexpr bool PRIVILEGED_OBSERVATION_NOISE = false;
+                static constexpr bool CLOSED_FORM_ROTOR_DELAY = false;
+                static constexpr TI PHYSICS_SUBSTEPS = 1;
             };
 
             using ENVIRONMENT_SPEC = rlt::rl::environments::multirotor::Specification<T, TI, PARAMETERS, ENVIRONMENT_STATIC_PARAMETERS>;
@@ -30,59 +30,44 @@ namespace learning_to_fly {
             target_pos[2] = TARGET_POSITION_Z<T>;
         }
         
-        // Cylindrical obstacles (pipes) configuration
-        struct CylindricalObstacle {
-            double x;        // X position
-            double y;        // Y position
-            double radius;   // Radius in meters
-            double z_min;    // Minimum Z (bottom of pipe)
-            double z_max;    // Maximum Z (top of pipe)
-        };
+        // Obstacle course (pipes and walls), loaded at startup so that changing it does not require a rebuild (cf. obstacle_scene.h).
+        // JSON scenes use the schema of the UI's /config endpoint, other files are read as binary scenes.
+        constexpr const char* OBSTACLE_SCENE_PATH = "scenes/default.json";
+        // environment variable that overrides OBSTACLE_SCENE_PATH
+        constexpr const char* OBSTACLE_SCENE_PATH_ENV = "LEARNING_TO_FLY_OBSTACLE_SCENE";
         
-        // Array of cylindrical obstacles - can be extended in the future
-        constexpr CylindricalObstacle OBSTACLES[] = {
-            {1.0, 0.0, 0.3, -1.0, 1.0}  // x=1m, y=0m, radius=30cm, z from -1m to +1m
-        };
-        
-        constexpr size_t NUM_OBSTACLES = sizeof(OBSTACLES) / sizeof(OBSTACLES[0]);
-        
-        // Planar obstacles (walls) configuration
-        // Plane is defined by: point on plane, normal vector, and bounds
-        struct PlanarObstacle {
-            // Point on the plane
-            double point_x;
-            double point_y;
-            double point_z;
-            
-            // Normal vector (should be normalized)
-            double normal_x;
-            double normal_y;
-            double normal_z;
-            
-            // Half-thickness of the wall (collision if distance < thickness)
-            double thickness;
-            
-            // Bounding box to limit the plane extent (min/max in each dimension)
-            double x_min;
-            double x_max;
-            double y_min;
-            double y_max;
-            double z_min;
-            double z_max;
-        };
-        
-        // Array of planar obstacles - can be extended in the future
-        constexpr PlanarObstacle PLANAR_OBSTACLES[] = {
-            // // Vertical wall perpendicular to Y-axis at y=1.0m (halfway between origin and target)
-            // {1.0, 0.6, 0.0,    // Point on plane (x, y, z)
-            //  0.0, 1.0, 0.0,    // Normal vector (pointing in +Y direction)
-            //  0.1,              // Thickness (10cm)
-            //  0.0, 1.0,         // X bounds (from 0m to +1m, 1m wide wall)
-            //  0.95, 1.05,       // Y bounds (wall thickness region around y=1.0)
-            //  -1.0, 1.0}        // Z bounds (from -1m to +1m height, 2m tall wall)
-        };
-        
-        constexpr size_t NUM_PLANAR_OBSTACLES = sizeof(PLANAR_OBSTACLES) / sizeof(PLANAR_OBSTACLES[0]);
+        // Signed-distance grid the obstacles are baked into at startup (cell size and margin around the danger zones in meters)
+        constexpr double OBSTACLE_FIELD_SPACING = 0.05;
+        constexpr double OBSTACLE_FIELD_MARGIN = 0.5;
+
+        // Worker threads of the curriculum's reward recalculation over the replay buffers (0: one per hardware thread)
+        constexpr unsigned RECALCULATE_REWARDS_THREADS = 0;
+        // transitions below which an additional worker does not pay off
+        constexpr unsigned long RECALCULATE_REWARDS_MIN_CHUNK = 16384;
+
+        // Worker threads of the offline reward variant evaluation (reward_variants.cpp, 0: one per hardware thread)
+        constexpr unsigned REWARD_VARIANTS_THREADS = 0;
+
+        // Worker threads of the background evaluation (steps/evaluation.h, 0: half of the hardware threads, the rest is left to training)
+        constexpr unsigned EVALUATION_WORKERS = 0;
+        // Lockstep batches the evaluation episodes are split into with BATCHED_EVALUATION (batched_evaluation.h). They are worked
+        // off by as many threads as the evaluation may use (cf. steps/evaluation.h)
+        constexpr unsigned EVALUATION_SHARDS = 4;
+        // Sequential evaluation (SEQUENTIAL_EVALUATION): episodes per round and width of the confidence interval of the mean return
+        // in standard errors. The interval is checked after every round, the width is conservative to account for the repeated looks
+        constexpr unsigned long SEQUENTIAL_EVALUATION_ROUND = 100;
+        constexpr double SEQUENTIAL_EVALUATION_Z = 3.0;
+
+        // Evaluation scenario bank (SCENARIO_BANK, scenario_bank.h), generated from the evaluation environment at the first
+        // training start if it does not exist. Delete it to draw a new bank (e.g. after changing the initial state distribution)
+        constexpr const char* SCENARIO_BANK_PATH = "scenarios/evaluation_bank.bin";
+        // environment variable that overrides SCENARIO_BANK_PATH
+        constexpr const char* SCENARIO_BANK_PATH_ENV = "LEARNING_TO_FLY_SCENARIO_BANK";
+        constexpr unsigned long SCENARIO_BANK_SEED = 0;
+
+        // Training steps between two reductions of the captured reward components (steps/log_reward.h). The capture holds 4096
+        // transitions, i.e. REWARD_LOG_INTERVAL * N_ENVIRONMENTS should stay below that to cover every transition
+        constexpr unsigned long REWARD_LOG_INTERVAL = 1000;
     }
 }
 
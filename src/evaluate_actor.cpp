@@ -261,9 +261,11 @@ int main(int argc, char** argv) {
                 rlt::observe(dev, env, observation_state_clamped, observation, rng);
                 rlt::evaluate(dev, actor, observation, action, actor_buffer);
                 rlt::clamp(dev, action, (T)-1, (T)1);
-                T dt = rlt::step(dev, env, state, action, next_state, rng);
-                bool terminated_flag = rlt::terminated(dev, env, observation_state, rng);
-                reward_acc += rlt::reward(dev, env, state, action, next_state, rng);
+                auto step_result = rlt::step_full(dev, env, state, action, next_state, rng);
+                T dt = step_result.dt;
+                // while tracking, termination is evaluated relative to the moving target
+                bool terminated_flag = TRAJECTORY_TRACKING && step_i >= TRACKING_START_STEP ? rlt::terminated(dev, env, observation_state, rng) : step_result.terminated;
+                reward_acc += step_result.reward;
                 rlt::set_state(dev, ui, state, action);
                 state = next_state;
                 auto end = std::chrono::high_resolution_clock::now();
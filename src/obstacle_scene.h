@@ -0,0 +1,241 @@
+#ifndef LEARNING_TO_FLY_OBSTACLE_SCENE_H
+#define LEARNING_TO_FLY_OBSTACLE_SCENE_H
+
+#include <learning_to_fly/simulator/obstacle_field.h>
+#include <learning_to_fly/simulator/obstacle_course.h>
+#include <nlohmann/json.hpp>
+#include "constants.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace learning_to_fly {
+namespace obstacle_scene {
+    namespace obstacles = rl_tools::rl::environments::multirotor::obstacles;
+
+    // Owns the obstacle tables. Environments only hold the (read-only) Scene view, which stays valid as long as the storage lives.
+    struct Storage {
+        std::vector<obstacles::Cylinder> cylinders;
+        std::vector<obstacles::Plane> planes;
+        // optional: draw a procedural course per episode instead of using the fixed obstacles
+        bool has_generator = false;
+        obstacles::CourseGenerator generator{};
+        obstacles::Scene scene() const {
+            obstacles::Scene scene;
+            scene.cylinders = cylinders.data();
+            scene.num_cylinders = cylinders.size();
+            scene.planes = planes.data();
+            scene.num_planes = planes.size();
+            return scene;
+        }
+    };
+
+    /**
+     * JSON schema (same as the "obstacles" array of the UI's /config endpoint):
+     * [{"type": "cylinder", "x", "y", "radius", "zMin", "zMax"},
+     *  {"type": "plane", "pointX", "pointY", "pointZ", "normalX", "normalY", "normalZ", "thickness", "xMin", "xMax", "yMin", "yMax", "zMin", "zMax"}]
+     * A top-level object with an "obstacles" member is accepted as well. It may carry a procedural course generator:
+     * "generator": {"minCylinders", "maxCylinders", "minRadius", "maxRadius", "minPlanes", "maxPlanes", "planeThickness",
+     *               "minPlaneLength", "maxPlaneLength", "lower": [x, y, z], "upper": [x, y, z], "clearance", "maxAttempts"}
+     */
+    inline obstacles::CourseGenerator generator_from_json(const nlohmann::json& entry) {
+        obstacles::CourseGenerator g{};
+        g.min_cylinders = entry.at("minCylinders").get<size_t>();
+        g.max_cylinders = entry.at("maxCylinders").get<size_t>();
+        g.min_radius = entry.at("minRadius").get<float>();
+        g.max_radius = entry.at("maxRadius").get<float>();
+        g.min_planes = entry.at("minPlanes").get<size_t>();
+        g.max_planes = entry.at("maxPlanes").get<size_t>();
+        g.plane_thickness = entry.at("planeThickness").get<float>();
+        g.min_plane_length = entry.at("minPlaneLength").get<float>();
+        g.max_plane_length = entry.at("maxPlaneLength").get<float>();
+        for (size_t dim_i = 0; dim_i < 3; dim_i++) {
+            g.lower[dim_i] = entry.at("lower").at(dim_i).get<float>();
+            g.upper[dim_i] = entry.at("upper").at(dim_i).get<float>();
+        }
+        g.clearance = entry.at("clearance").get<float>();
+        g.max_attempts = entry.at("maxAttempts").get<size_t>();
+        if (g.max_cylinders > obstacles::COURSE_MAX_CYLINDERS || g.max_planes > obstacles::COURSE_MAX_PLANES) {
+            throw std::runtime_error("Course generator exceeds the course capacity (" + std::to_string(obstacles::COURSE_MAX_CYLINDERS) + " pipes, " + std::to_string(obstacles::COURSE_MAX_PLANES) + " walls)");
+        }
+        if (g.min_cylinders > g.max_cylinders || g.min_planes > g.max_planes) {
+            throw std::runtime_error("Course generator: minimum obstacle count exceeds the maximum");
+        }
+        return g;
+    }
+
+    inline nlohmann::json generator_to_json(const obstacles::CourseGenerator& g) {
+        return {
+            {"minCylinders", g.min_cylinders}, {"maxCylinders", g.max_cylinders},
+            {"minRadius", g.min_radius}, {"maxRadius", g.max_radius},
+            {"minPlanes", g.min_planes}, {"maxPlanes", g.max_planes},
+            {"planeThickness", g.plane_thickness},
+            {"minPlaneLength", g.min_plane_length}, {"maxPlaneLength", g.max_plane_length},
+            {"lower", {g.lower[0], g.lower[1], g.lower[2]}}, {"upper", {g.upper[0], g.upper[1], g.upper[2]}},
+            {"clearance", g.clearance}, {"maxAttempts", g.max_attempts}
+        };
+    }
+
+    inline Storage from_json(const nlohmann::json& json) {
+        const nlohmann::json& list = json.is_object() ? json.at("obstacles") : json;
+        Storage storage;
+        if (json.is_object() && json.contains("generator")) {
+            storage.generator = generator_from_json(json.at("generator"));
+            storage.has_generator = true;
+        }
+        for (const auto& entry : list) {
+            std::string type = entry.at("type").get<std::string>();
+            if (type == "cylinder") {
+                obstacles::Cylinder c{};
+                c.x = entry.at("x").get<float>();
+                c.y = entry.at("y").get<float>();
+                c.radius = entry.at("radius").get<float>();
+                c.z_min = entry.at("zMin").get<float>();
+                c.z_max = entry.at("zMax").get<float>();
+                storage.cylinders.push_back(c);
+            } else if (type == "plane") {
+                obstacles::Plane p{};
+                p.point_x = entry.at("pointX").get<float>();
+                p.point_y = entry.at("pointY").get<float>();
+                p.point_z = entry.at("pointZ").get<float>();
+                p.normal_x = entry.at("normalX").get<float>();
+                p.normal_y = entry.at("normalY").get<float>();
+                p.normal_z = entry.at("normalZ").get<float>();
+                p.thickness = entry.at("thickness").get<float>();
+                p.x_min = entry.at("xMin").get<float>();
+                p.x_max = entry.at("xMax").get<float>();
+                p.y_min = entry.at("yMin").get<float>();
+                p.y_max = entry.at("yMax").get<float>();
+                p.z_min = entry.at("zMin").get<float>();
+                p.z_max = entry.at("zMax").get<float>();
+                storage.planes.push_back(p);
+            } else {
+                throw std::runtime_error("Unknown obstacle type: " + type);
+            }
+        }
+        return storage;
+    }
+
+    inline nlohmann::json to_json(const Storage& storage) {
+        nlohmann::json list = nlohmann::json::array();
+        for (const auto& c : storage.cylinders) {
+            list.push_back({{"type", "cylinder"}, {"x", c.x}, {"y", c.y}, {"radius", c.radius}, {"zMin", c.z_min}, {"zMax", c.z_max}});
+        }
+        for (const auto& p : storage.planes) {
+            list.push_back({
+                {"type", "plane"},
+                {"pointX", p.point_x}, {"pointY", p.point_y}, {"pointZ", p.point_z},
+                {"normalX", p.normal_x}, {"normalY", p.normal_y}, {"normalZ", p.normal_z},
+                {"thickness", p.thickness},
+                {"xMin", p.x_min}, {"xMax", p.x_max},
+                {"yMin", p.y_min}, {"yMax", p.y_max},
+                {"zMin", p.z_min}, {"zMax", p.z_max}
+            });
+        }
+        return list;
+    }
+
+    /**
+     * Binary scene: 8 byte magic, uint32 number of cylinders, uint32 number of planes, followed by the float32 fields of
+     * the cylinders (5 each) and planes (13 each) in declaration order (native byte order). The course generator is not
+     * part of the binary format (use JSON for procedural courses)
+     */
+    constexpr char BINARY_MAGIC[8] = {'L', '2', 'F', 'S', 'C', 'N', '0', '1'};
+
+    inline void save_binary(const Storage& storage, const std::string& path) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Could not open obstacle scene for writing: " + path);
+        }
+        uint32_t counts[2] = {(uint32_t)storage.cylinders.size(), (uint32_t)storage.planes.size()};
+        file.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+        file.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+        for (const auto& c : storage.cylinders) {
+            float fields[5] = {c.x, c.y, c.radius, c.z_min, c.z_max};
+            file.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+        }
+        for (const auto& p : storage.planes) {
+            float fields[13] = {p.point_x, p.point_y, p.point_z, p.normal_x, p.normal_y, p.normal_z, p.thickness, p.x_min, p.x_max, p.y_min, p.y_max, p.z_min, p.z_max};
+            file.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+        }
+    }
+
+    inline Storage load_binary(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Could not open obstacle scene: " + path);
+        }
+        char magic[sizeof(BINARY_MAGIC)];
+        uint32_t counts[2];
+        file.read(magic, sizeof(magic));
+        file.read(reinterpret_cast<char*>(counts), sizeof(counts));
+        if (!file || std::memcmp(magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0) {
+            throw std::runtime_error("Not a binary obstacle scene: " + path);
+        }
+        // the counts are checked against the remaining file size before anything is allocated
+        std::streampos header_end = file.tellg();
+        file.seekg(0, std::ios::end);
+        uint64_t payload_size = (uint64_t)(file.tellg() - header_end);
+        file.seekg(header_end);
+        if (payload_size != (uint64_t)counts[0] * 5 * sizeof(float) + (uint64_t)counts[1] * 13 * sizeof(float)) {
+            throw std::runtime_error("Obstacle scene size does not match its obstacle counts (" + std::to_string(counts[0]) + " pipes, " + std::to_string(counts[1]) + " walls): " + path);
+        }
+        Storage storage;
+        storage.cylinders.resize(counts[0]);
+        storage.planes.resize(counts[1]);
+        for (auto& c : storage.cylinders) {
+            float fields[5];
+            file.read(reinterpret_cast<char*>(fields), sizeof(fields));
+            c = {fields[0], fields[1], fields[2], fields[3], fields[4]};
+        }
+        for (auto& p : storage.planes) {
+            float fields[13];
+            file.read(reinterpret_cast<char*>(fields), sizeof(fields));
+            p = {fields[0], fields[1], fields[2], fields[3], fields[4], fields[5], fields[6], fields[7], fields[8], fields[9], fields[10], fields[11], fields[12]};
+        }
+        if (!file) {
+            throw std::runtime_error("Truncated obstacle scene: " + path);
+        }
+        return storage;
+    }
+
+    inline Storage load(const std::string& path) {
+        if (path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0) {
+            std::ifstream file(path);
+            if (!file) {
+                throw std::runtime_error("Could not open obstacle scene: " + path);
+            }
+            return from_json(nlohmann::json::parse(file));
+        }
+        return load_binary(path);
+    }
+
+    inline std::string path() {
+        const char* override_path = std::getenv(constants::OBSTACLE_SCENE_PATH_ENV);
+        return override_path != nullptr ? std::string(override_path) : std::string(constants::OBSTACLE_SCENE_PATH);
+    }
+
+    /**
+     * The scene of this process: loaded once on first use from path() (LEARNING_TO_FLY_OBSTACLE_SCENE, falling back to
+     * constants::OBSTACLE_SCENE_PATH relative to the working directory) and shared read-only by all environments and the UI
+     */
+    inline const Storage& shared() {
+        static const Storage storage = [] {
+            std::string scene_path = path();
+            Storage loaded = load(scene_path);
+            std::cout << "Obstacle scene: " << scene_path << " (" << loaded.cylinders.size() << " pipes, " << loaded.planes.size() << " walls" << (loaded.has_generator ? ", procedural courses" : "") << ")" << std::endl;
+            return loaded;
+        }();
+        return storage;
+    }
+
+} // namespace obstacle_scene
+} // namespace learning_to_fly
+
+#endif // LEARNING_TO_FLY_OBSTACLE_SCENE_H
@@ -21,22 +21,38 @@ namespace off_policy_runner {
         POLICY_BUFFER& policy_buffer,
         HOVER_BUFFER& hover_buffer,
         bool use_policy_switching,
-        typename SPEC::T threshold
+        typename SPEC::T threshold,
+        bool (&using_hover)[SPEC::N_ENVIRONMENTS]
     ) {
         using T = typename SPEC::T;
         using TI = typename SPEC::TI;
         using ENVIRONMENT = typename SPEC::ENVIRONMENT;
         constexpr TI N_ENVIRONMENTS = SPEC::N_ENVIRONMENTS;
 
+        // Evaluate the navigation actor for all environments at once (also the standard evaluation without policy switching)
+        rlt::evaluate(device, policy, runner.buffers.observations, runner.buffers.actions, policy_buffer);
         if (!use_policy_switching) {
-            // Standard evaluation without policy switching
-            rlt::evaluate(device, policy, runner.buffers.observations, runner.buffers.actions, policy_buffer);
             return;
         }
 
-        // Policy switching: evaluate each environment separately
+        // Policy switching: overwrite the actions of the environments that are in hover mode
+        rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, ENVIRONMENT::OBSERVATION_DIM>> transformed_obs;
+        bool transformed_obs_allocated = false;
         for(TI env_i = 0; env_i < N_ENVIRONMENTS; env_i++){
-            auto& env = runner.envs[env_i];
+            // The prologue resets the episode step when it starts a new episode, which also resets the sticky hover flag
+            if(rlt::get(runner.episode_step, 0, env_i) == 0){
+                using_hover[env_i] = false;
+            }
+            if(!using_hover[env_i]){
+                // Calculate distance to target
+                auto& state = rlt::get(runner.states, 0, env_i);
+                T distance = policy_switching::calculate_distance_to_target<T>(state.position);
+                // Switching to the hover actor is sticky for the rest of the episode (same as in steps::trajectory_collection)
+                using_hover[env_i] = distance < threshold;
+            }
+            if(!using_hover[env_i]){
+                continue;
+            }
             auto observation = rlt::view<DEVICE, typename decltype(runner.buffers.observations)::SPEC, 1, ENVIRONMENT::OBSERVATION_DIM>(
                 device, runner.buffers.observations, env_i, 0
             );
@@ -44,26 +60,21 @@ namespace off_policy_runner {
                 device, runner.buffers.actions, env_i, 0
             );
 
-            // Calculate distance to target
-            auto& state = rlt::get(runner.states, 0, env_i);
-            T distance = policy_switching::calculate_distance_to_target<T>(state.position);
-            
-            if (distance < threshold) {
-                // Use hover actor with transformed observations
-                rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, ENVIRONMENT::OBSERVATION_DIM>> transformed_obs;
+            // Use hover actor with transformed observations
+            if(!transformed_obs_allocated){
                 rlt::malloc(device, transformed_obs);
-                rlt::copy(device, device, observation, transformed_obs);
-                
-                T target_pos[3];
-                constants::get_target_position<T>(target_pos);
-                policy_switching::transform_observation_to_target_relative(device, transformed_obs, target_pos);
-                
-                rlt::evaluate(device, hover_policy, transformed_obs, action, hover_buffer);
-                rlt::free(device, transformed_obs);
-            } else {
-                // Use navigation actor
-                rlt::evaluate(device, policy, observation, action, policy_buffer);
+                transformed_obs_allocated = true;
             }
+            rlt::copy(device, device, observation, transformed_obs);
+
+            T target_pos[3];
+            constants::get_target_position<T>(target_pos);
+            policy_switching::transform_observation_to_target_relative(device, transformed_obs, target_pos);
+
+            rlt::evaluate(device, hover_policy, transformed_obs, action, hover_buffer);
+        }
+        if(transformed_obs_allocated){
+            rlt::free(device, transformed_obs);
         }
     }
 
@@ -77,11 +88,12 @@ namespace off_policy_runner {
         HOVER_BUFFER& hover_buffer,
         RNG& rng,
         bool use_policy_switching,
-        typename OFF_POLICY_RUNNER_SPEC::T threshold
+        typename OFF_POLICY_RUNNER_SPEC::T threshold,
+        bool (&using_hover)[OFF_POLICY_RUNNER_SPEC::N_ENVIRONMENTS]
     ) {
         // Use RL-Tools prologue/interlude/epilogue pattern
         rlt::rl::components::off_policy_runner::prologue(device, off_policy_runner, rng);
-        interlude_with_policy_switching(device, off_policy_runner, policy, hover_policy, policy_buffer, hover_buffer, use_policy_switching, threshold);
+        interlude_with_policy_switching(device, off_policy_runner, policy, hover_policy, policy_buffer, hover_buffer, use_policy_switching, threshold, using_hover);
         rlt::rl::components::off_policy_runner::epilogue(device, off_policy_runner, rng);
     }
 
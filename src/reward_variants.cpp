@@ -0,0 +1,314 @@
+#include "training.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Offline screening of PositionToPosition reward variants: evaluates every variant over all (state, action, next_state)
+ * triples of a transition dump (cf. transition_dump.h, written by training with CONFIG::DUMP_TRANSITIONS) and reports per
+ * component statistics over the transitions and the correlation of the per-episode totals with the episode success.
+ *
+ * Usage: reward_variants <transitions.bin> <variants.json> [report.json]
+ *
+ * variants.json: {"successRadius": 0.3, "variants": [{"name": "...", <overrides>}, ...]} (or just the list of variants).
+ * Overrides (all optional, the rest is taken from the training reward function): "nonNegative", "scale", "constant",
+ * "terminationPenalty", "position", "orientation", "linearVelocity", "angularVelocity", "linearAcceleration",
+ * "angularAcceleration", "actionBaseline", "action", "target": [x, y, z], "targetRadius", "velocityRewardScale",
+ * "useTargetProgress". The training reward function itself is always evaluated as the first variant ("training").
+ * An episode is successful if it ended by truncation (not terminated) within successRadius (default: targetRadius of the
+ * training reward function) of its target. Episodes that are still running at the end of a replay buffer are only part of
+ * the transition statistics.
+ */
+namespace reward_variants{
+    using CONFIG = learning_to_fly::config::Config<learning_to_fly::config::POSITION_TO_POSITION_ABLATION_SPEC>;
+    using DEVICE = typename CONFIG::DEVICE;
+    using T = typename CONFIG::T;
+    using TI = typename CONFIG::TI;
+    using ENVIRONMENT = typename CONFIG::ENVIRONMENT;
+    using RECORD = learning_to_fly::transition_dump::Record<ENVIRONMENT>;
+    namespace reward_functions = rlt::rl::environments::multirotor::parameters::reward_functions;
+    // all terms are evaluated, so that a variant can weight terms that are pruned from the training reward function
+    using REWARD_FUNCTION = reward_functions::PositionToPosition<T>;
+
+    constexpr TI NUM_COMPONENTS = 10;
+    constexpr const char* COMPONENT_NAMES[NUM_COMPONENTS] = {"position_cost", "orientation_cost", "linear_vel_cost", "angular_vel_cost", "linear_acc_cost", "angular_acc_cost", "action_cost", "weighted_cost", "scaled_weighted_cost", "reward"};
+    constexpr TI REWARD = NUM_COMPONENTS - 1;
+
+    struct Variant{
+        std::string name;
+        REWARD_FUNCTION params;
+    };
+    struct Episode{
+        size_t begin;
+        size_t end;
+        bool complete;
+        bool success;
+    };
+    // per variant and component: moments over the transitions and over the per-episode totals of the complete episodes (x)
+    // together with their success (y), for the Pearson (point-biserial) correlation
+    struct Statistics{
+        double count = 0;
+        double sum = 0;
+        double sum_sq = 0;
+        double min = std::numeric_limits<double>::infinity();
+        double max = -std::numeric_limits<double>::infinity();
+        double episodes = 0;
+        double episode_sum = 0;
+        double episode_sum_sq = 0;
+        double episode_sum_success = 0; // sum of x * y
+        double successes = 0;
+        void merge(const Statistics& other){
+            count += other.count;
+            sum += other.sum;
+            sum_sq += other.sum_sq;
+            min = std::min(min, other.min);
+            max = std::max(max, other.max);
+            episodes += other.episodes;
+            episode_sum += other.episode_sum;
+            episode_sum_sq += other.episode_sum_sq;
+            episode_sum_success += other.episode_sum_success;
+            successes += other.successes;
+        }
+        double mean() const { return count > 0 ? sum / count : 0; }
+        double standard_deviation() const { return count > 0 ? std::sqrt(std::max(sum_sq / count - mean() * mean(), 0.0)) : 0; }
+        double episode_mean() const { return episodes > 0 ? episode_sum / episodes : 0; }
+        // NaN if either side is constant (e.g. no or only successful episodes)
+        double success_correlation() const {
+            double n = episodes;
+            double covariance = n * episode_sum_success - episode_sum * successes;
+            double variance_x = n * episode_sum_sq - episode_sum * episode_sum;
+            double variance_y = n * successes - successes * successes;
+            if(variance_x <= 0 || variance_y <= 0){
+                return std::numeric_limits<double>::quiet_NaN();
+            }
+            return covariance / std::sqrt(variance_x * variance_y);
+        }
+    };
+
+    void unpack(const typename REWARD_FUNCTION::Components& components, double values[NUM_COMPONENTS]){
+        values[0] = components.position_cost;
+        values[1] = components.orientation_cost;
+        values[2] = components.linear_vel_cost;
+        values[3] = components.angular_vel_cost;
+        values[4] = components.linear_acc_cost;
+        values[5] = components.angular_acc_cost;
+        values[6] = components.action_cost;
+        values[7] = components.weighted_cost;
+        values[8] = components.scaled_weighted_cost;
+        values[9] = components.reward;
+    }
+
+    Variant variant_from_json(const nlohmann::json& entry, const REWARD_FUNCTION& base){
+        Variant variant{entry.at("name").get<std::string>(), base};
+        REWARD_FUNCTION& p = variant.params;
+        auto assign = [&entry](const char* key, auto& field){
+            if(entry.contains(key)){
+                field = entry.at(key).get<std::remove_reference_t<decltype(field)>>();
+            }
+        };
+        assign("nonNegative", p.non_negative);
+        assign("scale", p.scale);
+        assign("constant", p.constant);
+        assign("terminationPenalty", p.termination_penalty);
+        assign("position", p.position);
+        assign("orientation", p.orientation);
+        assign("linearVelocity", p.linear_velocity);
+        assign("angularVelocity", p.angular_velocity);
+        assign("linearAcceleration", p.linear_acceleration);
+        assign("angularAcceleration", p.angular_acceleration);
+        assign("actionBaseline", p.action_baseline);
+        assign("action", p.action);
+        assign("targetRadius", p.target_radius);
+        assign("velocityRewardScale", p.velocity_reward_scale);
+        assign("useTargetProgress", p.use_target_progress);
+        if(entry.contains("target")){
+            for(TI dim_i = 0; dim_i < 3; dim_i++){
+                p.target_pos[dim_i] = entry.at("target").at(dim_i).get<T>();
+            }
+        }
+        return variant;
+    }
+
+    std::vector<Episode> split_episodes(const std::vector<RECORD>& records, const T target[3], T success_radius){
+        std::vector<Episode> episodes;
+        for(size_t record_i = 0; record_i < records.size(); record_i++){
+            const RECORD& record = records[record_i];
+            if(record.first || episodes.empty() || episodes.back().complete){
+                if(!episodes.empty() && !episodes.back().complete){
+                    episodes.back().end = record_i;
+                }
+                episodes.push_back({record_i, records.size(), false, false});
+            }
+            if(record.terminated || record.truncated){
+                Episode& episode = episodes.back();
+                episode.end = record_i + 1;
+                episode.complete = true;
+                T distance_sq = 0;
+                for(TI dim_i = 0; dim_i < 3; dim_i++){
+                    T diff = record.next_state.position[dim_i] - target[dim_i];
+                    distance_sq += diff * diff;
+                }
+                episode.success = !record.terminated && distance_sq < success_radius * success_radius;
+            }
+        }
+        return episodes;
+    }
+
+    // evaluates all variants over the episodes [begin, end), the statistics are indexed [variant_i * NUM_COMPONENTS + component_i]
+    void evaluate(const ENVIRONMENT& env, const std::vector<Variant>& variants, const std::vector<RECORD>& records, const std::vector<Episode>& episodes, size_t begin, size_t end, std::vector<Statistics>& statistics){
+        DEVICE device;
+        rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, ENVIRONMENT::ACTION_DIM>> action;
+        rlt::malloc(device, action);
+        statistics.assign(variants.size() * NUM_COMPONENTS, Statistics{});
+        std::vector<double> episode_totals(variants.size() * NUM_COMPONENTS);
+        double values[NUM_COMPONENTS];
+        for(size_t episode_i = begin; episode_i < end; episode_i++){
+            const Episode& episode = episodes[episode_i];
+            std::fill(episode_totals.begin(), episode_totals.end(), 0);
+            for(size_t record_i = episode.begin; record_i < episode.end; record_i++){
+                const RECORD& record = records[record_i];
+                for(TI action_i = 0; action_i < ENVIRONMENT::ACTION_DIM; action_i++){
+                    rlt::set(action, 0, action_i, record.action[action_i]);
+                }
+                for(size_t variant_i = 0; variant_i < variants.size(); variant_i++){
+                    // the stored termination flag already includes obstacle collisions (cached in next_state during training)
+                    auto components = reward_functions::reward_components(device, env, variants[variant_i].params, record.state, action, record.next_state, (bool)record.terminated);
+                    unpack(components, values);
+                    for(TI component_i = 0; component_i < NUM_COMPONENTS; component_i++){
+                        Statistics& s = statistics[variant_i * NUM_COMPONENTS + component_i];
+                        s.count += 1;
+                        s.sum += values[component_i];
+                        s.sum_sq += values[component_i] * values[component_i];
+                        s.min = std::min(s.min, values[component_i]);
+                        s.max = std::max(s.max, values[component_i]);
+                        episode_totals[variant_i * NUM_COMPONENTS + component_i] += values[component_i];
+                    }
+                }
+            }
+            if(episode.complete){
+                for(size_t stat_i = 0; stat_i < statistics.size(); stat_i++){
+                    Statistics& s = statistics[stat_i];
+                    double total = episode_totals[stat_i];
+                    s.episodes += 1;
+                    s.episode_sum += total;
+                    s.episode_sum_sq += total * total;
+                    s.episode_sum_success += episode.success ? total : 0;
+                    s.successes += episode.success;
+                }
+            }
+        }
+        rlt::free(device, action);
+    }
+
+    nlohmann::json report(const std::vector<Variant>& variants, const std::vector<Statistics>& statistics){
+        nlohmann::json json = nlohmann::json::array();
+        for(size_t variant_i = 0; variant_i < variants.size(); variant_i++){
+            nlohmann::json components = nlohmann::json::object();
+            for(TI component_i = 0; component_i < NUM_COMPONENTS; component_i++){
+                const Statistics& s = statistics[variant_i * NUM_COMPONENTS + component_i];
+                double correlation = s.success_correlation();
+                components[COMPONENT_NAMES[component_i]] = {
+                    {"mean", s.mean()}, {"std", s.standard_deviation()}, {"min", s.min}, {"max", s.max},
+                    {"episodeMean", s.episode_mean()},
+                    {"successCorrelation", std::isnan(correlation) ? nlohmann::json() : nlohmann::json(correlation)}
+                };
+            }
+            json.push_back({{"name", variants[variant_i].name}, {"components", components}});
+        }
+        return json;
+    }
+}
+
+int main(int argc, char** argv){
+    using namespace reward_variants;
+    if(argc != 3 && argc != 4){
+        std::cerr << "Usage: " << argv[0] << " <transitions.bin> <variants.json> [report.json]" << std::endl;
+        return 1;
+    }
+    ENVIRONMENT env;
+    env.parameters = parameters::environment<T, TI, typename CONFIG::ABLATION_SPEC>::parameters;
+    const REWARD_FUNCTION base = reward_functions::prune<reward_functions::terms::ALL>(env.parameters.mdp.reward);
+
+    std::vector<Variant> variants = {{"training", base}};
+    T success_radius = base.target_radius;
+    {
+        std::ifstream file(argv[2]);
+        if(!file){
+            std::cerr << "Could not open variants: " << argv[2] << std::endl;
+            return 1;
+        }
+        nlohmann::json json = nlohmann::json::parse(file);
+        if(json.is_object() && json.contains("successRadius")){
+            success_radius = json.at("successRadius").get<T>();
+        }
+        for(const auto& entry: json.is_object() ? json.at("variants") : json){
+            variants.push_back(variant_from_json(entry, base));
+        }
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<RECORD> records = learning_to_fly::transition_dump::load<ENVIRONMENT>(argv[1]);
+    std::vector<Episode> episodes = split_episodes(records, base.target_pos, success_radius);
+    TI complete_episodes = 0, successful_episodes = 0;
+    for(const auto& episode: episodes){
+        complete_episodes += episode.complete;
+        successful_episodes += episode.success;
+    }
+    std::cout << "Loaded " << records.size() << " transitions (" << episodes.size() << " episodes, " << complete_episodes << " complete, " << successful_episodes << " successful)" << std::endl;
+
+    // contiguous ranges of whole episodes per worker, balanced by the number of transitions
+    TI num_threads = learning_to_fly::constants::REWARD_VARIANTS_THREADS > 0 ? learning_to_fly::constants::REWARD_VARIANTS_THREADS : std::max(std::thread::hardware_concurrency(), 1u);
+    num_threads = std::max<TI>(std::min<TI>(num_threads, episodes.size()), 1);
+    std::vector<size_t> boundaries = {0};
+    for(size_t episode_i = 0; episode_i < episodes.size() && boundaries.size() < num_threads; episode_i++){
+        if(episodes[episode_i].end * num_threads >= records.size() * boundaries.size()){
+            boundaries.push_back(episode_i + 1);
+        }
+    }
+    boundaries.push_back(episodes.size());
+    std::vector<std::vector<Statistics>> partial_statistics(boundaries.size() - 1);
+    std::vector<std::thread> workers;
+    for(size_t worker_i = 0; worker_i < partial_statistics.size(); worker_i++){
+        workers.emplace_back(reward_variants::evaluate, std::cref(env), std::cref(variants), std::cref(records), std::cref(episodes), boundaries[worker_i], boundaries[worker_i + 1], std::ref(partial_statistics[worker_i]));
+    }
+    for(auto& worker: workers){
+        worker.join();
+    }
+    std::vector<Statistics> statistics(variants.size() * NUM_COMPONENTS);
+    for(const auto& partial: partial_statistics){
+        for(size_t stat_i = 0; stat_i < statistics.size(); stat_i++){
+            statistics[stat_i].merge(partial[stat_i]);
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Evaluated " << variants.size() << " variants on " << workers.size() << " threads in " << std::chrono::duration<double>(end - start).count() << "s" << std::endl;
+
+    for(size_t variant_i = 0; variant_i < variants.size(); variant_i++){
+        const Statistics& reward = statistics[variant_i * NUM_COMPONENTS + REWARD];
+        std::cout << "\n" << variants[variant_i].name << ": mean episode return " << reward.episode_mean() << ", return/success correlation " << reward.success_correlation() << std::endl;
+        std::cout << "    " << std::left << std::setw(22) << "component" << std::right << std::setw(12) << "mean" << std::setw(12) << "std" << std::setw(12) << "min" << std::setw(12) << "max" << std::setw(14) << "episode mean" << std::setw(14) << "corr(success)" << std::endl;
+        for(TI component_i = 0; component_i < NUM_COMPONENTS; component_i++){
+            const Statistics& s = statistics[variant_i * NUM_COMPONENTS + component_i];
+            std::cout << "    " << std::left << std::setw(22) << COMPONENT_NAMES[component_i] << std::right << std::setw(12) << s.mean() << std::setw(12) << s.standard_deviation() << std::setw(12) << s.min << std::setw(12) << s.max << std::setw(14) << s.episode_mean() << std::setw(14) << s.success_correlation() << std::endl;
+        }
+    }
+    if(argc == 4){
+        std::ofstream file(argv[3]);
+        file << std::setw(2) << nlohmann::json{
+            {"transitions", records.size()}, {"episodes", complete_episodes}, {"successfulEpisodes", successful_episodes},
+            {"successRadius", success_radius}, {"variants", report(variants, statistics)}
+        } << std::endl;
+        std::cout << "\nReport: " << argv[3] << std::endl;
+    }
+    return 0;
+}
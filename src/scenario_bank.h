@@ -0,0 +1,152 @@
+#ifndef LEARNING_TO_FLY_SCENARIO_BANK_H
+#define LEARNING_TO_FLY_SCENARIO_BANK_H
+
+#include "constants.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace learning_to_fly {
+namespace scenario_bank {
+    /**
+     * Common random numbers for the evaluation (CONFIG::SCENARIO_BANK). A scenario fixes everything an evaluation episode
+     * draws: the initial state (including the random force and torque disturbances of StateRandomForce), the seed of the
+     * obstacle course drawn around its spawn position and the seed of the RNG the episode steps with (observation and
+     * dynamics noise). Every evaluation replays episode i from scenario i % size, so return differences between checkpoints
+     * are differences between the policies rather than between the draws.
+     * The bank is generated once (save) and memory-mapped read-only (Bank), so that concurrent evaluations share the pages.
+     * Layout: 8 byte magic, uint32 record size, uint32 reserved, uint64 number of records, followed by the raw records
+     * (native byte order and padding, same as transition_dump.h). The magic differs from obstacle_scene::BINARY_MAGIC, so that
+     * a scene file passed as a bank (or vice versa) is rejected.
+     */
+    constexpr char MAGIC[8] = {'L', '2', 'F', 'B', 'N', 'K', '0', '1'};
+
+    template <typename ENVIRONMENT>
+    struct Record {
+        typename ENVIRONMENT::State state;
+        uint64_t course_seed;
+        uint64_t noise_seed;
+    };
+
+    struct Header {
+        char magic[sizeof(MAGIC)];
+        uint32_t record_size;
+        uint32_t reserved;
+        uint64_t num_records;
+    };
+
+    template <typename DEVICE, typename ENVIRONMENT>
+    void save(DEVICE& device, const ENVIRONMENT& env_template, const std::string& path, uint64_t num_records, uint64_t seed) {
+        using RECORD = Record<ENVIRONMENT>;
+        static_assert(std::is_trivially_copyable_v<typename ENVIRONMENT::State>);
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Could not open scenario bank for writing: " + path);
+        }
+        Header header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.record_size = sizeof(RECORD);
+        header.num_records = num_records;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        auto rng = rlt::random::default_engine(typename DEVICE::SPEC::RANDOM{}, seed);
+        ENVIRONMENT env = env_template;
+        for (uint64_t record_i = 0; record_i < num_records; record_i++) {
+            RECORD record{};
+            rlt::sample_initial_state(device, env, record.state, rng);
+            record.course_seed = rlt::random::uniform_int_distribution(device.random, (uint64_t)0, (uint64_t)0x7FFFFFFF, rng);
+            record.noise_seed = rlt::random::uniform_int_distribution(device.random, (uint64_t)0, (uint64_t)0x7FFFFFFF, rng);
+            file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        }
+        if (!file) {
+            throw std::runtime_error("Error while writing scenario bank: " + path);
+        }
+    }
+
+    // read-only memory mapping of a bank written by save
+    template <typename ENVIRONMENT>
+    class Bank {
+    public:
+        using RECORD = Record<ENVIRONMENT>;
+        static_assert(sizeof(Header) % alignof(RECORD) == 0);
+        explicit Bank(const std::string& path) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::runtime_error("Could not open scenario bank: " + path);
+            }
+            struct stat file_stat;
+            if (::fstat(fd, &file_stat) != 0 || (size_t)file_stat.st_size < sizeof(Header)) {
+                ::close(fd);
+                throw std::runtime_error("Not a scenario bank: " + path);
+            }
+            mapping_size = file_stat.st_size;
+            mapping = ::mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (mapping == MAP_FAILED) {
+                mapping = nullptr;
+                throw std::runtime_error("Could not map scenario bank: " + path);
+            }
+            const Header& header = *static_cast<const Header*>(mapping);
+            std::string error;
+            if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+                error = "Not a scenario bank: " + path;
+            }
+            else if (header.record_size != sizeof(RECORD)) {
+                error = "Scenario bank " + path + " was written for a different environment (record size " + std::to_string(header.record_size) + ", expected " + std::to_string(sizeof(RECORD)) + ")";
+            }
+            else if (header.num_records == 0 || mapping_size < sizeof(Header) + header.num_records * sizeof(RECORD)) {
+                error = "Truncated scenario bank: " + path;
+            }
+            if (!error.empty()) {
+                ::munmap(mapping, mapping_size);
+                mapping = nullptr;
+                throw std::runtime_error(error);
+            }
+            num_records = header.num_records;
+            records = reinterpret_cast<const RECORD*>(static_cast<const char*>(mapping) + sizeof(Header));
+        }
+        ~Bank() {
+            if (mapping != nullptr) {
+                ::munmap(mapping, mapping_size);
+            }
+        }
+        Bank(const Bank&) = delete;
+        Bank& operator=(const Bank&) = delete;
+        size_t size() const { return num_records; }
+        const RECORD& operator[](size_t episode_i) const { return records[episode_i % num_records]; }
+    private:
+        void* mapping = nullptr;
+        size_t mapping_size = 0;
+        size_t num_records = 0;
+        const RECORD* records = nullptr;
+    };
+
+    inline std::string path() {
+        const char* override_path = std::getenv(constants::SCENARIO_BANK_PATH_ENV);
+        return override_path != nullptr ? std::string(override_path) : std::string(constants::SCENARIO_BANK_PATH);
+    }
+
+    // sets up env and state for a scenario and seeds the RNG the episode is stepped with. Unlike sample_initial_state this does
+    // not go through the environment's initialization, hence the derived wrench mixing is (re)computed here
+    template <typename DEVICE, typename ENVIRONMENT, typename RNG>
+    void apply(DEVICE& device, ENVIRONMENT& env, const Record<ENVIRONMENT>& record, typename ENVIRONMENT::State& state, RNG& rng) {
+        rlt::rl::environments::multirotor::update_wrench_mixing(device, env.parameters.dynamics);
+        state = record.state;
+        auto course_rng = rlt::random::default_engine(typename DEVICE::SPEC::RANDOM{}, record.course_seed);
+        rlt::rl::environments::multirotor::parameters::reward_functions::sample_obstacle_course(device, env.parameters.mdp.reward, state.position, course_rng);
+        rlt::rl::environments::multirotor::update_obstacle_cache(device, env, state);
+        rng = rlt::random::default_engine(typename DEVICE::SPEC::RANDOM{}, record.noise_seed);
+    }
+}
+}
+
+#endif
@@ -0,0 +1,172 @@
+#include <memory>
+#include <thread>
+
+namespace learning_to_fly{
+    namespace steps{
+        /**
+         * Learner side of the asynchronous data collection (CONFIG::ASYNC_COLLECTION, cf. async_collection.h). A learner step
+         * still consumes exactly N_ENVIRONMENTS transitions (one per environment on average), so STEP_LIMIT, the warmup and
+         * the training intervals keep their meaning, but the environments are stepped by the collectors while the learner trains.
+         */
+        namespace async_collection{
+            // writes the actor and the environment parameters into the half of the double buffer that is not published and swaps
+            // it in. If a collector is still copying from that half (it was published until the last call) the publish is retried
+            // at the next step instead of waiting
+            template <typename CONFIG>
+            bool publish(TrainingState<CONFIG>& ts){
+                using T = typename CONFIG::T;
+                using TI = typename CONFIG::TI;
+                using CAPTURE = rlt::rl::environments::multirotor::parameters::reward_functions::Capture<T>;
+                auto& pipeline = *ts.async_pipeline;
+                uint32_t slot = 1 - pipeline.published.load();
+                if(pipeline.readers[slot].load() != 0){
+                    pipeline.skipped_publishes++;
+                    return false;
+                }
+                auto& snapshot = pipeline.snapshots[slot];
+                rlt::copy(ts.device, ts.device, ts.actor_critic.actor, snapshot.actor);
+                for(TI env_i = 0; env_i < CONFIG::N_ENVIRONMENTS; env_i++){
+                    snapshot.parameters[env_i] = ts.off_policy_runner.envs[env_i].parameters;
+                    // the collectors label through the returned components (see collect), not through the learner's capture
+                    rlt::rl::environments::multirotor::parameters::reward_functions::set_reward_capture(snapshot.parameters[env_i].mdp.reward, (CAPTURE*)nullptr);
+                    snapshot.reward_version[env_i] = ts.current_reward_version[env_i];
+                }
+                snapshot.exploration_noise = ts.off_policy_runner.parameters.exploration_noise;
+                pipeline.published.store(slot);
+                pipeline.version.fetch_add(1);
+                return true;
+            }
+            // started lazily at the first collection, so that actor weights loaded after init (checkpoints) are the first snapshot
+            template <typename CONFIG>
+            void start(TrainingState<CONFIG>& ts){
+                using TI = typename CONFIG::TI;
+                using PIPELINE = learning_to_fly::async_collection::Pipeline<CONFIG>;
+                ts.async_pipeline = std::make_unique<PIPELINE>();
+                auto& pipeline = *ts.async_pipeline;
+                pipeline.use_policy_switching = ts.use_policy_switching && ts.hover_actor_loaded;
+                pipeline.hover_actor = &ts.hover_actor;
+                pipeline.policy_switch_threshold = ts.policy_switch_threshold;
+                for(auto& snapshot: pipeline.snapshots){
+                    rlt::malloc(ts.device, snapshot.actor);
+                }
+                publish(ts);
+                for(TI collector_i = 0; collector_i < PIPELINE::NUM_COLLECTORS; collector_i++){
+                    TI seed = rlt::random::uniform_int_distribution(ts.device.random, (TI)0, (TI)0x7FFFFFFF, ts.rng);
+                    pipeline.collectors.emplace_back(learning_to_fly::async_collection::collect<CONFIG>, std::ref(pipeline), collector_i, seed);
+                }
+                std::cout << "Asynchronous data collection: " << PIPELINE::NUM_COLLECTORS << " collector thread(s)" << std::endl;
+            }
+            template <typename CONFIG>
+            void stop(TrainingState<CONFIG>& ts){
+                if(!ts.async_pipeline){
+                    return;
+                }
+                auto& pipeline = *ts.async_pipeline;
+                pipeline.stop.store(true);
+                for(auto& collector: pipeline.collectors){
+                    collector.join();
+                }
+                for(auto& snapshot: pipeline.snapshots){
+                    rlt::free(ts.device, snapshot.actor);
+                }
+                ts.async_pipeline.reset();
+            }
+            // keeps the episode bookkeeping of the off-policy runner (current state, episode step and return, episode statistics,
+            // hover flags) as if it had stepped the environment itself. The transitions of an environment arrive in order, hence
+            // counting them reproduces the episode steps of the collector
+            template <typename CONFIG>
+            void update_episode(TrainingState<CONFIG>& ts, const learning_to_fly::async_collection::Transition<CONFIG>& transition){
+                using TI = typename CONFIG::TI;
+                using T = typename CONFIG::T;
+                auto& runner = ts.off_policy_runner;
+                TI env_i = transition.env_i;
+                rlt::get(runner.states, 0, env_i) = transition.next_state;
+                TI episode_step = rlt::get(runner.episode_step, 0, env_i) + 1;
+                T episode_return = rlt::get(runner.episode_return, 0, env_i) + transition.reward;
+                ts.env_using_hover[env_i] = transition.using_hover;
+                if(transition.terminated || transition.truncated){
+                    if constexpr(CONFIG::OFF_POLICY_RUNNER_SPEC::COLLECT_EPISODE_STATS){
+                        auto& episode_stats = runner.episode_stats[env_i];
+                        rlt::set(episode_stats.returns, episode_stats.next_episode_i, 0, episode_return);
+                        rlt::set(episode_stats.steps, episode_stats.next_episode_i, 0, episode_step);
+                        episode_stats.next_episode_i = (episode_stats.next_episode_i + 1) % CONFIG::OFF_POLICY_RUNNER_SPEC::EPISODE_STATS_BUFFER_SIZE;
+                    }
+                    episode_step = 0;
+                    episode_return = 0;
+                }
+                rlt::set(runner.episode_step, 0, env_i, episode_step);
+                rlt::set(runner.episode_return, 0, env_i, episode_return);
+            }
+            // drains N_ENVIRONMENTS transitions from the collector queues (round robin) into the replay buffers
+            template <typename CONFIG>
+            void collect(TrainingState<CONFIG>& ts){
+                using TI = typename CONFIG::TI;
+                using T = typename CONFIG::T;
+                using ENVIRONMENT = typename CONFIG::ENVIRONMENT;
+                using PIPELINE = learning_to_fly::async_collection::Pipeline<CONFIG>;
+                if(!ts.async_pipeline){
+                    start(ts);
+                }
+                auto& pipeline = *ts.async_pipeline;
+                auto& transition = pipeline.transition;
+                for(TI transition_i = 0; transition_i < CONFIG::N_ENVIRONMENTS; transition_i++){
+                    bool waited = false;
+                    while(!pipeline.queues[pipeline.next_queue].pop(transition)){
+                        waited = true;
+                        std::this_thread::yield();
+                    }
+                    pipeline.stalls += waited;
+                    pipeline.next_queue = (pipeline.next_queue + 1) % PIPELINE::NUM_COLLECTORS;
+
+                    auto& replay_buffer = ts.off_policy_runner.replay_buffers[transition.env_i];
+                    TI row_i = replay_buffer.position;
+                    rlt::get(replay_buffer.states, row_i, 0) = transition.state;
+                    rlt::get(replay_buffer.next_states, row_i, 0) = transition.next_state;
+                    for(TI i = 0; i < ENVIRONMENT::OBSERVATION_DIM; i++){
+                        rlt::set(replay_buffer.observations, row_i, i, transition.observation[i]);
+                        rlt::set(replay_buffer.next_observations, row_i, i, transition.next_observation[i]);
+                    }
+                    if constexpr(CONFIG::ASYMMETRIC_OBSERVATIONS){
+                        for(TI i = 0; i < ENVIRONMENT::OBSERVATION_DIM_PRIVILEGED; i++){
+                            rlt::set(replay_buffer.observations_privileged, row_i, i, transition.observation_privileged[i]);
+                            rlt::set(replay_buffer.next_observations_privileged, row_i, i, transition.next_observation_privileged[i]);
+                        }
+                    }
+                    for(TI i = 0; i < ENVIRONMENT::ACTION_DIM; i++){
+                        rlt::set(replay_buffer.actions, row_i, i, transition.action[i]);
+                    }
+                    rlt::set(replay_buffer.rewards, row_i, 0, transition.reward);
+                    rlt::set(replay_buffer.terminated, row_i, 0, transition.terminated);
+                    rlt::set(replay_buffer.truncated, row_i, 0, transition.truncated);
+                    replay_buffer.position = (replay_buffer.position + 1) % CONFIG::REPLAY_BUFFER_CAP;
+                    if(replay_buffer.position == 0){
+                        replay_buffer.full = true;
+                    }
+                    if constexpr(reward_relabeling::enabled<CONFIG>()){
+                        // a transition labeled before the last curriculum change is stale and gets relabeled when it is sampled
+                        ts.reward_versions[transition.env_i][row_i] = transition.reward_version;
+                    }
+                    rlt::rl::environments::multirotor::parameters::reward_functions::capture(&ts.reward_capture, transition.components);
+                    update_episode(ts, transition);
+                }
+                if(ts.step % 1000 == 0){
+                    rlt::add_scalar(ts.device, ts.device.logger, "async_collection/stalls", (T)pipeline.stalls);
+                    rlt::add_scalar(ts.device, ts.device.logger, "async_collection/skipped_publishes", (T)pipeline.skipped_publishes);
+                    rlt::add_scalar(ts.device, ts.device.logger, "async_collection/snapshot_version", (T)pipeline.version.load());
+                    pipeline.stalls = 0;
+                    pipeline.skipped_publishes = 0;
+                }
+            }
+            // publishes the actor every ASYNC_PUBLISH_INTERVAL steps (and retries a skipped publish at the next step)
+            template <typename CONFIG>
+            void update(TrainingState<CONFIG>& ts){
+                if(!ts.async_pipeline){
+                    return;
+                }
+                if(ts.step % CONFIG::ASYNC_PUBLISH_INTERVAL == 0 || ts.async_publish_pending){
+                    ts.async_publish_pending = !publish(ts);
+                }
+            }
+        }
+    }
+}
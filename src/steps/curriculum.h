@@ -49,10 +49,14 @@ namespace learning_to_fly {
                         }
                     }
                     if constexpr(CONFIG::ABLATION_SPEC::RECALCULATE_REWARDS == true){
-                        auto start = std::chrono::high_resolution_clock::now();
-                        rlt::recalculate_rewards(ts.device, ts.off_policy_runner.replay_buffers[0], ts.off_policy_runner.envs[0], ts.rng_eval);
-                        auto end = std::chrono::high_resolution_clock::now();
-//                        std::cout << "recalculate_rewards: " << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << "ms\n";
+                        if constexpr(CONFIG::LAZY_REWARD_RELABELING){
+                            // stale rows are relabeled when they are sampled (cf. reward_relabeling.h)
+                            reward_relabeling::invalidate_rewards(ts);
+                        }
+                        else{
+                            // multi-threaded, logs curriculum/recalculate_rewards_ms (cf. recalculate_rewards.h)
+                            recalculate_rewards(ts);
+                        }
                     }
                 }
             }
@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <thread>
+
+namespace learning_to_fly{
+    namespace steps{
+        /**
+         * Deterministic evaluation every EVALUATION_INTERVAL steps. With CONFIG::BACKGROUND_EVALUATION the episodes run on
+         * constants::EVALUATION_WORKERS threads with a snapshot of actor_target (cf. background_evaluation.h) while training
+         * continues. The results are delivered in order as soon as they are available: into ts.evaluation_results, the logger
+         * (at the step of the snapshot) and steps::save_best_actor, which saves the evaluated snapshot.
+         */
+        namespace internal{
+            // worker threads of the background evaluation pool
+            inline unsigned evaluation_workers(){
+                return constants::EVALUATION_WORKERS > 0 ? constants::EVALUATION_WORKERS : std::max(std::thread::hardware_concurrency() / 2, 1u);
+            }
+            // threads a single batched evaluation works off its shards with. The background jobs share half of the hardware
+            // threads (the rest is left to training), so that the pool does not oversubscribe the CPU when all workers are busy
+            template <typename CONFIG>
+            unsigned evaluation_threads(){
+                unsigned hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+                if constexpr(CONFIG::BACKGROUND_EVALUATION){
+                    return std::max(hardware_threads / 2 / evaluation_workers(), 1u);
+                }
+                else{
+                    return hardware_threads;
+                }
+            }
+            // CONFIG::BATCHED_EVALUATION: lockstep episodes with batched forward passes (cf. batched_evaluation.h) instead of rlt::evaluate,
+            // CONFIG::SEQUENTIAL_EVALUATION: the same in rounds until the comparison with best_return (and the target) is settled
+            template <typename CONFIG, typename DEVICE, typename ENVIRONMENT, typename UI, typename ACTOR, typename BUFFERS, typename RNG>
+            typename TrainingState<CONFIG>::EVALUATION_RESULT run_evaluation(TrainingState<CONFIG>& ts, DEVICE& device, ENVIRONMENT& env, UI& ui, const ACTOR& actor, BUFFERS& buffers, RNG& rng, double best_return, typename CONFIG::TI& num_episodes){
+                using TI = typename CONFIG::TI;
+                typename TrainingState<CONFIG>::EVALUATION_RESULT result;
+                num_episodes = CONFIG::NUM_EVALUATION_EPISODES;
+                if constexpr(CONFIG::SEQUENTIAL_EVALUATION){
+                    TI seed = rlt::random::uniform_int_distribution(device.random, (TI)0, (TI)0x7FFFFFFF, rng);
+                    num_episodes = batched_evaluation::sequential_evaluate<CONFIG>(device, env, actor, ts.observations_mean, ts.observations_std, ts.evaluation_scenarios.get(), seed, evaluation_threads<CONFIG>(), best_return, (double)CONFIG::SEQUENTIAL_EVALUATION_TARGET_RETURN, result);
+                }
+                else if constexpr(CONFIG::BATCHED_EVALUATION){
+                    TI seed = rlt::random::uniform_int_distribution(device.random, (TI)0, (TI)0x7FFFFFFF, rng);
+                    batched_evaluation::evaluate<CONFIG>(device, env, actor, ts.observations_mean, ts.observations_std, ts.evaluation_scenarios.get(), seed, evaluation_threads<CONFIG>(), result);
+                }
+                else{
+                    result = rlt::evaluate(device, env, ui, actor,
+                        rlt::rl::utils::evaluation::Specification<CONFIG::NUM_EVALUATION_EPISODES, CONFIG::ENVIRONMENT_STEP_LIMIT_EVALUATION>(),
+                        ts.observations_mean, ts.observations_std, buffers, rng, false);
+                }
+                return result;
+            }
+            template <typename CONFIG, typename RESULT, typename ACTOR>
+            void deliver_evaluation(TrainingState<CONFIG>& ts, typename CONFIG::TI evaluation_i, typename CONFIG::TI step, const RESULT& result, typename CONFIG::TI num_episodes, const ACTOR& actor){
+                assert(evaluation_i < TrainingState<CONFIG>::N_EVALUATIONS);
+                ts.evaluation_results[evaluation_i] = result;
+                ts.evaluations_delivered = evaluation_i + 1;
+                rlt::set_step(ts.device, ts.device.logger, step);
+                rlt::logging::text(ts.device, ts.device.logger, "Step: ", step, " (mean return: ", result.returns_mean, ", mean episode length: ", result.episode_length_mean, ")");
+                rlt::add_scalar(ts.device, ts.device.logger, "evaluation/returns_mean", result.returns_mean);
+                rlt::add_scalar(ts.device, ts.device.logger, "evaluation/returns_std", result.returns_std);
+                rlt::add_scalar(ts.device, ts.device.logger, "evaluation/episode_length_mean", result.episode_length_mean);
+                rlt::add_scalar(ts.device, ts.device.logger, "evaluation/episode_length_std", result.episode_length_std);
+                rlt::add_scalar(ts.device, ts.device.logger, "evaluation/episodes", num_episodes);
+                rlt::set_step(ts.device, ts.device.logger, ts.step);
+                std::cout << "📊 Evaluation at step " << step << ":" << std::endl;
+                std::cout << "   Mean return: " << result.returns_mean
+                          << " (std: " << result.returns_std << ")" << std::endl;
+                std::cout << "   Mean episode length: " << result.episode_length_mean
+                          << " (std: " << result.episode_length_std << ")" << std::endl;
+                if(num_episodes < CONFIG::NUM_EVALUATION_EPISODES){
+                    std::cout << "   Settled after " << num_episodes << " episodes" << std::endl;
+                }
+                save_best_actor(ts, actor, step, (typename CONFIG::T)result.returns_mean);
+            }
+            // delivers the finished jobs at the front of the queue (all of them, waiting if necessary, when wait is set)
+            template <typename CONFIG>
+            void poll_evaluations(TrainingState<CONFIG>& ts, bool wait = false){
+                while(!ts.evaluation_jobs.empty()){
+                    auto& job = *ts.evaluation_jobs.front();
+                    while(wait && !job.done.load()){
+                        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    }
+                    if(!job.done.load()){
+                        break;
+                    }
+                    deliver_evaluation(ts, job.evaluation_i, job.step, job.result, job.episodes, job.actor);
+                    rlt::free(ts.device, job.actor);
+                    ts.evaluation_jobs.pop_front();
+                }
+            }
+            template <typename CONFIG>
+            void submit_evaluation(TrainingState<CONFIG>& ts){
+                using TI = typename CONFIG::TI;
+                using JOB = typename TrainingState<CONFIG>::EVALUATION_JOB;
+                if(!ts.evaluation_pool){
+                    ts.evaluation_pool = std::make_unique<background_evaluation::WorkerPool>(evaluation_workers());
+                }
+                ts.evaluation_jobs.push_back(std::make_unique<JOB>());
+                JOB* job = ts.evaluation_jobs.back().get();
+                job->evaluation_i = ts.step / CONFIG::EVALUATION_INTERVAL;
+                job->step = ts.step;
+                job->seed = rlt::random::uniform_int_distribution(ts.device.random, (TI)0, (TI)0x7FFFFFFF, ts.rng_eval);
+                rlt::malloc(ts.device, job->actor);
+                rlt::copy(ts.device, ts.device, ts.actor_critic.actor_target, job->actor);
+                job->env = ts.env_eval;
+                // best return at submission, results of earlier jobs that are still running are not taken into account
+                job->best_return = ts.best_evaluation_return;
+                auto ui = ts.ui;
+                ts.evaluation_pool->submit([&ts, job, ui]() mutable {
+                    typename CONFIG::DEVICE device;
+                    auto rng = rlt::random::default_engine(typename CONFIG::DEVICE::SPEC::RANDOM{}, job->seed);
+                    std::remove_reference_t<decltype(ts.actor_deterministic_evaluation_buffers)> buffers;
+                    if constexpr(!CONFIG::BATCHED_EVALUATION && !CONFIG::SEQUENTIAL_EVALUATION){
+                        rlt::malloc(device, buffers);
+                    }
+                    // observations_mean/std are constant during training
+                    job->result = run_evaluation(ts, device, job->env, ui, job->actor, buffers, rng, job->best_return, job->episodes);
+                    if constexpr(!CONFIG::BATCHED_EVALUATION && !CONFIG::SEQUENTIAL_EVALUATION){
+                        rlt::free(device, buffers);
+                    }
+                    job->done.store(true);
+                });
+            }
+        }
+        // maps the scenario bank (CONFIG::SCENARIO_BANK, cf. scenario_bank.h), generating it first if it does not exist. Falls
+        // back to fresh draws from rng_eval if the bank can not be used
+        template <typename CONFIG>
+        void init_evaluation(TrainingState<CONFIG>& ts){
+            using BANK = scenario_bank::Bank<typename CONFIG::ENVIRONMENT_EVALUATION>;
+            if constexpr(CONFIG::DETERMINISTIC_EVALUATION && CONFIG::SCENARIO_BANK){
+                static_assert(CONFIG::BATCHED_EVALUATION || CONFIG::SEQUENTIAL_EVALUATION, "The scenario bank is replayed by the batched evaluator");
+                std::string path = scenario_bank::path();
+                try{
+                    if(!std::filesystem::exists(path)){
+                        std::filesystem::path parent = std::filesystem::path(path).parent_path();
+                        if(!parent.empty()){
+                            std::filesystem::create_directories(parent);
+                        }
+                        std::cout << "Generating evaluation scenario bank (" << CONFIG::NUM_EVALUATION_EPISODES << " scenarios): " << path << std::endl;
+                        scenario_bank::save(ts.device, ts.env_eval, path, CONFIG::NUM_EVALUATION_EPISODES, constants::SCENARIO_BANK_SEED);
+                    }
+                    ts.evaluation_scenarios = std::make_unique<BANK>(path);
+                    std::cout << "Evaluation scenario bank: " << path << " (" << ts.evaluation_scenarios->size() << " scenarios)" << std::endl;
+                }
+                catch(std::exception& e){
+                    std::cout << "Error while loading the evaluation scenario bank, evaluating on fresh draws: " << e.what() << std::endl;
+                }
+            }
+        }
+        template <typename CONFIG>
+        void evaluation(TrainingState<CONFIG>& ts){
+            using TI = typename CONFIG::TI;
+            if constexpr(CONFIG::DETERMINISTIC_EVALUATION){
+                if constexpr(CONFIG::BACKGROUND_EVALUATION){
+                    internal::poll_evaluations(ts);
+                }
+                if(ts.step % CONFIG::EVALUATION_INTERVAL == 0){
+                    if constexpr(CONFIG::BACKGROUND_EVALUATION){
+                        internal::submit_evaluation(ts);
+                    }
+                    else{
+                        TI num_episodes;
+                        auto result = internal::run_evaluation(ts, ts.device, ts.env_eval, ts.ui, ts.actor_critic.actor_target, ts.actor_deterministic_evaluation_buffers, ts.rng_eval, (double)ts.best_evaluation_return, num_episodes);
+                        internal::deliver_evaluation(ts, (TI)(ts.step / CONFIG::EVALUATION_INTERVAL), ts.step, result, num_episodes, ts.actor_critic.actor_target);
+                    }
+                }
+            }
+        }
+        // waits for the outstanding background evaluations (end of training), so that ts.evaluation_results is complete
+        template <typename CONFIG>
+        void finish_evaluation(TrainingState<CONFIG>& ts){
+            if constexpr(CONFIG::DETERMINISTIC_EVALUATION && CONFIG::BACKGROUND_EVALUATION){
+                internal::poll_evaluations(ts, true);
+                ts.evaluation_pool.reset();
+            }
+        }
+    }
+}
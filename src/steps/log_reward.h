@@ -1,17 +1,70 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
 namespace learning_to_fly{
     namespace steps{
+        namespace internal{
+            // mean and deciles of the rows [begin, end) of one column of the reward capture
+            template <typename DEVICE, typename T>
+            void log_reward_component(DEVICE& device, const std::string& name, const T* column, size_t begin, size_t end, std::vector<T>& values){
+                constexpr size_t CAPACITY = rlt::rl::environments::multirotor::parameters::reward_functions::Capture<T>::CAPACITY;
+                values.resize(end - begin);
+                double sum = 0;
+                for(size_t row_i = begin; row_i < end; row_i++){
+                    values[row_i - begin] = column[row_i % CAPACITY];
+                    sum += values[row_i - begin];
+                }
+                rlt::add_scalar(device, device.logger, ("reward/" + name).c_str(), sum / values.size());
+                const char* quantile_names[3] = {"_p10", "_p50", "_p90"};
+                const double quantiles[3] = {0.1, 0.5, 0.9};
+                for(size_t quantile_i = 0; quantile_i < 3; quantile_i++){
+                    auto nth = values.begin() + (size_t)(quantiles[quantile_i] * (values.size() - 1));
+                    std::nth_element(values.begin(), nth, values.end());
+                    rlt::add_scalar(device, device.logger, ("reward_distribution/" + name + quantile_names[quantile_i]).c_str(), *nth);
+                }
+            }
+        }
+        /**
+         * Reduces the reward components that the reward function captured for every collected transition since the last call
+         * (cf. reward_functions/capture.h) into means and deciles, every constants::REWARD_LOG_INTERVAL steps. Nothing is
+         * recomputed: the data collection only pays for the writes into the capture.
+         */
         template <typename T_CONFIG>
         void log_reward(TrainingState<T_CONFIG>& ts) {
             using T = typename T_CONFIG::T;
-            using TI = typename T_CONFIG::TI;
-            auto &rb = ts.off_policy_runner.replay_buffers[0];
-            if (rb.position > 0 && rlt::random::uniform_real_distribution(ts.device.random, (T) 0, (T) 1, ts.rng_eval) < 0.01) {
-                TI last_position = rb.position - 1;
-                auto state = rlt::get(rb.states, last_position, 0);
-                auto action = rlt::row(ts.device, rb.actions, last_position);
-                auto next_state = rlt::get(rb.next_states, last_position, 0);
-                rlt::log_reward(ts.device, ts.off_policy_runner.envs[0], state, action, next_state, ts.rng_eval);
+            constexpr size_t CAPACITY = rlt::rl::environments::multirotor::parameters::reward_functions::Capture<T>::CAPACITY;
+            if(ts.step % constants::REWARD_LOG_INTERVAL != 0){
+                return;
+            }
+            const auto& capture = ts.reward_capture;
+            size_t end = capture.written;
+            size_t begin = std::max(ts.reward_capture_read, end > CAPACITY ? end - CAPACITY : 0);
+            size_t overwritten = begin - ts.reward_capture_read;
+            ts.reward_capture_read = end;
+            if(begin == end){
+                return;
+            }
+            std::vector<T> values;
+            internal::log_reward_component(ts.device, "position_cost", capture.position_cost, begin, end, values);
+            internal::log_reward_component(ts.device, "orientation_cost", capture.orientation_cost, begin, end, values);
+            internal::log_reward_component(ts.device, "linear_vel_cost", capture.linear_vel_cost, begin, end, values);
+            internal::log_reward_component(ts.device, "angular_vel_cost", capture.angular_vel_cost, begin, end, values);
+            internal::log_reward_component(ts.device, "linear_acc_cost", capture.linear_acc_cost, begin, end, values);
+            internal::log_reward_component(ts.device, "angular_acc_cost", capture.angular_acc_cost, begin, end, values);
+            internal::log_reward_component(ts.device, "action_cost", capture.action_cost, begin, end, values);
+            internal::log_reward_component(ts.device, "weighted_cost", capture.weighted_cost, begin, end, values);
+            internal::log_reward_component(ts.device, "scaled_weighted_cost", capture.scaled_weighted_cost, begin, end, values);
+            internal::log_reward_component(ts.device, "reward", capture.reward, begin, end, values);
+            size_t terminated = 0, reward_zero = 0;
+            for(size_t row_i = begin; row_i < end; row_i++){
+                terminated += capture.terminated[row_i % CAPACITY];
+                reward_zero += capture.reward[row_i % CAPACITY] == 0;
             }
+            rlt::add_scalar(ts.device, ts.device.logger, "reward/terminated", (T)terminated / (end - begin));
+            rlt::add_scalar(ts.device, ts.device.logger, "reward/reward_zero", (T)reward_zero / (end - begin));
+            rlt::add_scalar(ts.device, ts.device.logger, "reward/captured_transitions", (T)(end - begin));
+            rlt::add_scalar(ts.device, ts.device.logger, "reward/overwritten_transitions", (T)overwritten);
         }
     }
 }
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace learning_to_fly{
+    namespace steps{
+        namespace internal{
+            // reward of the transitions [begin, end) of one replay buffer under the current reward parameters of env. Uses
+            // reward_components instead of rlt::reward, which would also write the relabeled transitions into the reward capture
+            template <typename DEVICE, typename SPEC, typename ENVIRONMENT, typename RNG>
+            void recalculate_rewards(DEVICE& device, rlt::rl::components::ReplayBuffer<SPEC>& replay_buffer, const ENVIRONMENT& env, typename SPEC::TI begin, typename SPEC::TI end, RNG& rng){
+                using TI = typename SPEC::TI;
+                for(TI step_i = begin; step_i < end; step_i++){
+                    const auto& state = rlt::get(replay_buffer.states, step_i, 0);
+                    const auto& next_state = rlt::get(replay_buffer.next_states, step_i, 0);
+                    auto action = rlt::row(device, replay_buffer.actions, step_i);
+                    rlt::set(replay_buffer.rewards, step_i, 0, rlt::rl::environments::multirotor::parameters::reward_functions::reward_components(device, env, env.parameters.mdp.reward, state, action, next_state, rng).reward);
+                }
+            }
+        }
+        /**
+         * Recomputes the rewards of all replay buffers of the off-policy runner after the curriculum changed the reward weights.
+         * The filled part of each buffer is split into contiguous chunks, one per worker thread, and every worker draws from its
+         * own RNG stream (seeded from ts.rng_eval), so that the result does not depend on the scheduling. The reward functions
+         * only read the environment and use the device for math, hence the workers share both.
+         */
+        template <typename CONFIG>
+        void recalculate_rewards(TrainingState<CONFIG>& ts, typename CONFIG::TI num_threads){
+            using TI = typename CONFIG::TI;
+            auto start = std::chrono::high_resolution_clock::now();
+            TI num_transitions[CONFIG::N_ENVIRONMENTS];
+            TI total = 0;
+            for(TI env_i = 0; env_i < CONFIG::N_ENVIRONMENTS; env_i++){
+                auto& replay_buffer = ts.off_policy_runner.replay_buffers[env_i];
+                num_transitions[env_i] = replay_buffer.full ? CONFIG::REPLAY_BUFFER_CAP : replay_buffer.position;
+                total += num_transitions[env_i];
+            }
+            std::vector<TI> seeds(num_threads);
+            for(TI thread_i = 0; thread_i < num_threads; thread_i++){
+                seeds[thread_i] = rlt::random::uniform_int_distribution(ts.device.random, (TI)0, (TI)0x7FFFFFFF, ts.rng_eval);
+            }
+            auto work = [&ts, &num_transitions, &seeds, num_threads](TI thread_i){
+                auto rng = rlt::random::default_engine(typename CONFIG::DEVICE::SPEC::RANDOM{}, seeds[thread_i]);
+                for(TI env_i = 0; env_i < CONFIG::N_ENVIRONMENTS; env_i++){
+                    TI chunk = (num_transitions[env_i] + num_threads - 1) / num_threads;
+                    TI begin = std::min(thread_i * chunk, num_transitions[env_i]);
+                    TI end = std::min(begin + chunk, num_transitions[env_i]);
+                    internal::recalculate_rewards(ts.device, ts.off_policy_runner.replay_buffers[env_i], ts.off_policy_runner.envs[env_i], begin, end, rng);
+                }
+            };
+            std::vector<std::thread> workers;
+            for(TI thread_i = 1; thread_i < num_threads; thread_i++){
+                workers.emplace_back(work, thread_i);
+            }
+            work(0);
+            for(auto& worker: workers){
+                worker.join();
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            double duration = std::chrono::duration<double, std::milli>(end - start).count();
+            rlt::add_scalar(ts.device, ts.device.logger, "curriculum/recalculate_rewards_ms", duration);
+            rlt::add_scalar(ts.device, ts.device.logger, "curriculum/recalculate_rewards_threads", (double)num_threads);
+            std::cout << "recalculate_rewards: " << total << " transitions on " << num_threads << " threads in " << duration << "ms" << std::endl;
+        }
+        // RECALCULATE_REWARDS_THREADS workers, but at least RECALCULATE_REWARDS_MIN_CHUNK transitions per worker
+        template <typename CONFIG>
+        void recalculate_rewards(TrainingState<CONFIG>& ts){
+            using TI = typename CONFIG::TI;
+            TI total = 0;
+            for(TI env_i = 0; env_i < CONFIG::N_ENVIRONMENTS; env_i++){
+                const auto& replay_buffer = ts.off_policy_runner.replay_buffers[env_i];
+                total += replay_buffer.full ? CONFIG::REPLAY_BUFFER_CAP : replay_buffer.position;
+            }
+            TI num_threads = constants::RECALCULATE_REWARDS_THREADS > 0 ? constants::RECALCULATE_REWARDS_THREADS : std::max(std::thread::hardware_concurrency(), 1u);
+            recalculate_rewards(ts, std::max<TI>(std::min<TI>(num_threads, total / constants::RECALCULATE_REWARDS_MIN_CHUNK), 1));
+        }
+    }
+}
@@ -0,0 +1,107 @@
+#include <cstdint>
+
+namespace learning_to_fly{
+    namespace steps{
+        /**
+         * Lazy reward relabeling. Every replay buffer row carries the version of the reward parameters its reward was computed
+         * with. When the curriculum changes the weights, invalidate_rewards() only bumps the current version (O(1) instead of
+         * O(buffer), cf. recalculate_rewards.h) and gather_batch() recomputes and writes back the rewards of the stale rows it
+         * samples (O(batch)).
+         */
+        namespace reward_relabeling{
+            // the curriculum is the only place that changes the reward weights during training
+            template <typename CONFIG>
+            constexpr bool enabled(){
+                return CONFIG::ABLATION_SPEC::ENABLE_CURRICULUM && CONFIG::ABLATION_SPEC::RECALCULATE_REWARDS && CONFIG::LAZY_REWARD_RELABELING;
+            }
+            template <typename CONFIG>
+            void init(TrainingState<CONFIG>& ts){
+                if constexpr(enabled<CONFIG>()){
+                    for(typename CONFIG::TI env_i = 0; env_i < CONFIG::N_ENVIRONMENTS; env_i++){
+                        ts.reward_versions[env_i].assign(CONFIG::REPLAY_BUFFER_CAP, 0);
+                        ts.current_reward_version[env_i] = 0;
+                    }
+                    ts.relabeled_rewards = 0;
+                }
+            }
+            // labels the transitions the off-policy runner just added (one per environment) with the current version
+            template <typename CONFIG>
+            void tag_new_transitions(TrainingState<CONFIG>& ts){
+                using TI = typename CONFIG::TI;
+                if constexpr(enabled<CONFIG>()){
+                    for(TI env_i = 0; env_i < CONFIG::N_ENVIRONMENTS; env_i++){
+                        auto& replay_buffer = ts.off_policy_runner.replay_buffers[env_i];
+                        TI last_position = (replay_buffer.position + CONFIG::REPLAY_BUFFER_CAP - 1) % CONFIG::REPLAY_BUFFER_CAP;
+                        ts.reward_versions[env_i][last_position] = ts.current_reward_version[env_i];
+                    }
+                }
+            }
+            template <typename CONFIG>
+            void invalidate_rewards(TrainingState<CONFIG>& ts){
+                using TI = typename CONFIG::TI;
+                rlt::add_scalar(ts.device, ts.device.logger, "curriculum/relabeled_rewards", (double)ts.relabeled_rewards);
+                ts.relabeled_rewards = 0;
+                for(TI env_i = 0; env_i < CONFIG::N_ENVIRONMENTS; env_i++){
+                    ts.current_reward_version[env_i]++;
+                }
+            }
+            template <typename CONFIG>
+            void relabel(TrainingState<CONFIG>& ts, typename CONFIG::TI env_i, typename CONFIG::TI sample_i){
+                uint32_t& version = ts.reward_versions[env_i][sample_i];
+                if(version != ts.current_reward_version[env_i]){
+                    internal::recalculate_rewards(ts.device, ts.off_policy_runner.replay_buffers[env_i], ts.off_policy_runner.envs[env_i], sample_i, sample_i + 1, ts.rng_eval);
+                    version = ts.current_reward_version[env_i];
+                    ts.relabeled_rewards++;
+                }
+            }
+        }
+        /**
+         * Drop-in for rlt::gather_batch(ts.device, ts.off_policy_runner, batch, ts.rng). With lazy relabeling the rows are drawn
+         * here (same distribution as rl_tools: a uniform environment, then a uniform row of its replay buffer), so that stale
+         * rewards can be recomputed before they are copied into the batch.
+         */
+        template <typename CONFIG, typename BATCH>
+        void gather_batch(TrainingState<CONFIG>& ts, BATCH& batch){
+            using TI = typename CONFIG::TI;
+            if constexpr(reward_relabeling::enabled<CONFIG>()){
+                constexpr TI BATCH_SIZE = BATCH::SPEC::BATCH_SIZE;
+                for(TI batch_step_i = 0; batch_step_i < BATCH_SIZE; batch_step_i++){
+                    TI env_i = 0;
+                    if constexpr(CONFIG::N_ENVIRONMENTS > 1){
+                        env_i = rlt::random::uniform_int_distribution(ts.device.random, (TI)0, (TI)(CONFIG::N_ENVIRONMENTS - 1), ts.rng);
+                    }
+                    auto& replay_buffer = ts.off_policy_runner.replay_buffers[env_i];
+                    TI sample_index_max = replay_buffer.full ? CONFIG::REPLAY_BUFFER_CAP : replay_buffer.position;
+                    TI sample_i = rlt::random::uniform_int_distribution(ts.device.random, (TI)0, sample_index_max - 1, ts.rng);
+                    reward_relabeling::relabel(ts, env_i, sample_i);
+
+                    auto observation_target = rlt::row(ts.device, batch.observations, batch_step_i);
+                    auto observation_source = rlt::row(ts.device, replay_buffer.observations, sample_i);
+                    rlt::copy(ts.device, ts.device, observation_source, observation_target);
+                    if constexpr(CONFIG::ASYMMETRIC_OBSERVATIONS){
+                        auto observation_privileged_target = rlt::row(ts.device, batch.observations_privileged, batch_step_i);
+                        auto observation_privileged_source = rlt::row(ts.device, replay_buffer.observations_privileged, sample_i);
+                        rlt::copy(ts.device, ts.device, observation_privileged_source, observation_privileged_target);
+                    }
+                    auto action_target = rlt::row(ts.device, batch.actions, batch_step_i);
+                    auto action_source = rlt::row(ts.device, replay_buffer.actions, sample_i);
+                    rlt::copy(ts.device, ts.device, action_source, action_target);
+                    auto next_observation_target = rlt::row(ts.device, batch.next_observations, batch_step_i);
+                    auto next_observation_source = rlt::row(ts.device, replay_buffer.next_observations, sample_i);
+                    rlt::copy(ts.device, ts.device, next_observation_source, next_observation_target);
+                    if constexpr(CONFIG::ASYMMETRIC_OBSERVATIONS){
+                        auto next_observation_privileged_target = rlt::row(ts.device, batch.next_observations_privileged, batch_step_i);
+                        auto next_observation_privileged_source = rlt::row(ts.device, replay_buffer.next_observations_privileged, sample_i);
+                        rlt::copy(ts.device, ts.device, next_observation_privileged_source, next_observation_privileged_target);
+                    }
+                    rlt::set(batch.rewards, 0, batch_step_i, rlt::get(replay_buffer.rewards, sample_i, 0));
+                    rlt::set(batch.terminated, 0, batch_step_i, rlt::get(replay_buffer.terminated, sample_i, 0));
+                    rlt::set(batch.truncated, 0, batch_step_i, rlt::get(replay_buffer.truncated, sample_i, 0));
+                }
+            }
+            else{
+                rlt::gather_batch(ts.device, ts.off_policy_runner, batch, ts.rng);
+            }
+        }
+    }
+}
@@ -154,7 +154,7 @@ public:
         file << std::endl;
         
         file << "--- Replay Buffer & Exploration ---" << std::endl;
-        file << "Replay Buffer Capacity: " << CONFIG::REPLAY_BUFFER_CAP << " transitions" << std::endl;
+        file << "Replay Buffer Capacity: " << CONFIG::REPLAY_BUFFER_CAP << " transitions x " << CONFIG::N_ENVIRONMENTS << " environments" << std::endl;
         file << "Off-Policy Runner Exploration Noise (Initial): " << CONFIG::off_policy_runner_parameters.exploration_noise << std::endl;
         file << std::endl;
         
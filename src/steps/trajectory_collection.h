@@ -2,7 +2,6 @@ namespace learning_to_fly {
     namespace steps {
         template<typename CONFIG>
         void trajectory_collection(TrainingState <CONFIG> &ts) {
-            static_assert(CONFIG::N_ENVIRONMENTS == 1);
             using TI = typename CONFIG::TI;
             using T = typename CONFIG::T;
             
@@ -85,18 +84,20 @@ namespace learning_to_fly {
                 }
                 
                 typename CONFIG::ENVIRONMENT::State next_viz_state;
-                rlt::step(ts.device, viz_env, viz_state, act, next_viz_state, ts.rng_eval);
+                auto step_result = rlt::step_full(ts.device, viz_env, viz_state, act, next_viz_state, ts.rng_eval);
                 
                 rlt::free(ts.device, obs);
                 rlt::free(ts.device, act);
                 
-                bool term = rlt::terminated(ts.device, viz_env, next_viz_state, ts.rng_eval);
+                bool term = step_result.terminated;
                 viz_step_count++;
                 bool done = term || (viz_step_count >= CONFIG::ENVIRONMENT_STEP_LIMIT);
                 
                 viz_state = next_viz_state;
                 
                 if (done) {
+                    // read from the per-step collision cache, no additional obstacle query
+                    rlt::add_scalar(ts.device, ts.device.logger, "trajectory_collection/obstacle_collision", viz_state.obstacle_collision);
                     {
                         std::lock_guard<std::mutex> lock(ts.trajectories_mutex);
                         ts.trajectories.push(current_viz_trajectory);
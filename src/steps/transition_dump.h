@@ -0,0 +1,32 @@
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+
+namespace learning_to_fly {
+    namespace steps {
+        // writes the replay buffers next to the actor checkpoints, for the offline reward variant evaluation (cf. reward_variants.cpp)
+        template <typename CONFIG>
+        void transition_dump(TrainingState<CONFIG>& ts){
+            if constexpr(CONFIG::DUMP_TRANSITIONS){
+                if(ts.step % CONFIG::ACTOR_CHECKPOINT_INTERVAL == 0 || ts.finished){
+                    std::filesystem::path output_dir = std::filesystem::path("checkpoints/multirotor_td3") / ts.run_name;
+                    try {
+                        std::filesystem::create_directories(output_dir);
+                    }
+                    catch (std::exception& e) {
+                    }
+                    std::stringstream name_ss;
+                    name_ss << "transitions_" << std::setw(15) << std::setfill('0') << ts.step << ".bin";
+                    std::filesystem::path output_path = output_dir / name_ss.str();
+                    std::cout << "💾 Saving transitions: " << output_path << std::endl;
+                    try{
+                        transition_dump::save<CONFIG>(ts.device, ts.off_policy_runner, output_path.string());
+                    }
+                    catch(std::exception& e){
+                        std::cout << "Error while saving transitions: " << e.what() << std::endl;
+                    }
+                }
+            }
+        }
+    }
+}
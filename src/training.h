@@ -7,6 +7,8 @@ namespace rlt = RL_TOOLS_NAMESPACE_WRAPPER ::rl_tools;
 
 #include "config/config.h"
 #include "constants.h"
+#include "obstacle_scene.h"
+#include "transition_dump.h"
 
 #include <rl_tools/rl/algorithms/td3/loop.h>
 #include <cstdlib>
@@ -16,12 +18,17 @@ namespace rlt = RL_TOOLS_NAMESPACE_WRAPPER ::rl_tools;
 
 #include "steps/checkpoint.h"
 #include "steps/critic_reset.h"
+#include "steps/recalculate_rewards.h"
+#include "steps/reward_relabeling.h"
+#include "steps/async_collection.h"
 #include "steps/curriculum.h"
 #include "steps/log_reward.h"
 #include "steps/logger.h"
 #include "steps/validation.h"
+#include "steps/evaluation.h"
 #include "steps/training_summary.h"
 #include "steps/training_summary.h"
+#include "steps/transition_dump.h"
 #include "steps/policy_switch.h"
 #include "policy_switching.h"
 #include "off_policy_runner_with_policy_switching.h"
@@ -43,6 +50,17 @@ namespace learning_to_fly{
         using ABLATION_SPEC = typename CONFIG::ABLATION_SPEC;
         auto env_parameters = parameters::environment<T, TI, ABLATION_SPEC>::parameters;
         auto env_parameters_eval = parameters::environment<T, TI, config::template ABLATION_SPEC_EVAL<ABLATION_SPEC>>::parameters;
+        ts.obstacle_scene = obstacle_scene::shared().scene();
+        rlt::bake(ts.device, ts.obstacle_field, ts.obstacle_scene, (T)constants::OBSTACLE_FIELD_SPACING, (T)constants::OBSTACLE_FIELD_MARGIN);
+        rlt::rl::environments::multirotor::parameters::reward_functions::set_obstacles(env_parameters.mdp.reward, &ts.obstacle_scene, &ts.obstacle_field);
+        rlt::rl::environments::multirotor::parameters::reward_functions::set_obstacles(env_parameters_eval.mdp.reward, &ts.obstacle_scene, &ts.obstacle_field);
+        if (obstacle_scene::shared().has_generator) {
+            rlt::rl::environments::multirotor::parameters::reward_functions::set_course_generator(env_parameters.mdp.reward, &obstacle_scene::shared().generator);
+            rlt::rl::environments::multirotor::parameters::reward_functions::set_course_generator(env_parameters_eval.mdp.reward, &obstacle_scene::shared().generator);
+        }
+        // the parameter sets do not contain the derived wrench mixing, environments whose state is not reset by (sample_)initial_state (e.g. the scenario bank) rely on it
+        rlt::rl::environments::multirotor::update_wrench_mixing(ts.device, env_parameters.dynamics);
+        rlt::rl::environments::multirotor::update_wrench_mixing(ts.device, env_parameters_eval.dynamics);
         for (auto& env : ts.envs) {
             env.parameters = env_parameters;
         }
@@ -61,12 +79,17 @@ namespace learning_to_fly{
         rlt::add_scalar(ts.device, ts.device.logger, "loop/seed", effective_seed);
         rlt::rl::algorithms::td3::loop::init(ts, effective_seed);
         ts.off_policy_runner.parameters = CONFIG::off_policy_runner_parameters;
+        steps::reward_relabeling::init(ts);
+        for(auto& env : ts.off_policy_runner.envs){
+            rlt::rl::environments::multirotor::parameters::reward_functions::set_reward_capture(env.parameters.mdp.reward, &ts.reward_capture);
+        }
 
         for(typename CONFIG::ENVIRONMENT& env: ts.validation_envs){
-            env.parameters = parameters::environment<typename CONFIG::T, TI, ABLATION_SPEC>::parameters;
+            env.parameters = env_parameters;
         }
         rlt::malloc(ts.device, ts.validation_actor_buffers);
         rlt::init(ts.device, ts.task, ts.validation_envs, ts.rng_eval);
+        steps::init_evaluation(ts);
 
         // Initialize policy switching if enabled
         if constexpr (CONFIG::ENABLE_POLICY_SWITCHING) {
@@ -128,39 +151,33 @@ namespace learning_to_fly{
         rlt::set_step(ts.device, ts.device.logger, ts.step);
         
         // Evaluation
-        if constexpr(SPEC::DETERMINISTIC_EVALUATION == true){
-            if(ts.step % SPEC::EVALUATION_INTERVAL == 0){
-                auto result = rlt::evaluate(ts.device, ts.env_eval, ts.ui, ts.actor_critic.actor_target, 
-                    rlt::rl::utils::evaluation::Specification<SPEC::NUM_EVALUATION_EPISODES, SPEC::ENVIRONMENT_STEP_LIMIT_EVALUATION>(), 
-                    ts.observations_mean, ts.observations_std, ts.actor_deterministic_evaluation_buffers, ts.rng_eval, false);
-                rlt::logging::text(ts.device, ts.device.logger, "Step: ", ts.step, " (mean return: ", result.returns_mean, ", mean episode length: ", result.episode_length_mean, ")");
-                TI current_evaluation_i = ts.step / SPEC::EVALUATION_INTERVAL;
-                assert(current_evaluation_i < TrainingState<CONFIG>::N_EVALUATIONS);
-                ts.evaluation_results[current_evaluation_i] = result;
-                rlt::add_scalar(ts.device, ts.device.logger, "evaluation/returns_mean", result.returns_mean);
-                rlt::add_scalar(ts.device, ts.device.logger, "evaluation/returns_std", result.returns_std);
-                rlt::add_scalar(ts.device, ts.device.logger, "evaluation/episode_length_mean", result.episode_length_mean);
-                rlt::add_scalar(ts.device, ts.device.logger, "evaluation/episode_length_std", result.episode_length_std);
-            }
-        }
+        steps::evaluation(ts);
         
         // Data collection with policy switching
-        if (ts.use_policy_switching && ts.hover_actor_loaded) {
-            off_policy_runner::step_with_policy_switching(
-                ts.device, ts.off_policy_runner, 
-                ts.actor_critic.actor, ts.hover_actor,
-                ts.actor_buffers_eval, ts.hover_actor_buffer,
-                ts.rng, true, ts.policy_switch_threshold
-            );
-        } else {
-            rlt::step(ts.device, ts.off_policy_runner, ts.actor_critic.actor, ts.actor_buffers_eval, ts.rng);
+        if constexpr(CONFIG::ASYNC_COLLECTION){
+            steps::async_collection::collect(ts);
+        }
+        else{
+            if (ts.use_policy_switching && ts.hover_actor_loaded) {
+                off_policy_runner::step_with_policy_switching(
+                    ts.device, ts.off_policy_runner, 
+                    ts.actor_critic.actor, ts.hover_actor,
+                    ts.actor_buffers_eval, ts.hover_actor_buffer,
+                    ts.rng, true, ts.policy_switch_threshold, ts.env_using_hover
+                );
+            } else {
+                rlt::step(ts.device, ts.off_policy_runner, ts.actor_critic.actor, ts.actor_buffers_eval, ts.rng);
+            }
+            steps::reward_relabeling::tag_new_transitions(ts);
         }
+        steps::log_reward(ts);
         
         // Critic training
         if(ts.step > SPEC::N_WARMUP_STEPS_CRITIC && ts.step % SPEC::TD3_PARAMETERS::CRITIC_TRAINING_INTERVAL == 0){
             for(TI critic_i = 0; critic_i < 2; critic_i++){
-                rlt::target_action_noise(ts.device, ts.actor_critic, ts.critic_training_buffers.target_next_action_noise, ts.rng);
-                rlt::gather_batch(ts.device, ts.off_policy_runner, ts.critic_batch, ts.rng);
+                // same distribution as rlt::target_action_noise (clipped Gaussian) but drawn as one block
+                rlt::random::block::normal(ts.device, ts.critic_training_buffers.target_next_action_noise, ts.actor_critic.target_next_action_noise_std, ts.actor_critic.target_next_action_noise_clip, ts.rng);
+                steps::gather_batch(ts, ts.critic_batch);
                 rlt::train_critic(ts.device, ts.actor_critic, critic_i == 0 ? ts.actor_critic.critic_1 : ts.actor_critic.critic_2, 
                     ts.critic_batch, ts.critic_optimizers[critic_i], ts.actor_buffers[critic_i], ts.critic_buffers[critic_i], ts.critic_training_buffers);
             }
@@ -170,7 +187,7 @@ namespace learning_to_fly{
 
         // Actor training
         if(ts.step > SPEC::N_WARMUP_STEPS_ACTOR && ts.step % SPEC::TD3_PARAMETERS::ACTOR_TRAINING_INTERVAL == 0){
-            rlt::gather_batch(ts.device, ts.off_policy_runner, ts.actor_batch, ts.rng);
+            steps::gather_batch(ts, ts.actor_batch);
             rlt::train_actor(ts.device, ts.actor_critic, ts.actor_batch, ts.actor_optimizer, ts.actor_buffers[0], ts.critic_buffers[0], ts.actor_training_buffers);
 
             T actor_value = rlt::mean(ts.device, ts.actor_training_buffers.state_action_value);
@@ -184,6 +201,9 @@ namespace learning_to_fly{
         if(ts.step > SPEC::N_WARMUP_STEPS_ACTOR && ts.step % SPEC::TD3_PARAMETERS::ACTOR_TARGET_UPDATE_INTERVAL == 0) {
             rlt::update_actor_target(ts.device, ts.actor_critic);
         }
+        if constexpr(CONFIG::ASYNC_COLLECTION){
+            steps::async_collection::update(ts);
+        }
 
         ts.step++;
         ts.finished = (ts.step >= SPEC::STEP_LIMIT);
@@ -193,26 +213,19 @@ namespace learning_to_fly{
         
         steps::trajectory_collection(ts);
         steps::checkpoint(ts);
+        steps::transition_dump(ts);
         
-        // Print evaluation results
-        if constexpr (CONFIG::DETERMINISTIC_EVALUATION) {
-            if(ts.step > 0 && ts.step % CONFIG::EVALUATION_INTERVAL == 0){
-                TI evaluation_index = ts.step / CONFIG::EVALUATION_INTERVAL;
-                if(evaluation_index > 0 && evaluation_index <= (CONFIG::STEP_LIMIT / CONFIG::EVALUATION_INTERVAL)){
-                    auto& result = ts.evaluation_results[evaluation_index - 1];
-                    std::cout << "📊 Evaluation at step " << ts.step << ":" << std::endl;
-                    std::cout << "   Mean return: " << result.returns_mean 
-                              << " (std: " << result.returns_std << ")" << std::endl;
-                    std::cout << "   Mean episode length: " << result.episode_length_mean 
-                              << " (std: " << result.episode_length_std << ")" << std::endl;
-                }
-            }
+        if(ts.finished){
+            steps::finish_evaluation(ts);
         }
     }
     template <typename CONFIG>
     void destroy(TrainingState<CONFIG>& ts){
+        steps::finish_evaluation(ts);
+        steps::async_collection::stop(ts);
         rlt::rl::algorithms::td3::loop::destroy(ts);
         rlt::destroy(ts.device, ts.task);
         rlt::free(ts.device, ts.validation_actor_buffers);
+        rlt::free(ts.device, ts.obstacle_field);
     }
 }
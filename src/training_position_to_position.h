@@ -14,6 +14,8 @@ namespace rlt = RL_TOOLS_NAMESPACE_WRAPPER ::rl_tools;
 
 #include "steps/checkpoint.h"
 #include "steps/critic_reset.h"
+#include "steps/recalculate_rewards.h"
+#include "steps/reward_relabeling.h"
 #include "steps/curriculum.h"
 #include "steps/log_reward.h"
 #include "steps/logger.h"
@@ -1,6 +1,16 @@
 #include <queue>
 #include <vector>
 #include <mutex>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <utility>
+#include <memory>
+
+#include "async_collection.h"
+#include "background_evaluation.h"
+#include "batched_evaluation.h"
+#include "scenario_bank.h"
 
 namespace learning_to_fly{
     template <typename T_CONFIG>
@@ -28,5 +38,38 @@ namespace learning_to_fly{
         
         // Track per-trajectory whether hover actor has been activated (sticky switching)
         bool current_trajectory_using_hover = false;
+        // Same for each of the environments of the off-policy runner (reset when the runner starts a new episode)
+        bool env_using_hover[CONFIG::N_ENVIRONMENTS] = {};
+        
+        // obstacle course (view of obstacle_scene::shared()) and its signed-distance grid, shared read-only by all environments
+        rlt::rl::environments::multirotor::obstacles::Scene obstacle_scene;
+        rlt::rl::environments::multirotor::obstacles::Field<T> obstacle_field;
+
+        // lazy reward relabeling (cf. steps/reward_relabeling.h): reward parameter version each replay buffer row was labeled
+        // with and the current version of each environment's reward parameters
+        std::vector<uint32_t> reward_versions[CONFIG::N_ENVIRONMENTS];
+        uint32_t current_reward_version[CONFIG::N_ENVIRONMENTS] = {};
+        TI relabeled_rewards = 0;
+
+        // reward components of the collected transitions, written by the reward function of the off-policy runner's environments
+        // and reduced by steps::log_reward (reward_capture_read: next row to reduce)
+        rlt::rl::environments::multirotor::parameters::reward_functions::Capture<T> reward_capture;
+        size_t reward_capture_read = 0;
+
+        // asynchronous data collection (CONFIG::ASYNC_COLLECTION, cf. steps/async_collection.h), started at the first step
+        std::unique_ptr<async_collection::Pipeline<CONFIG>> async_pipeline;
+        bool async_publish_pending = false;
+
+        // deterministic evaluation (cf. steps/evaluation.h): number of evaluation_results that are available (in order), the
+        // background jobs that are not delivered yet and the best return for steps::save_best_actor
+        using EVALUATION_RESULT = std::remove_reference_t<decltype(std::declval<rlt::rl::algorithms::td3::loop::TrainingState<T_CONFIG>&>().evaluation_results[0])>;
+        using EVALUATION_JOB = background_evaluation::Job<CONFIG, EVALUATION_RESULT>;
+        TI evaluations_delivered = 0;
+        std::deque<std::unique_ptr<EVALUATION_JOB>> evaluation_jobs;
+        std::unique_ptr<background_evaluation::WorkerPool> evaluation_pool;
+        T best_evaluation_return = -std::numeric_limits<T>::infinity();
+        bool has_best_checkpoint = false;
+        // common random numbers of the evaluation (CONFIG::SCENARIO_BANK, nullptr: fresh draws)
+        std::unique_ptr<scenario_bank::Bank<typename CONFIG::ENVIRONMENT_EVALUATION>> evaluation_scenarios;
     };
 }
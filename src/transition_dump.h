@@ -0,0 +1,109 @@
+#ifndef LEARNING_TO_FLY_TRANSITION_DUMP_H
+#define LEARNING_TO_FLY_TRANSITION_DUMP_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace learning_to_fly {
+namespace transition_dump {
+    /**
+     * Binary dump of the (state, action, next_state) triples of the off-policy runner's replay buffers, used to evaluate reward
+     * variants offline (cf. reward_variants.cpp). Layout: 8 byte magic, uint32 record size, uint32 action dim, uint64 number
+     * of records, followed by the raw records (native byte order and padding). The record size guards against dumps of a
+     * different State layout (e.g. another ablation spec or a changed simulator).
+     * The replay buffers are written one after another, each from its oldest to its newest transition.
+     */
+    constexpr char MAGIC[8] = {'L', '2', 'F', 'T', 'R', 'N', '0', '1'};
+
+    template <typename ENVIRONMENT>
+    struct Record {
+        using T = typename ENVIRONMENT::T;
+        typename ENVIRONMENT::State state;
+        T action[ENVIRONMENT::ACTION_DIM];
+        typename ENVIRONMENT::State next_state;
+        uint8_t terminated;
+        uint8_t truncated;
+        // first record of a replay buffer (the episode it belongs to may have started before the oldest stored transition)
+        uint8_t first;
+    };
+
+    struct Header {
+        char magic[sizeof(MAGIC)];
+        uint32_t record_size;
+        uint32_t action_dim;
+        uint64_t num_records;
+    };
+
+    template <typename CONFIG, typename DEVICE, typename OFF_POLICY_RUNNER>
+    void save(DEVICE& device, const OFF_POLICY_RUNNER& runner, const std::string& path) {
+        using TI = typename CONFIG::TI;
+        using ENVIRONMENT = typename CONFIG::ENVIRONMENT;
+        using RECORD = Record<ENVIRONMENT>;
+        static_assert(std::is_trivially_copyable_v<typename ENVIRONMENT::State>);
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Could not open transition dump for writing: " + path);
+        }
+        Header header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.record_size = sizeof(RECORD);
+        header.action_dim = ENVIRONMENT::ACTION_DIM;
+        for (TI env_i = 0; env_i < CONFIG::N_ENVIRONMENTS; env_i++) {
+            const auto& replay_buffer = runner.replay_buffers[env_i];
+            header.num_records += replay_buffer.full ? CONFIG::REPLAY_BUFFER_CAP : replay_buffer.position;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (TI env_i = 0; env_i < CONFIG::N_ENVIRONMENTS; env_i++) {
+            const auto& replay_buffer = runner.replay_buffers[env_i];
+            TI num_transitions = replay_buffer.full ? CONFIG::REPLAY_BUFFER_CAP : replay_buffer.position;
+            TI oldest = replay_buffer.full ? replay_buffer.position : 0;
+            for (TI transition_i = 0; transition_i < num_transitions; transition_i++) {
+                TI row_i = (oldest + transition_i) % CONFIG::REPLAY_BUFFER_CAP;
+                RECORD record{};
+                record.state = rlt::get(replay_buffer.states, row_i, 0);
+                for (TI action_i = 0; action_i < ENVIRONMENT::ACTION_DIM; action_i++) {
+                    record.action[action_i] = rlt::get(replay_buffer.actions, row_i, action_i);
+                }
+                record.next_state = rlt::get(replay_buffer.next_states, row_i, 0);
+                record.terminated = rlt::get(replay_buffer.terminated, row_i, 0);
+                record.truncated = rlt::get(replay_buffer.truncated, row_i, 0);
+                record.first = transition_i == 0;
+                file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+            }
+        }
+        if (!file) {
+            throw std::runtime_error("Error while writing transition dump: " + path);
+        }
+    }
+
+    template <typename ENVIRONMENT>
+    std::vector<Record<ENVIRONMENT>> load(const std::string& path) {
+        using RECORD = Record<ENVIRONMENT>;
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Could not open transition dump: " + path);
+        }
+        Header header;
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!file || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+            throw std::runtime_error("Not a transition dump: " + path);
+        }
+        if (header.record_size != sizeof(RECORD) || header.action_dim != ENVIRONMENT::ACTION_DIM) {
+            throw std::runtime_error("Transition dump " + path + " was written for a different environment (record size " + std::to_string(header.record_size) + ", expected " + std::to_string(sizeof(RECORD)) + ")");
+        }
+        std::vector<RECORD> records(header.num_records);
+        file.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(RECORD));
+        if (!file) {
+            throw std::runtime_error("Truncated transition dump: " + path);
+        }
+        return records;
+    }
+}
+}
+
+#endif
@@ -28,7 +28,9 @@ namespace rlt = rl_tools;
 //#include "../td3/parameters.h"
 #include "../training.h"
 #include "../constants.h"
+#include "../obstacle_scene.h"
 #include "../policy_switching.h"
+#include "../scenario_bank.h"
 
 // Include checkpoint file if path is specified at compile time
 #ifdef ACTOR_CHECKPOINT_FILE
@@ -101,6 +103,7 @@ class websocket_session : public std::enable_shared_from_this<websocket_session>
     using T = CONFIG::T;
     using ENVIRONMENT = typename parameters::environment<CONFIG::T, TI, CONFIG::ABLATION_SPEC>::ENVIRONMENT;
     ENVIRONMENT env;
+    rlt::rl::environments::multirotor::obstacles::Scene obstacle_scene;
     rlt::devices::DefaultCPU device;
     rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, ENVIRONMENT::ACTION_DIM>> action;
     
@@ -126,10 +129,19 @@ class websocket_session : public std::enable_shared_from_this<websocket_session>
     bool use_policy_switching = false;  // Enable/disable policy switching
     T switch_distance_threshold = T(0.3);  // Distance threshold for switching to hover policy
     bool policy_switched_to_hover = false;  // For actor evaluation: sticky switch flag per episode
+    // Evaluation scenarios shared with the training's evaluation (cf. scenario_bank.h), nullptr: random spawns
+    std::unique_ptr<learning_to_fly::scenario_bank::Bank<ENVIRONMENT>> evaluation_scenarios;
 
 public:
     explicit websocket_session(tcp::socket socket) : ws_(std::move(socket)), timer_(ws_.get_executor()) {
         env.parameters = parameters::environment<T, TI, CONFIG::ABLATION_SPEC>::parameters;
+        rlt::rl::environments::multirotor::update_wrench_mixing(device, env.parameters.dynamics);
+        obstacle_scene = learning_to_fly::obstacle_scene::shared().scene();
+        rlt::rl::environments::multirotor::parameters::reward_functions::set_obstacles(env.parameters.mdp.reward, &obstacle_scene, (const rlt::rl::environments::multirotor::obstacles::Field<T>*)nullptr);
+        if (learning_to_fly::obstacle_scene::shared().has_generator) {
+            // same per-episode courses as the training (cf. training.h), also required to replay the courses of the scenario bank
+            rlt::rl::environments::multirotor::parameters::reward_functions::set_course_generator(env.parameters.mdp.reward, &learning_to_fly::obstacle_scene::shared().generator);
+        }
         rlt::malloc(device, action);
         rlt::malloc(device, evaluation_actor);
         rlt::malloc(device, hover_actor);
@@ -237,6 +249,18 @@ private:
             use_policy_switching = false;
         }
 
+        // Replay the training's evaluation scenarios if the bank exists and matches the UI's environment
+        evaluation_scenarios.reset();
+        std::string scenario_bank_path = learning_to_fly::scenario_bank::path();
+        if (std::filesystem::exists(scenario_bank_path)) {
+            try {
+                evaluation_scenarios = std::make_unique<learning_to_fly::scenario_bank::Bank<ENVIRONMENT>>(scenario_bank_path);
+                std::cout << "Replaying " << evaluation_scenarios->size() << " evaluation scenarios from " << scenario_bank_path << std::endl;
+            } catch (const std::exception& e) {
+                std::cout << "Not using the evaluation scenario bank: " << e.what() << std::endl;
+            }
+        }
+
         stop_evaluation = false;
         is_evaluating = true;
         
@@ -274,44 +298,50 @@ private:
             // Reset policy switch state for new episode
             policy_switched_to_hover = false;
             
-            // Create environment state with randomized initial position, velocity, and orientation
             typename ENVIRONMENT::State state;
-            rlt::sample_initial_state(device, env, state, rng);
-            
-            // Override initial velocities to zero for evaluation (stationary spawn)
-            for(TI i = 0; i < 3; i++) {
-                state.linear_velocity[i] = 0;
-                state.angular_velocity[i] = 0;
+            if (evaluation_scenarios) {
+                // Same initial state, disturbances, course and noise as episode episode_count of the training's evaluation
+                learning_to_fly::scenario_bank::apply(device, env, (*evaluation_scenarios)[episode_count], state, rng);
+            } else {
+                // Create environment state with randomized initial position, velocity, and orientation
+                rlt::sample_initial_state(device, env, state, rng);
+
+                // Override initial velocities to zero for evaluation (stationary spawn)
+                for(TI i = 0; i < 3; i++) {
+                    state.linear_velocity[i] = 0;
+                    state.angular_velocity[i] = 0;
+                }
+
+                // Limit initial orientation to small angles for evaluation (within ±10 degrees)
+                // Convert quaternion to euler angles, clamp, and convert back
+                T max_angle = 10.0 * 3.14159 / 180.0; // 10 degrees in radians
+
+                // Extract euler angles from quaternion (simplified - assumes small angles)
+                T roll = 2.0 * (state.orientation[0] * state.orientation[1] + state.orientation[2] * state.orientation[3]);
+                T pitch = 2.0 * (state.orientation[0] * state.orientation[2] - state.orientation[3] * state.orientation[1]);
+                T yaw = 2.0 * (state.orientation[0] * state.orientation[3] + state.orientation[1] * state.orientation[2]);
+
+                // Clamp angles
+                roll = rlt::math::clamp(device.math, roll, -max_angle, max_angle);
+                pitch = rlt::math::clamp(device.math, pitch, -max_angle, max_angle);
+                yaw = rlt::math::clamp(device.math, yaw, -max_angle, max_angle);
+
+                // Convert back to quaternion (small angle approximation)
+                T half_roll = roll / 2.0;
+                T half_pitch = pitch / 2.0;
+                T half_yaw = yaw / 2.0;
+
+                state.orientation[0] = rlt::math::cos(device.math, half_roll) * rlt::math::cos(device.math, half_pitch) * rlt::math::cos(device.math, half_yaw) + 
+                                       rlt::math::sin(device.math, half_roll) * rlt::math::sin(device.math, half_pitch) * rlt::math::sin(device.math, half_yaw);
+                state.orientation[1] = rlt::math::sin(device.math, half_roll) * rlt::math::cos(device.math, half_pitch) * rlt::math::cos(device.math, half_yaw) - 
+                                       rlt::math::cos(device.math, half_roll) * rlt::math::sin(device.math, half_pitch) * rlt::math::sin(device.math, half_yaw);
+                state.orientation[2] = rlt::math::cos(device.math, half_roll) * rlt::math::sin(device.math, half_pitch) * rlt::math::cos(device.math, half_yaw) + 
+                                       rlt::math::sin(device.math, half_roll) * rlt::math::cos(device.math, half_pitch) * rlt::math::sin(device.math, half_yaw);
+                state.orientation[3] = rlt::math::cos(device.math, half_roll) * rlt::math::cos(device.math, half_pitch) * rlt::math::sin(device.math, half_yaw) - 
+                                       rlt::math::sin(device.math, half_roll) * rlt::math::sin(device.math, half_pitch) * rlt::math::cos(device.math, half_yaw);
+                rlt::rl::environments::multirotor::update_derived_quantities(device, state);
             }
             
-            // Limit initial orientation to small angles for evaluation (within ±10 degrees)
-            // Convert quaternion to euler angles, clamp, and convert back
-            T max_angle = 10.0 * 3.14159 / 180.0; // 10 degrees in radians
-            
-            // Extract euler angles from quaternion (simplified - assumes small angles)
-            T roll = 2.0 * (state.orientation[0] * state.orientation[1] + state.orientation[2] * state.orientation[3]);
-            T pitch = 2.0 * (state.orientation[0] * state.orientation[2] - state.orientation[3] * state.orientation[1]);
-            T yaw = 2.0 * (state.orientation[0] * state.orientation[3] + state.orientation[1] * state.orientation[2]);
-            
-            // Clamp angles
-            roll = rlt::math::clamp(device.math, roll, -max_angle, max_angle);
-            pitch = rlt::math::clamp(device.math, pitch, -max_angle, max_angle);
-            yaw = rlt::math::clamp(device.math, yaw, -max_angle, max_angle);
-            
-            // Convert back to quaternion (small angle approximation)
-            T half_roll = roll / 2.0;
-            T half_pitch = pitch / 2.0;
-            T half_yaw = yaw / 2.0;
-            
-            state.orientation[0] = rlt::math::cos(device.math, half_roll) * rlt::math::cos(device.math, half_pitch) * rlt::math::cos(device.math, half_yaw) + 
-                                   rlt::math::sin(device.math, half_roll) * rlt::math::sin(device.math, half_pitch) * rlt::math::sin(device.math, half_yaw);
-            state.orientation[1] = rlt::math::sin(device.math, half_roll) * rlt::math::cos(device.math, half_pitch) * rlt::math::cos(device.math, half_yaw) - 
-                                   rlt::math::cos(device.math, half_roll) * rlt::math::sin(device.math, half_pitch) * rlt::math::sin(device.math, half_yaw);
-            state.orientation[2] = rlt::math::cos(device.math, half_roll) * rlt::math::sin(device.math, half_pitch) * rlt::math::cos(device.math, half_yaw) + 
-                                   rlt::math::sin(device.math, half_roll) * rlt::math::cos(device.math, half_pitch) * rlt::math::sin(device.math, half_yaw);
-            state.orientation[3] = rlt::math::cos(device.math, half_roll) * rlt::math::cos(device.math, half_pitch) * rlt::math::sin(device.math, half_yaw) - 
-                                   rlt::math::sin(device.math, half_roll) * rlt::math::sin(device.math, half_pitch) * rlt::math::cos(device.math, half_yaw);
-            
             // Create drone for visualization
             TI drone_id = drone_id_counter++;
             using UI = rlt::rl::environments::multirotor::UI<decltype(env)>;
@@ -325,7 +355,10 @@ private:
             ws_.write(net::buffer(rlt::rl::environments::multirotor::model_message(device, env, ui).dump()));
             
             // Run episode
-            for (TI step = 0; step < max_episode_steps && !stop_evaluation; step++) {
+            T episode_return = 0;
+            TI episode_length = 0;
+            bool episode_terminated = false;
+            for (TI step = 0; step < max_episode_steps && !stop_evaluation && !episode_terminated; step++) {
                 // Get observation
                 rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, ENVIRONMENT::OBSERVATION_DIM>> observation;
                 rlt::malloc(device, observation);
@@ -370,10 +403,13 @@ private:
                     rlt::evaluate(device, evaluation_actor, observation, action, actor_buffer);
                 }
                 
-                // Step environment
+                // Step environment (reward and termination are evaluated in the same pass)
                 typename ENVIRONMENT::State next_state;
-                rlt::step(device, env, state, action, next_state, rng);
+                auto step_result = rlt::step_full(device, env, state, action, next_state, rng);
                 state = next_state;
+                episode_return += step_result.reward;
+                episode_length++;
+                episode_terminated = step_result.terminated;
                 
                 // Send state to frontend with actor switching info (use the permanent switch flag)
                 ws_.write(net::buffer(rlt::rl::environments::multirotor::state_message(device, ui, state, policy_switched_to_hover).dump()));
@@ -384,6 +420,8 @@ private:
                 std::this_thread::sleep_for(std::chrono::milliseconds(10));
             }
             
+            std::cout << "Episode " << episode_count << ": return " << episode_return << " after " << episode_length << " steps" << (episode_terminated ? (state.obstacle_collision ? " (collided with obstacle " + std::to_string(state.obstacle_id) + ")" : std::string(" (terminated)")) : std::string()) << std::endl;
+            
             // Remove drone
             using UI = rlt::rl::environments::multirotor::UI<decltype(env)>;
             UI remove_ui;
@@ -852,63 +890,19 @@ private:
         }
         else if(request_.target() == "/config"){
             response_.set(http::field::content_type, "application/json");
-            beast::ostream(response_.body())
-                    << "{\n"
-                    << "  \"targetPosition\": {\n"
-                    << "    \"x\": " << learning_to_fly::constants::TARGET_POSITION_X<float> << ",\n"
-                    << "    \"y\": " << learning_to_fly::constants::TARGET_POSITION_Y<float> << ",\n"
-                    << "    \"z\": " << learning_to_fly::constants::TARGET_POSITION_Z<float> << "\n"
-                    << "  },\n"
-                    << "  \"obstacles\": [\n";
-            
-            // Add all cylindrical obstacles
-            for(size_t i = 0; i < learning_to_fly::constants::NUM_OBSTACLES; i++) {
-                const auto& obs = learning_to_fly::constants::OBSTACLES[i];
-                beast::ostream(response_.body())
-                        << "    {\n"
-                        << "      \"type\": \"cylinder\",\n"
-                        << "      \"x\": " << obs.x << ",\n"
-                        << "      \"y\": " << obs.y << ",\n"
-                        << "      \"radius\": " << obs.radius << ",\n"
-                        << "      \"zMin\": " << obs.z_min << ",\n"
-                        << "      \"zMax\": " << obs.z_max << "\n"
-                        << "    }";
-                if(i < learning_to_fly::constants::NUM_OBSTACLES - 1 || 
-                   learning_to_fly::constants::NUM_PLANAR_OBSTACLES > 0) {
-                    beast::ostream(response_.body()) << ",";
-                }
-                beast::ostream(response_.body()) << "\n";
+            nlohmann::json config;
+            config["targetPosition"] = {
+                {"x", learning_to_fly::constants::TARGET_POSITION_X<float>},
+                {"y", learning_to_fly::constants::TARGET_POSITION_Y<float>},
+                {"z", learning_to_fly::constants::TARGET_POSITION_Z<float>}
+            };
+            // the same (runtime loaded) scene the environments use
+            config["obstacles"] = learning_to_fly::obstacle_scene::to_json(learning_to_fly::obstacle_scene::shared());
+            if(learning_to_fly::obstacle_scene::shared().has_generator){
+                // courses are drawn per episode, the fixed obstacles above are not used
+                config["generator"] = learning_to_fly::obstacle_scene::generator_to_json(learning_to_fly::obstacle_scene::shared().generator);
             }
-            
-            // Add all planar obstacles
-            for(size_t i = 0; i < learning_to_fly::constants::NUM_PLANAR_OBSTACLES; i++) {
-                const auto& plane = learning_to_fly::constants::PLANAR_OBSTACLES[i];
-                beast::ostream(response_.body())
-                        << "    {\n"
-                        << "      \"type\": \"plane\",\n"
-                        << "      \"pointX\": " << plane.point_x << ",\n"
-                        << "      \"pointY\": " << plane.point_y << ",\n"
-                        << "      \"pointZ\": " << plane.point_z << ",\n"
-                        << "      \"normalX\": " << plane.normal_x << ",\n"
-                        << "      \"normalY\": " << plane.normal_y << ",\n"
-                        << "      \"normalZ\": " << plane.normal_z << ",\n"
-                        << "      \"thickness\": " << plane.thickness << ",\n"
-                        << "      \"xMin\": " << plane.x_min << ",\n"
-                        << "      \"xMax\": " << plane.x_max << ",\n"
-                        << "      \"yMin\": " << plane.y_min << ",\n"
-                        << "      \"yMax\": " << plane.y_max << ",\n"
-                        << "      \"zMin\": " << plane.z_min << ",\n"
-                        << "      \"zMax\": " << plane.z_max << "\n"
-                        << "    }";
-                if(i < learning_to_fly::constants::NUM_PLANAR_OBSTACLES - 1) {
-                    beast::ostream(response_.body()) << ",";
-                }
-                beast::ostream(response_.body()) << "\n";
-            }
-            
-            beast::ostream(response_.body())
-                    << "  ]\n"
-                    << "}\n";
+            beast::ostream(response_.body()) << config.dump(2) << "\n";
         }
         else if(request_.target() == "/actors"){
             response_.result(http::status::ok);
@@ -24,7 +24,10 @@ namespace bpt = RL_TOOLS_NAMESPACE_WRAPPER ::rl_tools;
 
 #include <gtest/gtest.h>
 #include <random>
+#include <vector>
+#include <algorithm>
 #include <stdint.h>
+#include <cstring>
 TEST(RL_TOOLS_RL_ENVIRONMENTS_MULTIROTOR, MULTIROTOR) {
     using DEVICE = bpt::devices::DefaultCPU;
     using TI = typename DEVICE::index_t;
@@ -141,3 +144,824 @@ TEST(RL_TOOLS_RL_ENVIRONMENTS_MULTIROTOR, MULTIROTOR) {
     }
 
 }
+
+TEST(RL_TOOLS_RL_ENVIRONMENTS_MULTIROTOR, BLOCK_NORMAL) {
+    using DEVICE = bpt::devices::DefaultCPU;
+    using T = double;
+    using TI = typename DEVICE::index_t;
+    DEVICE device;
+    auto rng = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 1);
+    constexpr TI N = 100003;
+    std::vector<T> samples(N), pieces(N);
+    auto key = bpt::random::block::key(device, rng);
+    bpt::random::block::normal(device, key, samples.data(), N);
+    // filling the block piecewise (with offsets that are not aligned to the Philox output) reproduces the same samples
+    for(TI offset = 0; offset < N; offset += 7){
+        TI length = offset + 7 < N ? 7 : N - offset;
+        bpt::random::block::normal(device, key, pieces.data() + offset, length, offset);
+    }
+    T mean = 0, second_moment = 0, fourth_moment = 0;
+    for(TI i = 0; i < N; i++){
+        ASSERT_EQ(samples[i], pieces[i]);
+        mean += samples[i];
+        second_moment += samples[i] * samples[i];
+        fourth_moment += samples[i] * samples[i] * samples[i] * samples[i];
+    }
+    mean /= N;
+    second_moment /= N;
+    fourth_moment /= N;
+    ASSERT_NEAR(mean, 0, 0.02);
+    ASSERT_NEAR(second_moment, 1, 0.02);
+    ASSERT_NEAR(fourth_moment, 3, 0.1);
+}
+
+namespace multirotor_test{
+    // shared fixture of the tests below: rotor speeds and random disturbances without action history, the physics options are the template parameters
+    using DEVICE = bpt::devices::DefaultCPU;
+    using T = double;
+    using TI = typename DEVICE::index_t;
+    namespace multirotor = bpt::rl::environments::multirotor;
+    template <TI T_PHYSICS_SUBSTEPS = 1, bool T_CLOSED_FORM_ROTOR_DELAY = false>
+    struct STATIC_PARAMETERS: multirotor::StaticParametersDefault<T, TI>{
+        static constexpr TI ACTION_HISTORY_LENGTH = 0;
+        using STATE_TYPE = multirotor::StateRotors<T, TI, multirotor::StateRandomForce<T, TI, multirotor::StateBase<T, TI>>>;
+        static constexpr TI PHYSICS_SUBSTEPS = T_PHYSICS_SUBSTEPS;
+        static constexpr bool CLOSED_FORM_ROTOR_DELAY = T_CLOSED_FORM_ROTOR_DELAY;
+    };
+    using PARAMETERS = typename bpt::utils::typing::remove_cv_t<decltype(multirotor::parameters::default_parameters<T, TI>)>;
+    const PARAMETERS parameters = multirotor::parameters::default_parameters<T, TI>;
+    template <typename T_STATIC_PARAMETERS = STATIC_PARAMETERS<>, typename T_PARAMETERS = PARAMETERS>
+    using ENVIRONMENT = bpt::rl::environments::Multirotor<multirotor::Specification<T, TI, T_PARAMETERS, T_STATIC_PARAMETERS>>;
+}
+
+TEST(RL_TOOLS_RL_ENVIRONMENTS_MULTIROTOR, CLOSED_FORM_ROTOR_DELAY) {
+    using namespace multirotor_test;
+    using ENVIRONMENT_RK4 = ENVIRONMENT<STATIC_PARAMETERS<1, false>>;
+    using ENVIRONMENT_CLOSED_FORM = ENVIRONMENT<STATIC_PARAMETERS<1, true>>;
+    static_assert(bpt::utils::typing::is_same_v<ENVIRONMENT_RK4::State, ENVIRONMENT_CLOSED_FORM::State>);
+    using STATE = ENVIRONMENT_RK4::State;
+    DEVICE device;
+    auto rng = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 6);
+    ENVIRONMENT_RK4 env_rk4({parameters});
+    ENVIRONMENT_CLOSED_FORM env_closed_form({parameters});
+    bpt::MatrixDynamic<bpt::matrix::Specification<T, TI, 1, ENVIRONMENT_RK4::ACTION_DIM>> action;
+    bpt::malloc(device, action);
+    const T dt = parameters.integration.dt;
+    const T rpm_range = parameters.dynamics.action_limit.max - parameters.dynamics.action_limit.min;
+    const T decay = std::exp(-dt / parameters.dynamics.rpm_time_constant);
+    T max_rpm_error = 0, max_position_error = 0, max_linear_velocity_error = 0, max_angular_velocity_error = 0;
+    for(TI sample_i = 0; sample_i < 1000; sample_i++){
+        STATE state, next_state_rk4, next_state_closed_form;
+        bpt::sample_initial_state(device, env_rk4, state, rng);
+        for(TI action_i = 0; action_i < ENVIRONMENT_RK4::ACTION_DIM; action_i++){
+            bpt::set(action, 0, action_i, bpt::random::uniform_real_distribution(DEVICE::SPEC::RANDOM{}, (T)-1, (T)1, rng));
+        }
+        // the action noise is zero in the default parameters, hence both steps see the same setpoint
+        bpt::step(device, env_rk4, state, action, next_state_rk4, rng);
+        bpt::step(device, env_closed_form, state, action, next_state_closed_form, rng);
+        for(TI rotor_i = 0; rotor_i < 4; rotor_i++){
+            T setpoint = (bpt::get(action, 0, rotor_i) + 1) / 2 * rpm_range + parameters.dynamics.action_limit.min;
+            T exact = setpoint + (state.rpm[rotor_i] - setpoint) * decay;
+            exact = std::min(std::max(exact, parameters.dynamics.action_limit.min), parameters.dynamics.action_limit.max);
+            ASSERT_NEAR(next_state_closed_form.rpm[rotor_i], exact, 1e-9 * rpm_range);
+            max_rpm_error = std::max(max_rpm_error, std::abs(next_state_rk4.rpm[rotor_i] - next_state_closed_form.rpm[rotor_i]) / rpm_range);
+        }
+        for(TI i = 0; i < 3; i++){
+            max_position_error = std::max(max_position_error, std::abs(next_state_rk4.position[i] - next_state_closed_form.position[i]));
+            max_linear_velocity_error = std::max(max_linear_velocity_error, std::abs(next_state_rk4.linear_velocity[i] - next_state_closed_form.linear_velocity[i]));
+            max_angular_velocity_error = std::max(max_angular_velocity_error, std::abs(next_state_rk4.angular_velocity[i] - next_state_closed_form.angular_velocity[i]));
+        }
+    }
+    // RK4 is a 4th order approximation of the exponential: the deviation per step is O((dt / rpm_time_constant)^5)
+    ASSERT_LT(max_rpm_error, 1e-2);
+    ASSERT_LT(max_position_error, 1e-4);
+    ASSERT_LT(max_linear_velocity_error, 1e-2);
+    ASSERT_LT(max_angular_velocity_error, 1e-1);
+    bpt::free(device, action);
+}
+
+TEST(RL_TOOLS_RL_ENVIRONMENTS_MULTIROTOR, PHYSICS_SUBSTEPS) {
+    using namespace multirotor_test;
+    constexpr TI SUBSTEPS = 5;
+    using ENVIRONMENT_CONTROL = ENVIRONMENT<STATIC_PARAMETERS<SUBSTEPS>>;
+    using ENVIRONMENT_PHYSICS = ENVIRONMENT<STATIC_PARAMETERS<1>>;
+    using STATE = ENVIRONMENT_CONTROL::State;
+    DEVICE device;
+    auto rng = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 7);
+    PARAMETERS parameters_physics = parameters;
+    parameters_physics.integration.dt /= SUBSTEPS;
+    ENVIRONMENT_CONTROL env_control({parameters});
+    ENVIRONMENT_PHYSICS env_physics({parameters_physics});
+    bpt::MatrixDynamic<bpt::matrix::Specification<T, TI, 1, ENVIRONMENT_CONTROL::ACTION_DIM>> action;
+    bpt::malloc(device, action);
+    for(TI sample_i = 0; sample_i < 100; sample_i++){
+        STATE state, next_state_control, state_physics, next_state_physics;
+        bpt::sample_initial_state(device, env_control, state, rng);
+        bpt::randn(device, action, rng);
+        // one control step with SUBSTEPS physics steps is the same as SUBSTEPS steps at the physics rate with a constant action
+        bpt::step(device, env_control, state, action, next_state_control, rng);
+        state_physics = state;
+        for(TI substep_i = 0; substep_i < SUBSTEPS; substep_i++){
+            bpt::step(device, env_physics, state_physics, action, next_state_physics, rng);
+            state_physics = next_state_physics;
+        }
+        for(TI i = 0; i < 3; i++){
+            ASSERT_NEAR(next_state_control.position[i], state_physics.position[i], 1e-10);
+            ASSERT_NEAR(next_state_control.linear_velocity[i], state_physics.linear_velocity[i], 1e-10);
+            ASSERT_NEAR(next_state_control.angular_velocity[i], state_physics.angular_velocity[i], 1e-10);
+        }
+        for(TI i = 0; i < 4; i++){
+            ASSERT_NEAR(next_state_control.orientation[i], state_physics.orientation[i], 1e-10);
+            ASSERT_NEAR(next_state_control.rpm[i], state_physics.rpm[i], 1e-8);
+        }
+    }
+    bpt::free(device, action);
+}
+
+TEST(RL_TOOLS_RL_ENVIRONMENTS_MULTIROTOR, STEP_FULL) {
+    using namespace multirotor_test;
+    using ENVIRONMENT = multirotor_test::ENVIRONMENT<>;
+    using STATE = ENVIRONMENT::State;
+    DEVICE device;
+    auto rng = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 8);
+    ENVIRONMENT env({parameters});
+    bpt::MatrixDynamic<bpt::matrix::Specification<T, TI, 1, ENVIRONMENT::ACTION_DIM>> action;
+    bpt::malloc(device, action);
+    TI terminated_count = 0;
+    for(TI sample_i = 0; sample_i < 1000; sample_i++){
+        STATE state, next_state, next_state_full;
+        bpt::sample_initial_state(device, env, state, rng);
+        bpt::randn(device, action, rng);
+        if(sample_i % 4 == 0){
+            // push some of the transitions over the termination threshold
+            state.position[0] += env.parameters.mdp.termination.position_threshold;
+        }
+        auto rng_full = rng;
+        T dt = bpt::step(device, env, state, action, next_state, rng);
+        bool terminated_flag = bpt::terminated(device, env, next_state, rng);
+        T reward = bpt::reward(device, env, state, action, next_state, rng);
+        auto result = bpt::step_full(device, env, state, action, next_state_full, rng_full);
+        ASSERT_EQ(result.dt, dt);
+        ASSERT_EQ(result.terminated, terminated_flag);
+        ASSERT_EQ(result.reward, reward);
+        ASSERT_EQ(result.components.reward, reward);
+        for(TI i = 0; i < 3; i++){
+            ASSERT_EQ(next_state_full.position[i], next_state.position[i]);
+        }
+        terminated_count += terminated_flag;
+    }
+    ASSERT_GT(terminated_count, 0);
+    bpt::free(device, action);
+}
+
+TEST(RL_TOOLS_RL_ENVIRONMENTS_MULTIROTOR, WRENCH_MIXING) {
+    using namespace multirotor_test;
+    using ENVIRONMENT = multirotor_test::ENVIRONMENT<>;
+    using STATE = ENVIRONMENT::State;
+    DEVICE device;
+    auto rng = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 9);
+    bpt::MatrixDynamic<bpt::matrix::Specification<T, TI, 1, ENVIRONMENT::ACTION_DIM>> action;
+    bpt::malloc(device, action);
+    bpt::set_all(device, action, 0);
+    // the parameter sets do not contain the derived wrench mixing, it is computed by initial_state (through initial_parameters)
+    ENVIRONMENT env;
+    env.parameters = parameters;
+    STATE state, next_state;
+    bpt::initial_state(device, env, state);
+    T thrust_norm = 0;
+    for(TI i = 0; i < 3; i++){
+        for(TI rotor_i = 0; rotor_i < 4; rotor_i++){
+            thrust_norm += env.parameters.dynamics.wrench_mixing[i][rotor_i] * env.parameters.dynamics.wrench_mixing[i][rotor_i];
+        }
+    }
+    ASSERT_NEAR(thrust_norm, 4, 1e-10);
+    bpt::step(device, env, state, action, next_state, rng);
+    const T dt = parameters.integration.dt;
+    ASSERT_GT(std::abs(next_state.linear_velocity[2] - parameters.dynamics.gravity[2] * dt), 1e-3);
+
+    // stepping a state that is set directly (no initial_state, e.g. the scenario bank) only requires update_wrench_mixing
+    ENVIRONMENT env_direct;
+    env_direct.parameters = parameters;
+    bpt::rl::environments::multirotor::update_wrench_mixing(device, env_direct.parameters.dynamics);
+    env_direct.current_dynamics = env_direct.parameters.dynamics;
+    STATE next_state_direct;
+    bpt::step(device, env_direct, state, action, next_state_direct, rng);
+    for(TI i = 0; i < 3; i++){
+        ASSERT_EQ(next_state_direct.position[i], next_state.position[i]);
+        ASSERT_EQ(next_state_direct.linear_velocity[i], next_state.linear_velocity[i]);
+        ASSERT_EQ(next_state_direct.angular_velocity[i], next_state.angular_velocity[i]);
+    }
+    bpt::free(device, action);
+}
+
+namespace multirotor_observation_test{
+    using namespace multirotor_test;
+    namespace observation = multirotor::observation;
+    constexpr TI HISTORY_LENGTH = 8;
+    template <bool T_PRIVILEGED_OBSERVATION_NOISE>
+    struct STATIC_PARAMETERS: multirotor::StaticParametersDefault<T, TI>{
+        static constexpr TI ACTION_HISTORY_LENGTH = HISTORY_LENGTH;
+        using STATE_TYPE = multirotor::StateRotorsHistory<T, TI, HISTORY_LENGTH, multirotor::StateRandomForce<T, TI, multirotor::StateBase<T, TI>>>;
+        using OBSERVATION_TYPE = observation::Position<observation::PositionSpecification<T, TI,
+                                 observation::OrientationRotationMatrix<observation::OrientationRotationMatrixSpecification<T, TI,
+                                 observation::LinearVelocity<observation::LinearVelocitySpecification<T, TI,
+                                 observation::AngularVelocity<observation::AngularVelocitySpecification<T, TI,
+                                 observation::ActionHistory<observation::ActionHistorySpecification<T, TI, HISTORY_LENGTH>>>>>>>>>>;
+        using OBSERVATION_TYPE_PRIVILEGED = observation::Position<observation::PositionSpecificationPrivileged<T, TI,
+                                            observation::OrientationQuaternion<observation::OrientationQuaternionSpecificationPrivileged<T, TI,
+                                            observation::OrientationRotationMatrix<observation::OrientationRotationMatrixSpecificationPrivileged<T, TI,
+                                            observation::LinearVelocity<observation::LinearVelocitySpecificationPrivileged<T, TI,
+                                            observation::AngularVelocity<observation::AngularVelocitySpecificationPrivileged<T, TI,
+                                            observation::RandomForce<observation::RandomForceSpecification<T, TI,
+                                            observation::RotorSpeeds<observation::RotorSpeedsSpecification<T, TI>>>>>>>>>>>>>>;
+        static constexpr bool PRIVILEGED_OBSERVATION_NOISE = T_PRIVILEGED_OBSERVATION_NOISE;
+    };
+
+    // reference: the recursive observe (one view per component) the flat observation layout replaced. The noise is taken from
+    // the same block of standard normal samples in column order, instead of being drawn per element
+    template <typename ENVIRONMENT>
+    struct Reference{
+        using STATE = typename ENVIRONMENT::State;
+        static constexpr bool NOISE = ENVIRONMENT::STATIC_PARAMETERS::PRIVILEGED_OBSERVATION_NOISE;
+        template <typename COMPONENT>
+        static constexpr bool noisy(){ return !COMPONENT::PRIVILEGED || NOISE; }
+        template <typename OBS_SPEC>
+        static void block(bpt::Matrix<OBS_SPEC>& row, const T* values, TI n, T noise_std, const T*& noise, bool noisy){
+            for(TI i = 0; i < n; i++){
+                bpt::set(row, 0, i, values[i]);
+                if(noisy){
+                    bpt::increment(row, 0, i, noise_std * *noise++);
+                }
+            }
+        }
+        template <typename COMPONENT, typename OBS_SPEC>
+        static void next(DEVICE& device, const ENVIRONMENT& env, const STATE& state, bpt::Matrix<OBS_SPEC>& row, const T*& noise){
+            auto next_row = bpt::view(device, row, bpt::matrix::ViewSpec<1, OBS_SPEC::COLS - COMPONENT::CURRENT_DIM>{}, 0, COMPONENT::CURRENT_DIM);
+            observe(device, env, state, typename COMPONENT::NEXT_COMPONENT{}, next_row, noise);
+        }
+        template <typename OBS_SPEC>
+        static void observe(DEVICE&, const ENVIRONMENT&, const STATE&, observation::LastComponent<TI>, bpt::Matrix<OBS_SPEC>&, const T*&){
+            static_assert(OBS_SPEC::COLS == 0);
+        }
+        template <typename SPEC, typename OBS_SPEC>
+        static void observe(DEVICE& device, const ENVIRONMENT& env, const STATE& state, observation::Position<SPEC>, bpt::Matrix<OBS_SPEC>& row, const T*& noise){
+            using COMPONENT = observation::Position<SPEC>;
+            block(row, state.position, 3, env.parameters.mdp.observation_noise.position, noise, noisy<COMPONENT>());
+            next<COMPONENT>(device, env, state, row, noise);
+        }
+        template <typename SPEC, typename OBS_SPEC>
+        static void observe(DEVICE& device, const ENVIRONMENT& env, const STATE& state, observation::OrientationQuaternion<SPEC>, bpt::Matrix<OBS_SPEC>& row, const T*& noise){
+            using COMPONENT = observation::OrientationQuaternion<SPEC>;
+            block(row, state.orientation, 4, env.parameters.mdp.observation_noise.orientation, noise, noisy<COMPONENT>());
+            next<COMPONENT>(device, env, state, row, noise);
+        }
+        template <typename SPEC, typename OBS_SPEC>
+        static void observe(DEVICE& device, const ENVIRONMENT& env, const STATE& state, observation::OrientationRotationMatrix<SPEC>, bpt::Matrix<OBS_SPEC>& row, const T*& noise){
+            using COMPONENT = observation::OrientationRotationMatrix<SPEC>;
+            T rotation_matrix[9];
+            for(TI row_i = 0; row_i < 3; row_i++){
+                for(TI col_i = 0; col_i < 3; col_i++){
+                    rotation_matrix[row_i * 3 + col_i] = state.rotation_matrix[row_i][col_i];
+                }
+            }
+            block(row, rotation_matrix, 9, env.parameters.mdp.observation_noise.orientation, noise, noisy<COMPONENT>());
+            next<COMPONENT>(device, env, state, row, noise);
+        }
+        template <typename SPEC, typename OBS_SPEC>
+        static void observe(DEVICE& device, const ENVIRONMENT& env, const STATE& state, observation::LinearVelocity<SPEC>, bpt::Matrix<OBS_SPEC>& row, const T*& noise){
+            using COMPONENT = observation::LinearVelocity<SPEC>;
+            block(row, state.linear_velocity, 3, env.parameters.mdp.observation_noise.linear_velocity, noise, noisy<COMPONENT>());
+            next<COMPONENT>(device, env, state, row, noise);
+        }
+        template <typename SPEC, typename OBS_SPEC>
+        static void observe(DEVICE& device, const ENVIRONMENT& env, const STATE& state, observation::AngularVelocity<SPEC>, bpt::Matrix<OBS_SPEC>& row, const T*& noise){
+            using COMPONENT = observation::AngularVelocity<SPEC>;
+            block(row, state.angular_velocity, 3, env.parameters.mdp.observation_noise.angular_velocity, noise, noisy<COMPONENT>());
+            next<COMPONENT>(device, env, state, row, noise);
+        }
+        template <typename SPEC, typename OBS_SPEC>
+        static void observe(DEVICE& device, const ENVIRONMENT& env, const STATE& state, observation::RotorSpeeds<SPEC>, bpt::Matrix<OBS_SPEC>& row, const T*& noise){
+            for(TI action_i = 0; action_i < 4; action_i++){
+                T action_value = (state.rpm[action_i] - env.parameters.dynamics.action_limit.min)/(env.parameters.dynamics.action_limit.max - env.parameters.dynamics.action_limit.min) * 2 - 1;
+                bpt::set(row, 0, action_i, action_value);
+            }
+            next<observation::RotorSpeeds<SPEC>>(device, env, state, row, noise);
+        }
+        template <typename SPEC, typename OBS_SPEC>
+        static void observe(DEVICE& device, const ENVIRONMENT& env, const STATE& state, observation::ActionHistory<SPEC>, bpt::Matrix<OBS_SPEC>& row, const T*& noise){
+            using COMPONENT = observation::ActionHistory<SPEC>;
+            // element-wise walk through the ring buffer from the oldest to the newest action
+            TI history_i = state.action_history_head;
+            for(TI step_i = 0; step_i < COMPONENT::HISTORY_LENGTH; step_i++){
+                for(TI action_i = 0; action_i < COMPONENT::ACTION_DIM; action_i++){
+                    bpt::set(row, 0, step_i * COMPONENT::ACTION_DIM + action_i, state.action_history[history_i][action_i]);
+                }
+                history_i = history_i + 1 == COMPONENT::HISTORY_LENGTH ? 0 : history_i + 1;
+            }
+            next<COMPONENT>(device, env, state, row, noise);
+        }
+        template <typename SPEC, typename OBS_SPEC>
+        static void observe(DEVICE& device, const ENVIRONMENT& env, const STATE& state, observation::RandomForce<SPEC>, bpt::Matrix<OBS_SPEC>& row, const T*& noise){
+            for(TI i = 0; i < 3; i++){
+                bpt::set(row, 0, i, state.force[i]);
+                bpt::set(row, 0, 3 + i, state.torque[i]);
+            }
+            next<observation::RandomForce<SPEC>>(device, env, state, row, noise);
+        }
+    };
+
+    template <bool PRIVILEGED_OBSERVATION_NOISE>
+    void test_layout(TI seed){
+        using ENVIRONMENT = multirotor_test::ENVIRONMENT<STATIC_PARAMETERS<PRIVILEGED_OBSERVATION_NOISE>>;
+        using STATE = typename ENVIRONMENT::State;
+        using REFERENCE = Reference<ENVIRONMENT>;
+        using LAYOUT = observation::Layout<TI, typename ENVIRONMENT::Observation, PRIVILEGED_OBSERVATION_NOISE>;
+        using LAYOUT_PRIVILEGED = observation::Layout<TI, typename ENVIRONMENT::ObservationPrivileged, PRIVILEGED_OBSERVATION_NOISE>;
+        DEVICE device;
+        auto rng = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, seed);
+        PARAMETERS noisy_parameters = parameters;
+        noisy_parameters.mdp.observation_noise.position = 0.1;
+        noisy_parameters.mdp.observation_noise.orientation = 0.2;
+        noisy_parameters.mdp.observation_noise.linear_velocity = 0.3;
+        noisy_parameters.mdp.observation_noise.angular_velocity = 0.4;
+        ENVIRONMENT env({noisy_parameters});
+        bpt::MatrixDynamic<bpt::matrix::Specification<T, TI, 1, ENVIRONMENT::OBSERVATION_DIM>> observation_flat, observation_reference;
+        bpt::MatrixDynamic<bpt::matrix::Specification<T, TI, 1, ENVIRONMENT::OBSERVATION_DIM_PRIVILEGED>> observation_privileged_flat, observation_privileged_reference;
+        bpt::malloc(device, observation_flat);
+        bpt::malloc(device, observation_reference);
+        bpt::malloc(device, observation_privileged_flat);
+        bpt::malloc(device, observation_privileged_reference);
+        T noise[LAYOUT::TOTAL_NOISE_DIM], noise_privileged[LAYOUT_PRIVILEGED::TOTAL_NOISE_DIM > 0 ? LAYOUT_PRIVILEGED::TOTAL_NOISE_DIM : 1];
+        for(TI sample_i = 0; sample_i < 1000; sample_i++){
+            STATE state;
+            bpt::sample_initial_state(device, env, state, rng);
+            // every head position of the ring buffer, distinct entries
+            state.action_history_head = sample_i % HISTORY_LENGTH;
+            for(TI history_i = 0; history_i < HISTORY_LENGTH; history_i++){
+                for(TI action_i = 0; action_i < 4; action_i++){
+                    state.action_history[history_i][action_i] = bpt::random::uniform_real_distribution(DEVICE::SPEC::RANDOM{}, (T)-1, (T)1, rng);
+                }
+            }
+            for(TI i = 0; i < 3; i++){
+                state.force[i] = bpt::random::uniform_real_distribution(DEVICE::SPEC::RANDOM{}, (T)-1, (T)1, rng);
+                state.torque[i] = bpt::random::uniform_real_distribution(DEVICE::SPEC::RANDOM{}, (T)-1, (T)1, rng);
+            }
+
+            auto rng_reference = rng;
+            bpt::observe(device, env, state, observation_flat, rng);
+            bpt::random::block::normal(device, noise, LAYOUT::TOTAL_NOISE_DIM, rng_reference);
+            const T* noise_cursor = noise;
+            REFERENCE::observe(device, env, state, typename ENVIRONMENT::Observation{}, observation_reference, noise_cursor);
+            ASSERT_EQ(noise_cursor, noise + LAYOUT::TOTAL_NOISE_DIM);
+            for(TI i = 0; i < ENVIRONMENT::OBSERVATION_DIM; i++){
+                T flat = bpt::get(observation_flat, 0, i), reference = bpt::get(observation_reference, 0, i);
+                ASSERT_EQ(std::memcmp(&flat, &reference, sizeof(T)), 0);
+            }
+
+            rng_reference = rng;
+            bpt::observe_privileged(device, env, state, observation_privileged_flat, rng);
+            if constexpr(LAYOUT_PRIVILEGED::TOTAL_NOISE_DIM > 0){
+                bpt::random::block::normal(device, noise_privileged, LAYOUT_PRIVILEGED::TOTAL_NOISE_DIM, rng_reference);
+            }
+            noise_cursor = noise_privileged;
+            REFERENCE::observe(device, env, state, typename ENVIRONMENT::ObservationPrivileged{}, observation_privileged_reference, noise_cursor);
+            ASSERT_EQ(noise_cursor, noise_privileged + LAYOUT_PRIVILEGED::TOTAL_NOISE_DIM);
+            for(TI i = 0; i < ENVIRONMENT::OBSERVATION_DIM_PRIVILEGED; i++){
+                T flat = bpt::get(observation_privileged_flat, 0, i), reference = bpt::get(observation_privileged_reference, 0, i);
+                ASSERT_EQ(std::memcmp(&flat, &reference, sizeof(T)), 0);
+            }
+        }
+        bpt::free(device, observation_flat);
+        bpt::free(device, observation_reference);
+        bpt::free(device, observation_privileged_flat);
+        bpt::free(device, observation_privileged_reference);
+    }
+}
+
+TEST(RL_TOOLS_RL_ENVIRONMENTS_MULTIROTOR, OBSERVATION_LAYOUT) {
+    multirotor_observation_test::test_layout<false>(10);
+    multirotor_observation_test::test_layout<true>(11);
+}
+
+namespace multirotor_obstacle_field_test{
+    using namespace multirotor_test;
+    namespace obstacles = bpt::rl::environments::multirotor::obstacles;
+    struct Cylinder{ double x, y, radius, z_min, z_max; };
+    struct Plane{ double point_x, point_y, point_z, normal_x, normal_y, normal_z, thickness, x_min, x_max, y_min, y_max, z_min, z_max; };
+    constexpr Cylinder CYLINDERS[] = {
+        {1.0, 0.0, 0.3, -1.0, 1.0},
+        {0.5, 0.8, 0.1, -0.5, 0.5},
+    };
+    constexpr Plane PLANES[] = {
+        {1.0, 0.6, 0.0, 0.0, 1.0, 0.0, 0.1, 0.0, 1.0, 0.45, 0.75, -1.0, 1.0},
+    };
+}
+
+TEST(RL_TOOLS_RL_ENVIRONMENTS_MULTIROTOR, OBSTACLE_FIELD) {
+    using namespace multirotor_obstacle_field_test;
+    DEVICE device;
+    auto rng = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 9);
+    constexpr T SPACING = 0.02;
+    obstacles::Field<T> field;
+    bpt::bake(device, field, CYLINDERS, (size_t)2, PLANES, (size_t)1, SPACING, (T)0.2);
+    TI mismatches = 0, collisions = 0;
+    constexpr TI N = 100000;
+    for(TI sample_i = 0; sample_i < N; sample_i++){
+        T position[3];
+        for(TI i = 0; i < 3; i++){
+            // covers the baked volume and some space around it
+            position[i] = bpt::random::uniform_real_distribution(DEVICE::SPEC::RANDOM{}, (T)-1.5, (T)2.5, rng);
+        }
+        auto exact = obstacles::evaluate(device, position, CYLINDERS, (size_t)2, PLANES, (size_t)1);
+        auto sample = bpt::query(device, field, position);
+        // the signed distance is 1-Lipschitz, hence the interpolation error is bounded by the diagonal of a cell
+        constexpr T TOLERANCE = 2 * SPACING;
+        ASSERT_LT(sample.distance, exact.distance + TOLERANCE);
+        collisions += exact.distance < 0;
+        if(std::abs(exact.distance) > TOLERANCE){
+            ASSERT_EQ(sample.distance < 0, exact.distance < 0);
+            // the penalty is discontinuous at the z-limits of the pipes and the bounds of the wall
+            bool near_penalty_edge = std::abs(position[2]) > 0.45 || std::abs(position[0]) < TOLERANCE || std::abs(position[0] - 1) < TOLERANCE || std::abs(position[1] - 0.45) < TOLERANCE || std::abs(position[1] - 0.75) < TOLERANCE;
+            if(!near_penalty_edge){
+                ASSERT_NEAR(sample.penalty, exact.penalty, 0.1);
+            }
+        }
+        else{
+            mismatches += (sample.distance < 0) != (exact.distance < 0);
+        }
+    }
+    ASSERT_GT(collisions, 0);
+    // misclassifications are confined to the band of one cell around the surfaces (a handful per 100000 samples)
+    ASSERT_LT(mismatches, N / 1000);
+    {
+        // outside of the pipe the gradient points away from its axis
+        T position[3] = {1.5, 0.0, 0.0};
+        auto sample = bpt::query(device, field, position);
+        ASSERT_NEAR(sample.distance, 0.2, 1e-3);
+        ASSERT_NEAR(sample.gradient[0], 1, 1e-2);
+        ASSERT_NEAR(sample.gradient[1], 0, 5e-2);
+        ASSERT_EQ(sample.nearest, 0);
+        ASSERT_EQ(obstacles::evaluate(device, position, CYLINDERS, (size_t)2, PLANES, (size_t)1).nearest, 0);
+    }
+    bpt::free(device, field);
+}
+
+namespace multirotor_obstacle_cache_test{
+    using multirotor_test::DEVICE;
+    using multirotor_test::T;
+    using multirotor_test::TI;
+    namespace multirotor = bpt::rl::environments::multirotor;
+    namespace obstacles = multirotor::obstacles;
+    using REWARD_FUNCTION = bpt::utils::typing::remove_cv_t<decltype(multirotor::parameters::reward_functions::reward_position_to_position_basic<T>)>;
+    const multirotor::ParametersBase<T, TI, 4, REWARD_FUNCTION> parameters = {
+        multirotor::parameters::dynamics::mrs<T, TI, REWARD_FUNCTION>,
+        {0.01},
+        {
+            multirotor::parameters::init::all_around_2<T, TI, 4, REWARD_FUNCTION>,
+            multirotor::parameters::reward_functions::reward_position_to_position_basic<T>,
+            {0, 0, 0, 0},
+            {0},
+            multirotor::parameters::termination::fast_learning<T, TI, 4, REWARD_FUNCTION>
+        }
+    };
+    using PARAMETERS = decltype(parameters);
+    using ENVIRONMENT = multirotor_test::ENVIRONMENT<multirotor::StaticParametersDefault<T, TI>, PARAMETERS>;
+    const obstacles::Cylinder CYLINDERS[] = {
+        {1.0f, 0.0f, 0.3f, -1.0f, 1.0f},
+    };
+    const obstacles::Plane PLANES[] = {
+        {0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.05f, -1.0f, 1.0f, 0.5f, 1.5f, -1.0f, 1.0f},
+    };
+}
+
+TEST(RL_TOOLS_RL_ENVIRONMENTS_MULTIROTOR, OBSTACLE_CACHE) {
+    using namespace multirotor_obstacle_cache_test;
+    using STATE = ENVIRONMENT::State;
+    DEVICE device;
+    auto rng = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 10);
+    ENVIRONMENT env({parameters});
+    obstacles::Scene scene{CYLINDERS, 1, PLANES, 1};
+    multirotor::parameters::reward_functions::set_obstacles(env.parameters.mdp.reward, &scene, (const obstacles::Field<T>*)nullptr);
+    bpt::MatrixDynamic<bpt::matrix::Specification<T, TI, 1, ENVIRONMENT::ACTION_DIM>> action;
+    bpt::malloc(device, action);
+    bpt::set_all(device, action, 0);
+
+    STATE state, next_state;
+    bpt::initial_state(device, env, state);
+    ASSERT_NEAR(state.obstacle_distance, 0.7, 1e-6);
+    ASSERT_EQ(state.obstacle_id, 0);
+    ASSERT_FALSE(state.obstacle_collision);
+    ASSERT_FALSE(bpt::terminated(device, env, state, rng));
+
+    // close to the wall (obstacle index: number of cylinders + plane index)
+    state.position[1] = 0.9;
+    multirotor::update_obstacle_cache(device, env, state);
+    ASSERT_NEAR(state.obstacle_distance, 0.05, 1e-6);
+    ASSERT_EQ(state.obstacle_id, 1);
+    ASSERT_FALSE(state.obstacle_collision);
+
+    // inside of the pipe: the step caches the collision, terminated and the reward read it
+    state.position[0] = 1.0;
+    state.position[1] = 0.0;
+    multirotor::update_obstacle_cache(device, env, state);
+    ASSERT_TRUE(state.obstacle_collision);
+    bpt::step(device, env, state, action, next_state, rng);
+    ASSERT_TRUE(next_state.obstacle_collision);
+    ASSERT_EQ(next_state.obstacle_id, 0);
+    ASSERT_TRUE(bpt::terminated(device, env, next_state, rng));
+    ASSERT_EQ(bpt::reward(device, env, state, action, next_state, rng), env.parameters.mdp.reward.termination_penalty);
+    auto result = bpt::step_full(device, env, state, action, next_state, rng);
+    ASSERT_TRUE(result.terminated);
+
+    // the baked field yields the same cache up to the grid resolution
+    constexpr T SPACING = 0.02;
+    obstacles::Field<T> field;
+    bpt::bake(device, field, scene, SPACING, (T)0.2);
+    auto env_field = env;
+    multirotor::parameters::reward_functions::set_obstacles(env_field.parameters.mdp.reward, &scene, (const obstacles::Field<T>*)&field);
+    for(TI sample_i = 0; sample_i < 1000; sample_i++){
+        STATE exact, baked;
+        bpt::sample_initial_state(device, env, exact, rng);
+        baked = exact;
+        multirotor::update_obstacle_cache(device, env_field, baked);
+        ASSERT_NEAR(baked.obstacle_distance, exact.obstacle_distance, 2 * SPACING);
+        if(std::abs(exact.obstacle_distance) > 2 * SPACING){
+            ASSERT_EQ(baked.obstacle_collision, exact.obstacle_collision);
+        }
+    }
+    bpt::free(device, field);
+    bpt::free(device, action);
+}
+
+namespace multirotor_obstacle_cache_substeps_test{
+    using namespace multirotor_obstacle_cache_test;
+    constexpr TI SUBSTEPS = 5;
+    struct STATIC_PARAMETERS: multirotor::StaticParametersDefault<T, TI>{
+        static constexpr TI PHYSICS_SUBSTEPS = SUBSTEPS;
+    };
+}
+
+TEST(RL_TOOLS_RL_ENVIRONMENTS_MULTIROTOR, OBSTACLE_CACHE_PHYSICS_SUBSTEPS) {
+    using namespace multirotor_obstacle_cache_substeps_test;
+    using ENVIRONMENT_CONTROL = multirotor_test::ENVIRONMENT<STATIC_PARAMETERS, PARAMETERS>;
+    using ENVIRONMENT_PHYSICS = ENVIRONMENT;
+    using STATE = ENVIRONMENT::State;
+    DEVICE device;
+    auto rng = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 13);
+    obstacles::Scene scene{CYLINDERS, 1, PLANES, 1};
+    ENVIRONMENT_CONTROL env_control({parameters});
+    auto parameters_physics = parameters;
+    parameters_physics.integration.dt /= SUBSTEPS;
+    ENVIRONMENT_PHYSICS env_physics({parameters_physics});
+    multirotor::parameters::reward_functions::set_obstacles(env_control.parameters.mdp.reward, &scene, (const obstacles::Field<T>*)nullptr);
+    multirotor::parameters::reward_functions::set_obstacles(env_physics.parameters.mdp.reward, &scene, (const obstacles::Field<T>*)nullptr);
+    bpt::MatrixDynamic<bpt::matrix::Specification<T, TI, 1, ENVIRONMENT::ACTION_DIM>> action;
+    bpt::malloc(device, action);
+    bpt::set_all(device, action, 0);
+
+    // flying through the wall (surfaces at y = 0.95 and 1.05) within one control step: inside at the intermediate sub-steps only
+    STATE state, next_state;
+    bpt::initial_state(device, env_control, state);
+    state.position[1] = 0.88;
+    state.linear_velocity[1] = 0.2 / parameters.integration.dt;
+    multirotor::update_obstacle_cache(device, env_control, state);
+    ASSERT_FALSE(state.obstacle_collision);
+    bpt::step(device, env_control, state, action, next_state, rng);
+    ASSERT_GT(next_state.obstacle_distance, 0);
+    ASSERT_TRUE(next_state.obstacle_collision);
+    ASSERT_TRUE(bpt::terminated(device, env_control, next_state, rng));
+
+    // in general the flag is the disjunction over the physics steps
+    TI collisions = 0;
+    for(TI sample_i = 0; sample_i < 1000; sample_i++){
+        STATE state_physics, next_state_physics;
+        bpt::sample_initial_state(device, env_control, state, rng);
+        for(TI i = 0; i < 3; i++){
+            state.linear_velocity[i] = bpt::random::uniform_real_distribution(DEVICE::SPEC::RANDOM{}, (T)-20, (T)20, rng);
+        }
+        bpt::step(device, env_control, state, action, next_state, rng);
+        state_physics = state;
+        bool collision = false;
+        for(TI substep_i = 0; substep_i < SUBSTEPS; substep_i++){
+            bpt::step(device, env_physics, state_physics, action, next_state_physics, rng);
+            collision = collision || next_state_physics.obstacle_collision;
+            state_physics = next_state_physics;
+        }
+        ASSERT_EQ(next_state.obstacle_collision, collision);
+        collisions += collision;
+    }
+    ASSERT_GT(collisions, 0);
+    bpt::free(device, action);
+}
+
+namespace multirotor_range_sensor_test{
+    using namespace multirotor_obstacle_cache_test;
+    struct STATIC_PARAMETERS: multirotor::StaticParametersDefault<T, TI>{
+        using OBSERVATION_TYPE = multirotor::observation::RangeSensor<multirotor::observation::RangeSensorSpecification<T, TI, 4>>;
+    };
+    using ENVIRONMENT = multirotor_test::ENVIRONMENT<STATIC_PARAMETERS, PARAMETERS>;
+    // reference: sphere tracing through the exact signed distance
+    T march(DEVICE& device, const T origin[3], const T direction[3], const obstacles::Scene& scene, T max_range){
+        T t = 0;
+        for(TI step_i = 0; step_i < 100000 && t < max_range; step_i++){
+            T position[3] = {origin[0] + t * direction[0], origin[1] + t * direction[1], origin[2] + t * direction[2]};
+            T distance = obstacles::evaluate(device, position, scene).distance;
+            if(distance < 1e-9){
+                return t;
+            }
+            t += distance;
+        }
+        return max_range;
+    }
+}
+
+TEST(RL_TOOLS_RL_ENVIRONMENTS_MULTIROTOR, RANGE_SENSOR) {
+    using namespace multirotor_range_sensor_test;
+    DEVICE device;
+    auto rng = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 11);
+    obstacles::Scene scene{CYLINDERS, 1, PLANES, 1};
+    constexpr TI N = 16;
+    constexpr T MAX_RANGE = 3;
+    TI mismatches = 0, hits = 0, total = 0;
+    for(TI sample_i = 0; sample_i < 10000; sample_i++){
+        T origin[3], direction_x[N], direction_y[N], direction_z[N], ranges[N];
+        for(TI i = 0; i < 3; i++){
+            origin[i] = bpt::random::uniform_real_distribution(DEVICE::SPEC::RANDOM{}, (T)-1.5, (T)2, rng);
+        }
+        if(obstacles::evaluate(device, origin, scene).distance < 0){
+            continue;
+        }
+        for(TI ray_i = 0; ray_i < N; ray_i++){
+            T direction[3];
+            for(TI i = 0; i < 3; i++){
+                direction[i] = bpt::random::normal_distribution::sample(DEVICE::SPEC::RANDOM{}, (T)0, (T)1, rng);
+            }
+            // some horizontal rays (axis parallel to the pipes and the wall bounds)
+            direction[2] = ray_i % 4 == 0 ? 0 : direction[2];
+            T norm = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+            direction_x[ray_i] = direction[0] / norm;
+            direction_y[ray_i] = direction[1] / norm;
+            direction_z[ray_i] = direction[2] / norm;
+        }
+        obstacles::raycast(device, origin, direction_x, direction_y, direction_z, N, scene, MAX_RANGE, ranges);
+        for(TI ray_i = 0; ray_i < N; ray_i++){
+            T direction[3] = {direction_x[ray_i], direction_y[ray_i], direction_z[ray_i]};
+            T reference = march(device, origin, direction, scene, MAX_RANGE);
+            ASSERT_LE(ranges[ray_i], MAX_RANGE);
+            // sphere tracing does not converge for rays grazing an edge
+            mismatches += std::abs(ranges[ray_i] - reference) > 1e-6;
+            hits += ranges[ray_i] < MAX_RANGE;
+            total++;
+        }
+    }
+    ASSERT_GT(hits, total / 10);
+    ASSERT_LT(mismatches, total / 1000);
+    {
+        // inside of the pipe all ranges are zero
+        T origin[3] = {1.0, 0.0, 0.0};
+        T direction_x[2] = {1, 0}, direction_y[2] = {0, 0}, direction_z[2] = {0, 1}, ranges[2];
+        obstacles::raycast(device, origin, direction_x, direction_y, direction_z, (TI)2, scene, MAX_RANGE, ranges);
+        ASSERT_EQ(ranges[0], 0);
+        ASSERT_EQ(ranges[1], 0);
+    }
+
+    // observation: rays along +x, +y, -x, -y of the body frame (identity orientation at the origin)
+    ENVIRONMENT env({parameters});
+    multirotor::parameters::reward_functions::set_obstacles(env.parameters.mdp.reward, &scene, (const obstacles::Field<T>*)nullptr);
+    ENVIRONMENT::State state;
+    bpt::initial_state(device, env, state);
+    bpt::MatrixDynamic<bpt::matrix::Specification<T, TI, 1, ENVIRONMENT::OBSERVATION_DIM>> observation;
+    bpt::malloc(device, observation);
+    static_assert(ENVIRONMENT::OBSERVATION_DIM == 4);
+    bpt::observe(device, env, state, observation, rng);
+    ASSERT_NEAR(bpt::get(observation, 0, 0), 0.7 / 2, 1e-6);  // pipe surface
+    ASSERT_NEAR(bpt::get(observation, 0, 1), 0.95 / 2, 1e-6); // wall
+    ASSERT_NEAR(bpt::get(observation, 0, 2), 1, 1e-6);
+    ASSERT_NEAR(bpt::get(observation, 0, 3), 1, 1e-6);
+    // yawed by 90 degrees: the pipe is seen by the ray along -y of the body frame
+    state.orientation[0] = std::cos(M_PI / 4);
+    state.orientation[3] = std::sin(M_PI / 4);
+    multirotor::update_derived_quantities(device, state);
+    bpt::observe(device, env, state, observation, rng);
+    ASSERT_NEAR(bpt::get(observation, 0, 0), 0.95 / 2, 1e-6);
+    ASSERT_NEAR(bpt::get(observation, 0, 3), 0.7 / 2, 1e-6);
+    bpt::free(device, observation);
+}
+
+TEST(RL_TOOLS_RL_ENVIRONMENTS_MULTIROTOR, OBSTACLE_COURSE) {
+    using namespace multirotor_obstacle_cache_test;
+    using STATE = ENVIRONMENT::State;
+    DEVICE device;
+    auto rng = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 12);
+    obstacles::CourseGenerator generator{};
+    generator.min_cylinders = 2;
+    generator.max_cylinders = 6;
+    generator.min_radius = 0.05;
+    generator.max_radius = 0.3;
+    generator.min_planes = 0;
+    generator.max_planes = 2;
+    generator.plane_thickness = 0.05;
+    generator.min_plane_length = 0.5;
+    generator.max_plane_length = 1.5;
+    generator.lower[0] = -2; generator.lower[1] = -2; generator.lower[2] = -1;
+    generator.upper[0] = 2; generator.upper[1] = 2; generator.upper[2] = 1;
+    generator.clearance = 0.3;
+    generator.max_attempts = 100;
+    ENVIRONMENT env({parameters});
+    multirotor::parameters::reward_functions::set_course_generator(env.parameters.mdp.reward, &generator);
+    ASSERT_EQ(env.parameters.mdp.reward.course.num_cylinders, 0);
+
+    TI redrawn = 0, collisions = 0;
+    obstacles::Course previous = env.parameters.mdp.reward.course;
+    for(TI episode_i = 0; episode_i < 1000; episode_i++){
+        STATE state;
+        bpt::sample_initial_state(device, env, state, rng);
+        const obstacles::Course& course = env.parameters.mdp.reward.course;
+        // the counts are within the bounds of the generator (rejected obstacles are dropped after max_attempts)
+        ASSERT_LE(course.num_cylinders, generator.max_cylinders);
+        ASSERT_LE(course.num_planes, generator.max_planes);
+        redrawn += course.num_cylinders != previous.num_cylinders || course.x[0] != previous.x[0];
+        previous = course;
+        // the spawn position and the target are clear
+        ASSERT_GT(state.obstacle_distance, generator.clearance);
+        ASSERT_FALSE(state.obstacle_collision);
+        T target[3] = {env.parameters.mdp.reward.target_pos[0], env.parameters.mdp.reward.target_pos[1], env.parameters.mdp.reward.target_pos[2]};
+        ASSERT_GT(obstacles::evaluate(device, target, course).distance, generator.clearance);
+        // the structure of arrays evaluates like the equivalent obstacle tables
+        obstacles::Cylinder cylinders[obstacles::COURSE_MAX_CYLINDERS];
+        obstacles::Plane planes[obstacles::COURSE_MAX_PLANES];
+        for(TI i = 0; i < course.num_cylinders; i++){
+            cylinders[i] = course.cylinder(i);
+            ASSERT_GE(course.radius[i], generator.min_radius);
+            ASSERT_LE(course.radius[i], generator.max_radius);
+        }
+        for(TI i = 0; i < course.num_planes; i++){
+            planes[i] = course.plane(i);
+        }
+        for(TI sample_i = 0; sample_i < 10; sample_i++){
+            T position[3];
+            for(TI i = 0; i < 3; i++){
+                position[i] = bpt::random::uniform_real_distribution(DEVICE::SPEC::RANDOM{}, (T)-2, (T)2, rng);
+            }
+            auto expected = obstacles::evaluate(device, position, cylinders, course.num_cylinders, planes, course.num_planes);
+            auto actual = multirotor::parameters::reward_functions::query_obstacles(device, env.parameters.mdp.reward, position);
+            ASSERT_EQ(actual.distance, expected.distance);
+            ASSERT_EQ(actual.nearest, expected.nearest);
+            collisions += actual.distance < 0;
+        }
+    }
+    ASSERT_GT(redrawn, 990);
+    ASSERT_GT(collisions, 0);
+
+    // initial_state keeps the current course
+    previous = env.parameters.mdp.reward.course;
+    STATE state;
+    bpt::initial_state(device, env, state);
+    ASSERT_EQ(env.parameters.mdp.reward.course.num_cylinders, previous.num_cylinders);
+    ASSERT_EQ(env.parameters.mdp.reward.course.x[0], previous.x[0]);
+
+    // minimums beyond the capacity (or the maximum) are clamped instead of drawing from an empty range
+    obstacles::CourseGenerator oversized = generator;
+    oversized.min_cylinders = obstacles::COURSE_MAX_CYLINDERS + 5;
+    oversized.max_cylinders = obstacles::COURSE_MAX_CYLINDERS + 10;
+    oversized.min_planes = 3;
+    oversized.max_planes = 1;
+    for(TI episode_i = 0; episode_i < 100; episode_i++){
+        obstacles::Course course;
+        obstacles::sample(device, oversized, state.position, env.parameters.mdp.reward.target_pos, course, rng);
+        ASSERT_LE(course.num_cylinders, obstacles::COURSE_MAX_CYLINDERS);
+        ASSERT_LE(course.num_planes, 1);
+    }
+}
+
+TEST(RL_TOOLS_RL_ENVIRONMENTS_MULTIROTOR, REWARD_TERMS) {
+    using namespace multirotor_obstacle_cache_test;
+    namespace reward_functions = multirotor::parameters::reward_functions;
+    DEVICE device;
+    auto rng = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 13);
+    ENVIRONMENT env({parameters});
+    constexpr auto squared = reward_functions::reward_precision_hover<T>;
+    constexpr auto squared_pruned = reward_functions::prune<reward_functions::terms::nonzero(squared)>(squared);
+    static_assert(decltype(squared_pruned)::TERMS == (reward_functions::terms::POSITION | reward_functions::terms::ORIENTATION | reward_functions::terms::LINEAR_VELOCITY | reward_functions::terms::ACTION));
+    constexpr auto position_to_position = reward_functions::reward_position_to_position_basic<T>;
+    constexpr auto position_to_position_pruned = reward_functions::prune<reward_functions::terms::nonzero(position_to_position)>(position_to_position);
+    static_assert((decltype(position_to_position_pruned)::TERMS & (reward_functions::terms::LINEAR_ACCELERATION | reward_functions::terms::ANGULAR_ACCELERATION)) == 0);
+    bpt::MatrixDynamic<bpt::matrix::Specification<T, TI, 1, ENVIRONMENT::ACTION_DIM>> action;
+    bpt::malloc(device, action);
+    for(TI sample_i = 0; sample_i < 1000; sample_i++){
+        ENVIRONMENT::State state, next_state;
+        bpt::sample_initial_state(device, env, state, rng);
+        bpt::sample_initial_state(device, env, next_state, rng);
+        bpt::randn(device, action, rng);
+        // dropping zero-weight terms does not change the reward
+        auto full = reward_functions::reward_components(device, env, squared, state, action, next_state, false);
+        auto pruned = reward_functions::reward_components(device, env, squared_pruned, state, action, next_state, false);
+        ASSERT_EQ(pruned.reward, full.reward);
+        ASSERT_EQ(pruned.angular_vel_cost, 0);
+        full = reward_functions::reward_components(device, env, position_to_position, state, action, next_state, false);
+        pruned = reward_functions::reward_components(device, env, position_to_position_pruned, state, action, next_state, false);
+        ASSERT_EQ(pruned.reward, full.reward);
+        ASSERT_EQ(pruned.linear_acc_cost, 0);
+    }
+    bpt::free(device, action);
+}
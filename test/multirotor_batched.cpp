@@ -0,0 +1,147 @@
+#include <rl_tools/operations/cpu.h>
+
+#include <learning_to_fly/simulator/parameters/default.h>
+
+#include <learning_to_fly/simulator/multirotor.h>
+
+#include <learning_to_fly/simulator/operations_cpu.h>
+
+namespace bpt = RL_TOOLS_NAMESPACE_WRAPPER ::rl_tools;
+
+#include <gtest/gtest.h>
+#include <cmath>
+
+namespace multirotor_batched_test{
+    using DEVICE = bpt::devices::DefaultCPU;
+    using T = float;
+    using TI = typename DEVICE::index_t;
+    namespace multirotor = bpt::rl::environments::multirotor;
+    struct STATIC_PARAMETERS: multirotor::StaticParametersDefault<T, TI>{
+        static constexpr TI ACTION_HISTORY_LENGTH = 32;
+        using STATE_TYPE = multirotor::StateRotorsHistory<T, TI, ACTION_HISTORY_LENGTH, multirotor::StateRandomForce<T, TI, multirotor::StateBase<T, TI>>>;
+    };
+    const auto parameters = multirotor::parameters::default_parameters<T, TI>;
+    using PARAMETERS = decltype(parameters);
+    using SPEC = multirotor::Specification<T, TI, PARAMETERS, STATIC_PARAMETERS>;
+    using ENVIRONMENT = bpt::rl::environments::Multirotor<SPEC>;
+    using STATE = ENVIRONMENT::State;
+    constexpr TI BATCH_SIZE = 64;
+    using BATCH = multirotor::StateBatched<STATE, BATCH_SIZE>;
+}
+
+TEST(RL_TOOLS_RL_ENVIRONMENTS_MULTIROTOR, BATCHED_MATCHES_SCALAR) {
+    using namespace multirotor_batched_test;
+    DEVICE device;
+    auto rng_init = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 3);
+    auto rng_scalar = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 4);
+    auto rng_batched = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 4);
+
+    ENVIRONMENT env({parameters});
+    bpt::MatrixDynamic<bpt::matrix::Specification<T, TI, BATCH_SIZE, ENVIRONMENT::ACTION_DIM>> actions;
+    bpt::malloc(device, actions);
+
+    static STATE states[BATCH_SIZE], next_states_scalar[BATCH_SIZE], next_states_batched[BATCH_SIZE];
+    static BATCH buffer[2];
+    for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+        bpt::sample_initial_state(device, env, states[lane_i], rng_init);
+    }
+    auto close = [](T a, T b){ return std::abs(a - b) <= (T)1e-4 * (1 + std::abs(b)); };
+    for(TI step_i = 0; step_i < 100; step_i++){
+        bpt::randn(device, actions, rng_init);
+        for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+            auto action = bpt::view(device, actions, bpt::matrix::ViewSpec<1, ENVIRONMENT::ACTION_DIM>{}, lane_i, 0);
+            bpt::step(device, env, states[lane_i], action, next_states_scalar[lane_i], rng_scalar);
+        }
+        bpt::step(device, env, states, actions, next_states_batched, buffer, rng_batched);
+        for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+            const STATE& s = next_states_scalar[lane_i];
+            const STATE& b = next_states_batched[lane_i];
+            for(TI i = 0; i < 3; i++){
+                ASSERT_TRUE(close(b.position[i], s.position[i]));
+                ASSERT_TRUE(close(b.linear_velocity[i], s.linear_velocity[i]));
+                ASSERT_TRUE(close(b.angular_velocity[i], s.angular_velocity[i]));
+                ASSERT_EQ(b.force[i], s.force[i]);
+                ASSERT_EQ(b.torque[i], s.torque[i]);
+            }
+            for(TI i = 0; i < 4; i++){
+                ASSERT_TRUE(close(b.orientation[i], s.orientation[i]));
+                ASSERT_TRUE(close(b.rpm[i], s.rpm[i]));
+            }
+            ASSERT_EQ(b.action_history_head, s.action_history_head);
+            for(TI history_i = 0; history_i < STATE::HISTORY_LENGTH; history_i++){
+                for(TI i = 0; i < 4; i++){
+                    ASSERT_EQ(b.action_history[history_i][i], s.action_history[history_i][i]);
+                }
+            }
+            // continue from the scalar result so that the float deviation does not accumulate
+            states[lane_i] = s;
+        }
+    }
+    bpt::free(device, actions);
+}
+
+TEST(RL_TOOLS_RL_ENVIRONMENTS_MULTIROTOR, BATCHED_STRUCTURE_OF_ARRAYS) {
+    using namespace multirotor_batched_test;
+    DEVICE device;
+    auto rng_init = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 5);
+    auto rng_scalar = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 6);
+    auto rng_batched = bpt::random::default_engine(DEVICE::SPEC::RANDOM{}, 6);
+
+    ENVIRONMENT env({parameters});
+    bpt::MatrixDynamic<bpt::matrix::Specification<T, TI, BATCH_SIZE, ENVIRONMENT::ACTION_DIM>> actions;
+    bpt::malloc(device, actions);
+
+    static STATE states[BATCH_SIZE], next_states[BATCH_SIZE];
+    static BATCH batch, next_batch;
+    for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+        bpt::sample_initial_state(device, env, states[lane_i], rng_init);
+    }
+    auto close = [](T a, T b){ return std::abs(a - b) <= (T)1e-4 * (1 + std::abs(b)); };
+    for(TI step_i = 0; step_i < 100; step_i++){
+        bpt::randn(device, actions, rng_init);
+        for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+            auto action = bpt::view(device, actions, bpt::matrix::ViewSpec<1, ENVIRONMENT::ACTION_DIM>{}, lane_i, 0);
+            bpt::step(device, env, states[lane_i], action, next_states[lane_i], rng_scalar);
+            multirotor::load(device, states[lane_i], batch, lane_i);
+        }
+        // the structure-of-arrays step is compared field by field without storing the lanes, including the derived quantities
+        bpt::step(device, env, batch, actions, next_batch, rng_batched);
+        for(TI lane_i = 0; lane_i < BATCH_SIZE; lane_i++){
+            const STATE& s = next_states[lane_i];
+            for(TI i = 0; i < 3; i++){
+                ASSERT_TRUE(close(next_batch.position[i][lane_i], s.position[i]));
+                ASSERT_TRUE(close(next_batch.linear_velocity[i][lane_i], s.linear_velocity[i]));
+                ASSERT_TRUE(close(next_batch.angular_velocity[i][lane_i], s.angular_velocity[i]));
+                ASSERT_EQ(next_batch.force[i][lane_i], s.force[i]);
+                ASSERT_EQ(next_batch.torque[i][lane_i], s.torque[i]);
+                for(TI j = 0; j < 3; j++){
+                    ASSERT_TRUE(close(next_batch.rotation_matrix[i][j][lane_i], s.rotation_matrix[i][j]));
+                }
+            }
+            for(TI i = 0; i < 4; i++){
+                ASSERT_TRUE(close(next_batch.orientation[i][lane_i], s.orientation[i]));
+                ASSERT_TRUE(close(next_batch.rpm[i][lane_i], s.rpm[i]));
+            }
+            ASSERT_TRUE(close(next_batch.obstacle_distance[lane_i], s.obstacle_distance));
+            ASSERT_EQ(next_batch.obstacle_id[lane_i], s.obstacle_id);
+            ASSERT_EQ(next_batch.obstacle_collision[lane_i], s.obstacle_collision);
+            // load and store are inverse to each other
+            STATE stored;
+            multirotor::load(device, s, batch, lane_i);
+            multirotor::store(device, batch, lane_i, stored);
+            for(TI i = 0; i < 3; i++){
+                ASSERT_EQ(stored.position[i], s.position[i]);
+                ASSERT_EQ(stored.linear_velocity[i], s.linear_velocity[i]);
+                ASSERT_EQ(stored.angular_velocity[i], s.angular_velocity[i]);
+                for(TI j = 0; j < 3; j++){
+                    ASSERT_EQ(stored.rotation_matrix[i][j], s.rotation_matrix[i][j]);
+                }
+            }
+            ASSERT_EQ(stored.obstacle_distance, s.obstacle_distance);
+            ASSERT_EQ(stored.obstacle_id, s.obstacle_id);
+            ASSERT_EQ(stored.obstacle_collision, s.obstacle_collision);
+            states[lane_i] = s;
+        }
+    }
+    bpt::free(device, actions);
+}
@@ -0,0 +1,742 @@
+#include "../src/training.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace training_test{
+    using CONFIG = learning_to_fly::config::Config<learning_to_fly::config::DEFAULT_ABLATION_SPEC>;
+    using DEVICE = CONFIG::DEVICE;
+    using T = CONFIG::T;
+    using TI = CONFIG::TI;
+    using ENVIRONMENT = CONFIG::ENVIRONMENT;
+    using ACTOR_TYPE = CONFIG::ACTOR_TYPE;
+    const auto environment_parameters = parameters::environment<T, TI, CONFIG::ABLATION_SPEC>::parameters;
+}
+
+TEST(LEARNING_TO_FLY_TRAINING, OFF_POLICY_RUNNER_POLICY_SWITCHING_MULTIPLE_ENVIRONMENTS) {
+    using namespace training_test;
+    constexpr TI N_ENVIRONMENTS = 4;
+    constexpr TI EPISODE_STEP_LIMIT = 50;
+    using RUNNER_SPEC = rlt::rl::components::off_policy_runner::Specification<T, TI, ENVIRONMENT, N_ENVIRONMENTS, CONFIG::ASYMMETRIC_OBSERVATIONS, 1000, EPISODE_STEP_LIMIT, rlt::rl::components::off_policy_runner::DefaultParameters<T>, false, true, 1000>;
+    DEVICE device;
+    auto rng = rlt::random::default_engine(typename DEVICE::SPEC::RANDOM{}, 0);
+
+    rlt::rl::components::OffPolicyRunner<RUNNER_SPEC> runner;
+    rlt::malloc(device, runner);
+    ENVIRONMENT envs[N_ENVIRONMENTS];
+    for(auto& env: envs){
+        env.parameters = environment_parameters;
+    }
+    rlt::init(device, runner, envs);
+    runner.parameters = CONFIG::off_policy_runner_parameters;
+
+    ACTOR_TYPE policy, hover_policy;
+    ACTOR_TYPE::DoubleBuffer<N_ENVIRONMENTS> policy_buffer;
+    ACTOR_TYPE::DoubleBuffer<1> hover_buffer;
+    rlt::malloc(device, policy);
+    rlt::malloc(device, hover_policy);
+    rlt::malloc(device, policy_buffer);
+    rlt::malloc(device, hover_buffer);
+    rlt::init_weights(device, policy, rng);
+    rlt::init_weights(device, hover_policy, rng);
+
+    rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, ENVIRONMENT::OBSERVATION_DIM>> observation;
+    rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, ENVIRONMENT::ACTION_DIM>> action;
+    rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, N_ENVIRONMENTS, ENVIRONMENT::ACTION_DIM>> actions;
+    rlt::malloc(device, observation);
+    rlt::malloc(device, action);
+    rlt::malloc(device, actions);
+    T target_position[3];
+    learning_to_fly::constants::get_target_position<T>(target_position);
+
+    bool using_hover[N_ENVIRONMENTS] = {};
+    // the threshold is above any distance in the first step (every environment switches to the hover actor) and zero after that
+    // (no environment switches), so a flag can only be cleared by the start of a new episode of its environment
+    for(TI step_i = 0; step_i < 3 * EPISODE_STEP_LIMIT; step_i++){
+        T threshold = step_i == 0 ? std::numeric_limits<T>::max() : 0;
+        bool was_using_hover[N_ENVIRONMENTS];
+        std::copy(using_hover, using_hover + N_ENVIRONMENTS, was_using_hover);
+        rlt::rl::components::off_policy_runner::prologue(device, runner, rng);
+        learning_to_fly::off_policy_runner::interlude_with_policy_switching(device, runner, policy, hover_policy, policy_buffer, hover_buffer, true, threshold, using_hover);
+        // batched forward pass of the navigation actor, rows of environments in hover mode are replaced by the hover actor
+        rlt::evaluate(device, policy, runner.buffers.observations, actions, policy_buffer);
+        for(TI env_i = 0; env_i < N_ENVIRONMENTS; env_i++){
+            bool new_episode = rlt::get(runner.episode_step, 0, env_i) == 0;
+            ASSERT_EQ(using_hover[env_i], step_i == 0 || (was_using_hover[env_i] && !new_episode));
+            if(using_hover[env_i]){
+                for(TI i = 0; i < ENVIRONMENT::OBSERVATION_DIM; i++){
+                    rlt::set(observation, 0, i, rlt::get(runner.buffers.observations, env_i, i));
+                }
+                learning_to_fly::policy_switching::transform_observation_to_target_relative(device, observation, target_position);
+                rlt::evaluate(device, hover_policy, observation, action, hover_buffer);
+            }
+            for(TI i = 0; i < ENVIRONMENT::ACTION_DIM; i++){
+                T expected = using_hover[env_i] ? rlt::get(action, 0, i) : rlt::get(actions, env_i, i);
+                ASSERT_EQ(rlt::get(runner.buffers.actions, env_i, i), expected);
+            }
+        }
+        rlt::rl::components::off_policy_runner::epilogue(device, runner, rng);
+    }
+    for(TI env_i = 0; env_i < N_ENVIRONMENTS; env_i++){
+        ASSERT_FALSE(using_hover[env_i]);
+        ASSERT_EQ(runner.replay_buffers[env_i].position, 3 * EPISODE_STEP_LIMIT);
+    }
+
+    rlt::free(device, observation);
+    rlt::free(device, action);
+    rlt::free(device, actions);
+    rlt::free(device, policy);
+    rlt::free(device, hover_policy);
+    rlt::free(device, policy_buffer);
+    rlt::free(device, hover_buffer);
+    rlt::free(device, runner);
+}
+
+namespace obstacle_scene_test{
+    namespace obstacle_scene = learning_to_fly::obstacle_scene;
+    const char* SCENE_JSON = R"({
+        "obstacles": [
+            {"type": "cylinder", "x": 1.0, "y": -0.5, "radius": 0.3, "zMin": -1.0, "zMax": 1.0},
+            {"type": "plane", "pointX": 0.0, "pointY": 1.0, "pointZ": 0.0, "normalX": 0.0, "normalY": 1.0, "normalZ": 0.0, "thickness": 0.1,
+             "xMin": -1.0, "xMax": 1.0, "yMin": 0.95, "yMax": 1.05, "zMin": -1.0, "zMax": 1.0}
+        ]
+    })";
+    void expect_equal(const obstacle_scene::Storage& a, const obstacle_scene::Storage& b){
+        ASSERT_EQ(a.cylinders.size(), b.cylinders.size());
+        ASSERT_EQ(a.planes.size(), b.planes.size());
+        // only the leading float fields, the obstacles are padded to their alignment
+        for(size_t i = 0; i < a.cylinders.size(); i++){
+            ASSERT_EQ(std::memcmp(&a.cylinders[i], &b.cylinders[i], 5 * sizeof(float)), 0);
+        }
+        for(size_t i = 0; i < a.planes.size(); i++){
+            ASSERT_EQ(std::memcmp(&a.planes[i], &b.planes[i], 13 * sizeof(float)), 0);
+        }
+    }
+    void write_file(const std::string& path, const std::string& content){
+        std::ofstream file(path, std::ios::binary);
+        file.write(content.data(), content.size());
+    }
+}
+
+TEST(LEARNING_TO_FLY_TRAINING, OBSTACLE_SCENE_JSON) {
+    using namespace obstacle_scene_test;
+    auto storage = obstacle_scene::from_json(nlohmann::json::parse(SCENE_JSON));
+    ASSERT_EQ(storage.cylinders.size(), 1u);
+    ASSERT_EQ(storage.planes.size(), 1u);
+    ASSERT_FALSE(storage.has_generator);
+    ASSERT_EQ(storage.cylinders[0].y, -0.5f);
+    ASSERT_EQ(storage.cylinders[0].radius, 0.3f);
+    ASSERT_EQ(storage.planes[0].normal_y, 1.0f);
+    ASSERT_EQ(storage.planes[0].y_max, 1.05f);
+    // to_json emits the bare obstacle list, which from_json accepts as well
+    expect_equal(obstacle_scene::from_json(obstacle_scene::to_json(storage)), storage);
+
+    auto generator_json = nlohmann::json::parse(SCENE_JSON);
+    generator_json["generator"] = {
+        {"minCylinders", 1}, {"maxCylinders", 2}, {"minRadius", 0.1}, {"maxRadius", 0.2}, {"minPlanes", 0}, {"maxPlanes", 1},
+        {"planeThickness", 0.1}, {"minPlaneLength", 0.5}, {"maxPlaneLength", 1.0}, {"lower", {-1, -1, -1}}, {"upper", {1, 1, 1}},
+        {"clearance", 0.2}, {"maxAttempts", 10}
+    };
+    auto with_generator = obstacle_scene::from_json(generator_json);
+    ASSERT_TRUE(with_generator.has_generator);
+    auto generator = obstacle_scene::generator_from_json(obstacle_scene::generator_to_json(with_generator.generator));
+    ASSERT_EQ(generator.max_cylinders, 2u);
+    ASSERT_EQ(generator.max_radius, 0.2f);
+    ASSERT_EQ(generator.upper[2], 1.0f);
+    ASSERT_EQ(generator.max_attempts, 10u);
+}
+
+TEST(LEARNING_TO_FLY_TRAINING, OBSTACLE_SCENE_BINARY) {
+    using namespace obstacle_scene_test;
+    auto storage = obstacle_scene::from_json(nlohmann::json::parse(SCENE_JSON));
+    std::string path = testing::TempDir() + "obstacle_scene_test.bin";
+    obstacle_scene::save_binary(storage, path);
+    expect_equal(obstacle_scene::load_binary(path), storage);
+    // load dispatches on the suffix
+    expect_equal(obstacle_scene::load(path), storage);
+    std::string json_path = testing::TempDir() + "obstacle_scene_test.json";
+    write_file(json_path, SCENE_JSON);
+    expect_equal(obstacle_scene::load(json_path), storage);
+
+    obstacle_scene::Storage empty;
+    obstacle_scene::save_binary(empty, path);
+    expect_equal(obstacle_scene::load_binary(path), empty);
+    std::remove(path.c_str());
+    std::remove(json_path.c_str());
+}
+
+TEST(LEARNING_TO_FLY_TRAINING, OBSTACLE_SCENE_MALFORMED) {
+    using namespace obstacle_scene_test;
+    ASSERT_THROW(obstacle_scene::from_json(nlohmann::json::parse(R"([{"type": "sphere", "x": 0, "y": 0, "radius": 1}])")), std::runtime_error);
+    ASSERT_ANY_THROW(obstacle_scene::from_json(nlohmann::json::parse(R"([{"type": "cylinder", "x": 0, "y": 0, "zMin": 0, "zMax": 1}])")));
+    ASSERT_ANY_THROW(obstacle_scene::from_json(nlohmann::json::parse(R"({"generator": {}})")));
+    auto too_many = nlohmann::json::parse(SCENE_JSON);
+    too_many["generator"] = {
+        {"minCylinders", 1}, {"maxCylinders", obstacle_scene::obstacles::COURSE_MAX_CYLINDERS + 1}, {"minRadius", 0.1}, {"maxRadius", 0.2},
+        {"minPlanes", 0}, {"maxPlanes", 1}, {"planeThickness", 0.1}, {"minPlaneLength", 0.5}, {"maxPlaneLength", 1.0},
+        {"lower", {-1, -1, -1}}, {"upper", {1, 1, 1}}, {"clearance", 0.2}, {"maxAttempts", 10}
+    };
+    ASSERT_THROW(obstacle_scene::from_json(too_many), std::runtime_error);
+
+    auto storage = obstacle_scene::from_json(nlohmann::json::parse(SCENE_JSON));
+    std::string path = testing::TempDir() + "obstacle_scene_malformed_test.bin";
+    obstacle_scene::save_binary(storage, path);
+    std::string valid;
+    {
+        std::ifstream file(path, std::ios::binary);
+        valid.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    ASSERT_THROW(obstacle_scene::load_binary(testing::TempDir() + "obstacle_scene_missing_test.bin"), std::runtime_error);
+    // wrong magic
+    std::string bad_magic = valid;
+    bad_magic[0] = 'X';
+    write_file(path, bad_magic);
+    ASSERT_THROW(obstacle_scene::load_binary(path), std::runtime_error);
+    // header only partially present
+    write_file(path, valid.substr(0, sizeof(obstacle_scene::BINARY_MAGIC) + 2));
+    ASSERT_THROW(obstacle_scene::load_binary(path), std::runtime_error);
+    // payload truncated or with trailing bytes
+    write_file(path, valid.substr(0, valid.size() - 1));
+    ASSERT_THROW(obstacle_scene::load_binary(path), std::runtime_error);
+    write_file(path, valid + "x");
+    ASSERT_THROW(obstacle_scene::load_binary(path), std::runtime_error);
+    // counts that would allocate far more than the file holds are rejected before resizing
+    std::string huge_counts = valid;
+    uint32_t counts[2] = {0xFFFFFFFFu, 0xFFFFFFFFu};
+    std::memcpy(&huge_counts[sizeof(obstacle_scene::BINARY_MAGIC)], counts, sizeof(counts));
+    write_file(path, huge_counts);
+    ASSERT_THROW(obstacle_scene::load_binary(path), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+namespace relabeling_test{
+    using T = training_test::T;
+    using TI = training_test::TI;
+    // several small replay buffers, so that the relabeling runs over more than one environment and wraps around
+    struct CONFIG: training_test::CONFIG{
+        static constexpr TI N_ENVIRONMENTS = 3;
+        static constexpr TI REPLAY_BUFFER_CAP = 500;
+        using OFF_POLICY_RUNNER_SPEC = rlt::rl::components::off_policy_runner::Specification<T, TI, ENVIRONMENT, N_ENVIRONMENTS, ASYMMETRIC_OBSERVATIONS, REPLAY_BUFFER_CAP, ENVIRONMENT_STEP_LIMIT, rlt::rl::components::off_policy_runner::DefaultParameters<T>, false, true, 1000>;
+        using OFF_POLICY_RUNNER_TYPE = rlt::rl::components::OffPolicyRunner<OFF_POLICY_RUNNER_SPEC>;
+    };
+    using TRAINING_STATE = learning_to_fly::TrainingState<CONFIG>;
+    static_assert(learning_to_fly::steps::reward_relabeling::enabled<CONFIG>());
+
+    // runs the off-policy runner with a random actor for num_steps steps and tags the transitions like training.h does
+    void fill(TRAINING_STATE& ts, TI num_steps){
+        ts.rng = rlt::random::default_engine(typename CONFIG::DEVICE::SPEC::RANDOM{}, 1);
+        ts.rng_eval = rlt::random::default_engine(typename CONFIG::DEVICE::SPEC::RANDOM{}, 2);
+        for(auto& env: ts.envs){
+            env.parameters = training_test::environment_parameters;
+        }
+        rlt::malloc(ts.device, ts.off_policy_runner);
+        rlt::init(ts.device, ts.off_policy_runner, ts.envs);
+        ts.off_policy_runner.parameters = CONFIG::off_policy_runner_parameters;
+        learning_to_fly::steps::reward_relabeling::init(ts);
+        typename CONFIG::ACTOR_TYPE actor;
+        typename CONFIG::ACTOR_TYPE::template DoubleBuffer<CONFIG::N_ENVIRONMENTS> actor_buffer;
+        rlt::malloc(ts.device, actor);
+        rlt::malloc(ts.device, actor_buffer);
+        rlt::init_weights(ts.device, actor, ts.rng);
+        for(TI step_i = 0; step_i < num_steps; step_i++){
+            rlt::step(ts.device, ts.off_policy_runner, actor, actor_buffer, ts.rng);
+            learning_to_fly::steps::reward_relabeling::tag_new_transitions(ts);
+        }
+        rlt::free(ts.device, actor);
+        rlt::free(ts.device, actor_buffer);
+    }
+    // same kind of change as steps::curriculum
+    void change_reward_weights(TRAINING_STATE& ts){
+        for(auto& env: ts.off_policy_runner.envs){
+            env.parameters.mdp.reward.position *= 2;
+            env.parameters.mdp.reward.action *= 1.5;
+        }
+    }
+    TI num_transitions(const TRAINING_STATE& ts, TI env_i){
+        const auto& replay_buffer = ts.off_policy_runner.replay_buffers[env_i];
+        return replay_buffer.full ? CONFIG::REPLAY_BUFFER_CAP : replay_buffer.position;
+    }
+    std::vector<std::vector<T>> rewards(const TRAINING_STATE& ts){
+        std::vector<std::vector<T>> result(CONFIG::N_ENVIRONMENTS);
+        for(TI env_i = 0; env_i < CONFIG::N_ENVIRONMENTS; env_i++){
+            for(TI row_i = 0; row_i < num_transitions(ts, env_i); row_i++){
+                result[env_i].push_back(rlt::get(ts.off_policy_runner.replay_buffers[env_i].rewards, row_i, 0));
+            }
+        }
+        return result;
+    }
+    void set_rewards(TRAINING_STATE& ts, const std::vector<std::vector<T>>& values){
+        for(TI env_i = 0; env_i < CONFIG::N_ENVIRONMENTS; env_i++){
+            for(TI row_i = 0; row_i < values[env_i].size(); row_i++){
+                rlt::set(ts.off_policy_runner.replay_buffers[env_i].rewards, row_i, 0, values[env_i][row_i]);
+            }
+        }
+    }
+    // eager relabeling of every row in a single pass on the calling thread, the replay buffers are left untouched
+    std::vector<std::vector<T>> serial_rewards(TRAINING_STATE& ts){
+        auto stale = rewards(ts);
+        for(TI env_i = 0; env_i < CONFIG::N_ENVIRONMENTS; env_i++){
+            learning_to_fly::steps::internal::recalculate_rewards(ts.device, ts.off_policy_runner.replay_buffers[env_i], ts.off_policy_runner.envs[env_i], (TI)0, num_transitions(ts, env_i), ts.rng_eval);
+        }
+        auto result = rewards(ts);
+        set_rewards(ts, stale);
+        return result;
+    }
+}
+
+TEST(LEARNING_TO_FLY_TRAINING, RECALCULATE_REWARDS_PARALLEL_MATCHES_SERIAL) {
+    using namespace relabeling_test;
+    auto ts = std::make_unique<TRAINING_STATE>();
+    fill(*ts, CONFIG::REPLAY_BUFFER_CAP + 123);
+    change_reward_weights(*ts);
+    auto stale = rewards(*ts);
+    auto expected = serial_rewards(*ts);
+    ASSERT_NE(expected, stale);
+    // the reward functions do not draw from the RNG, hence the chunking and the per-worker streams must not change any reward
+    for(TI num_threads: {1, 2, 7}){
+        set_rewards(*ts, stale);
+        learning_to_fly::steps::recalculate_rewards(*ts, num_threads);
+        ASSERT_EQ(rewards(*ts), expected);
+    }
+    rlt::free(ts->device, ts->off_policy_runner);
+}
+
+TEST(LEARNING_TO_FLY_TRAINING, LAZY_REWARD_RELABELING_MATCHES_EAGER) {
+    using namespace relabeling_test;
+    auto ts = std::make_unique<TRAINING_STATE>();
+    // partially filled, gather_batch must only draw the filled rows
+    fill(*ts, CONFIG::REPLAY_BUFFER_CAP / 2 + 50);
+    change_reward_weights(*ts);
+    auto stale = rewards(*ts);
+    auto expected = serial_rewards(*ts);
+    ASSERT_NE(expected, stale);
+    learning_to_fly::steps::reward_relabeling::invalidate_rewards(*ts);
+
+    auto& batch = ts->critic_batch;
+    rlt::malloc(ts->device, batch);
+    constexpr TI BATCH_SIZE = std::remove_reference_t<decltype(batch)>::SPEC::BATCH_SIZE;
+    for(TI batch_i = 0; batch_i < 2; batch_i++){
+        // the rows are drawn from ts.rng (the relabeling draws from ts.rng_eval), replaying the draws recovers them
+        auto rng = ts->rng;
+        learning_to_fly::steps::gather_batch(*ts, batch);
+        for(TI batch_step_i = 0; batch_step_i < BATCH_SIZE; batch_step_i++){
+            TI env_i = rlt::random::uniform_int_distribution(ts->device.random, (TI)0, (TI)(CONFIG::N_ENVIRONMENTS - 1), rng);
+            TI sample_i = rlt::random::uniform_int_distribution(ts->device.random, (TI)0, num_transitions(*ts, env_i) - 1, rng);
+            const auto& replay_buffer = ts->off_policy_runner.replay_buffers[env_i];
+            ASSERT_EQ(rlt::get(batch.rewards, 0, batch_step_i), expected[env_i][sample_i]);
+            for(TI i = 0; i < CONFIG::ENVIRONMENT::ACTION_DIM; i++){
+                ASSERT_EQ(rlt::get(batch.actions, batch_step_i, i), rlt::get(replay_buffer.actions, sample_i, i));
+            }
+            ASSERT_EQ(ts->reward_versions[env_i][sample_i], ts->current_reward_version[env_i]);
+        }
+    }
+    // the sampled rows are written back, the others keep their stale reward until they are drawn
+    TI relabeled = 0, total = 0;
+    auto current = rewards(*ts);
+    for(TI env_i = 0; env_i < CONFIG::N_ENVIRONMENTS; env_i++){
+        for(TI row_i = 0; row_i < num_transitions(*ts, env_i); row_i++){
+            bool fresh = ts->reward_versions[env_i][row_i] == ts->current_reward_version[env_i];
+            ASSERT_EQ(current[env_i][row_i], fresh ? expected[env_i][row_i] : stale[env_i][row_i]);
+            relabeled += fresh;
+            total++;
+        }
+    }
+    ASSERT_EQ(relabeled, ts->relabeled_rewards);
+    ASSERT_GT(relabeled, 0);
+    ASSERT_LT(relabeled, total);
+    rlt::free(ts->device, batch);
+    rlt::free(ts->device, ts->off_policy_runner);
+}
+
+namespace async_collection_test{
+    // large enough that a torn copy would show up as differing words
+    struct Element{
+        uint64_t words[16];
+    };
+}
+
+TEST(LEARNING_TO_FLY_TRAINING, ASYNC_COLLECTION_QUEUE_STRESS) {
+    using namespace async_collection_test;
+    constexpr uint64_t NUM_ELEMENTS = 1000000;
+    // small capacity, so that the producer runs into the full queue and the consumer into the empty one all the time
+    auto queue = std::make_unique<learning_to_fly::async_collection::Queue<Element, 8>>();
+    std::thread producer([&queue](){
+        Element element;
+        for(uint64_t element_i = 0; element_i < NUM_ELEMENTS; element_i++){
+            std::fill(std::begin(element.words), std::end(element.words), element_i);
+            while(!queue->push(element)){
+                std::this_thread::yield();
+            }
+        }
+    });
+    Element element;
+    for(uint64_t element_i = 0; element_i < NUM_ELEMENTS; element_i++){
+        while(!queue->pop(element)){
+            std::this_thread::yield();
+        }
+        for(uint64_t word: element.words){
+            ASSERT_EQ(word, element_i);
+        }
+    }
+    producer.join();
+    ASSERT_FALSE(queue->pop(element));
+    ASSERT_EQ(queue->head.load(), NUM_ELEMENTS);
+    ASSERT_EQ(queue->tail.load(), NUM_ELEMENTS);
+}
+
+TEST(LEARNING_TO_FLY_TRAINING, ASYNC_COLLECTION_SNAPSHOT_STRESS) {
+    using namespace relabeling_test;
+    using PIPELINE = learning_to_fly::async_collection::Pipeline<CONFIG>;
+    using SNAPSHOT = learning_to_fly::async_collection::Snapshot<CONFIG>;
+    constexpr uint32_t NUM_PUBLISHES = 20000;
+    constexpr TI NUM_READERS = 3;
+    auto ts = std::make_unique<TRAINING_STATE>();
+    rlt::malloc(ts->device, ts->actor_critic.actor);
+    ts->async_pipeline = std::make_unique<PIPELINE>();
+    auto& pipeline = *ts->async_pipeline;
+    for(auto& snapshot: pipeline.snapshots){
+        rlt::malloc(ts->device, snapshot.actor);
+    }
+    // every publish writes its index into all fields the collectors copy, a reader must never see a mix of two publishes
+    auto publish = [&ts](uint32_t publish_i){
+        for(TI env_i = 0; env_i < CONFIG::N_ENVIRONMENTS; env_i++){
+            ts->current_reward_version[env_i] = publish_i;
+        }
+        ts->off_policy_runner.parameters.exploration_noise = (T)publish_i;
+        while(!learning_to_fly::steps::async_collection::publish(*ts)){
+            std::this_thread::yield();
+        }
+    };
+    publish(0);
+    std::atomic<bool> failed{false};
+    std::vector<std::thread> readers;
+    for(TI reader_i = 0; reader_i < NUM_READERS; reader_i++){
+        readers.emplace_back([&pipeline, &failed](){
+            typename CONFIG::DEVICE device;
+            typename CONFIG::ACTOR_TARGET_TYPE actor;
+            rlt::malloc(device, actor);
+            auto snapshot = std::make_unique<SNAPSHOT>();
+            uint64_t seen_version = 0;
+            uint32_t last = 0;
+            while(last != NUM_PUBLISHES){
+                if(!learning_to_fly::async_collection::acquire(device, pipeline, seen_version, actor, *snapshot)){
+                    std::this_thread::yield();
+                    continue;
+                }
+                uint32_t current = snapshot->reward_version[0];
+                bool consistent = current >= last && snapshot->exploration_noise == (T)current;
+                for(TI env_i = 0; env_i < CONFIG::N_ENVIRONMENTS; env_i++){
+                    consistent = consistent && snapshot->reward_version[env_i] == current;
+                }
+                if(!consistent){
+                    failed = true;
+                    break;
+                }
+                last = current;
+            }
+            rlt::free(device, actor);
+        });
+    }
+    for(uint32_t publish_i = 1; publish_i <= NUM_PUBLISHES; publish_i++){
+        publish(publish_i);
+    }
+    for(auto& reader: readers){
+        reader.join();
+    }
+    ASSERT_FALSE(failed.load());
+    ASSERT_EQ(pipeline.version.load(), NUM_PUBLISHES + 1);
+    ASSERT_EQ(pipeline.readers[0].load(), 0);
+    ASSERT_EQ(pipeline.readers[1].load(), 0);
+    for(auto& snapshot: pipeline.snapshots){
+        rlt::free(ts->device, snapshot.actor);
+    }
+    ts->async_pipeline.reset();
+    rlt::free(ts->device, ts->actor_critic.actor);
+}
+
+TEST(LEARNING_TO_FLY_TRAINING, BACKGROUND_EVALUATION_WORKER_POOL) {
+    constexpr unsigned NUM_TASKS = 1000;
+    std::atomic<unsigned> finished{0};
+    std::atomic<unsigned> running{0};
+    std::atomic<unsigned> max_running{0};
+    {
+        learning_to_fly::background_evaluation::WorkerPool pool(3);
+        ASSERT_EQ(pool.size(), 3u);
+        for(unsigned task_i = 0; task_i < NUM_TASKS; task_i++){
+            pool.submit([&](){
+                unsigned current = running.fetch_add(1) + 1;
+                unsigned previous = max_running.load();
+                while(current > previous && !max_running.compare_exchange_weak(previous, current)){}
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+                running.fetch_sub(1);
+                finished.fetch_add(1);
+            });
+        }
+        // the destructor finishes the queued tasks before it joins the workers
+    }
+    ASSERT_EQ(finished.load(), NUM_TASKS);
+    ASSERT_LE(max_running.load(), 3u);
+    ASSERT_GE(max_running.load(), 1u);
+}
+
+namespace batched_evaluation_test{
+    using T = training_test::T;
+    using TI = training_test::TI;
+    struct CONFIG: training_test::CONFIG{
+        static constexpr TI NUM_EVALUATION_EPISODES = 30;
+        static constexpr TI ENVIRONMENT_STEP_LIMIT_EVALUATION = 100;
+    };
+    using ENVIRONMENT = CONFIG::ENVIRONMENT_EVALUATION;
+    using OBSERVATIONS = rlt::MatrixDynamic<rlt::matrix::Specification<T, TI, 1, ENVIRONMENT::OBSERVATION_DIM>>;
+    const auto environment_parameters = parameters::environment<T, TI, CONFIG::ABLATION_SPEC_EVAL_INSTANCE>::parameters;
+    // the aggregates batched_evaluation fills in
+    struct Result{
+        T returns_mean, returns_std, episode_length_mean, episode_length_std;
+    };
+}
+
+TEST(LEARNING_TO_FLY_TRAINING, BATCHED_EVALUATION_INDEPENDENT_OF_THREADS) {
+    using namespace batched_evaluation_test;
+    CONFIG::DEVICE device;
+    auto rng = rlt::random::default_engine(typename CONFIG::DEVICE::SPEC::RANDOM{}, 0);
+    ENVIRONMENT env;
+    env.parameters = environment_parameters;
+    rlt::rl::environments::multirotor::update_wrench_mixing(device, env.parameters.dynamics);
+    CONFIG::ACTOR_TARGET_TYPE actor;
+    rlt::malloc(device, actor);
+    rlt::init_weights(device, actor, rng);
+    OBSERVATIONS observations_mean, observations_std;
+    rlt::malloc(device, observations_mean);
+    rlt::malloc(device, observations_std);
+    rlt::set_all(device, observations_mean, 0);
+    rlt::set_all(device, observations_std, 1);
+    const learning_to_fly::scenario_bank::Bank<ENVIRONMENT>* bank = nullptr;
+
+    // the episodes only depend on their shard (seed + shard_i), not on the thread that runs it
+    std::vector<double> returns, episode_lengths;
+    learning_to_fly::batched_evaluation::run_episodes<CONFIG, CONFIG::NUM_EVALUATION_EPISODES, CONFIG::DEVICE>(env, actor, observations_mean, observations_std, bank, 0, 3, 1, returns, episode_lengths);
+    ASSERT_EQ(returns.size(), CONFIG::NUM_EVALUATION_EPISODES);
+    ASSERT_EQ(episode_lengths.size(), CONFIG::NUM_EVALUATION_EPISODES);
+    for(double episode_length: episode_lengths){
+        ASSERT_GE(episode_length, 1);
+        ASSERT_LE(episode_length, CONFIG::ENVIRONMENT_STEP_LIMIT_EVALUATION);
+    }
+    for(unsigned num_threads: {2u, 3u, 4u, 16u}){
+        std::vector<double> other_returns, other_episode_lengths;
+        learning_to_fly::batched_evaluation::run_episodes<CONFIG, CONFIG::NUM_EVALUATION_EPISODES, CONFIG::DEVICE>(env, actor, observations_mean, observations_std, bank, 0, 3, num_threads, other_returns, other_episode_lengths);
+        ASSERT_EQ(other_returns, returns);
+        ASSERT_EQ(other_episode_lengths, episode_lengths);
+    }
+    Result single, multi;
+    learning_to_fly::batched_evaluation::evaluate<CONFIG>(device, env, actor, observations_mean, observations_std, bank, 3, 1, single);
+    learning_to_fly::batched_evaluation::evaluate<CONFIG>(device, env, actor, observations_mean, observations_std, bank, 3, 4, multi);
+    ASSERT_EQ(single.returns_mean, multi.returns_mean);
+    ASSERT_EQ(single.returns_std, multi.returns_std);
+    ASSERT_EQ(single.episode_length_mean, multi.episode_length_mean);
+
+    ASSERT_GE(learning_to_fly::steps::internal::evaluation_threads<CONFIG>(), 1u);
+    ASSERT_GE(learning_to_fly::steps::internal::evaluation_workers(), 1u);
+    if constexpr(CONFIG::BACKGROUND_EVALUATION){
+        // a pool with all workers busy stays within half of the hardware threads (or one thread per worker)
+        unsigned hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        ASSERT_LE(learning_to_fly::steps::internal::evaluation_workers() * learning_to_fly::steps::internal::evaluation_threads<CONFIG>(), std::max(hardware_threads / 2, learning_to_fly::steps::internal::evaluation_workers()));
+    }
+
+    rlt::free(device, observations_mean);
+    rlt::free(device, observations_std);
+    rlt::free(device, actor);
+}
+
+namespace sequential_evaluation_test{
+    using namespace batched_evaluation_test;
+    // not a multiple of SEQUENTIAL_EVALUATION_ROUND
+    struct SEQUENTIAL_CONFIG: CONFIG{
+        static constexpr TI NUM_EVALUATION_EPISODES = 2 * learning_to_fly::constants::SEQUENTIAL_EVALUATION_ROUND + learning_to_fly::constants::SEQUENTIAL_EVALUATION_ROUND / 2;
+        static constexpr TI ENVIRONMENT_STEP_LIMIT_EVALUATION = 20;
+    };
+}
+
+TEST(LEARNING_TO_FLY_TRAINING, SEQUENTIAL_EVALUATION_SETTLING) {
+    using namespace sequential_evaluation_test;
+    constexpr TI ROUND = learning_to_fly::constants::SEQUENTIAL_EVALUATION_ROUND;
+    constexpr double INF = std::numeric_limits<double>::infinity();
+    constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+    CONFIG::DEVICE device;
+    auto rng = rlt::random::default_engine(typename CONFIG::DEVICE::SPEC::RANDOM{}, 0);
+    ENVIRONMENT env;
+    env.parameters = environment_parameters;
+    rlt::rl::environments::multirotor::update_wrench_mixing(device, env.parameters.dynamics);
+    CONFIG::ACTOR_TARGET_TYPE actor;
+    rlt::malloc(device, actor);
+    rlt::init_weights(device, actor, rng);
+    OBSERVATIONS observations_mean, observations_std;
+    rlt::malloc(device, observations_mean);
+    rlt::malloc(device, observations_std);
+    rlt::set_all(device, observations_mean, 0);
+    rlt::set_all(device, observations_std, 1);
+    const learning_to_fly::scenario_bank::Bank<ENVIRONMENT>* bank = nullptr;
+    Result result;
+
+    // without a finite reference (e.g. the first evaluation) nothing can be settled: all episodes are run, the last round is
+    // shortened so that the total is exactly NUM_EVALUATION_EPISODES
+    TI episodes = learning_to_fly::batched_evaluation::sequential_evaluate<SEQUENTIAL_CONFIG>(device, env, actor, observations_mean, observations_std, bank, 5, 2, -INF, NaN, result);
+    ASSERT_EQ(episodes, SEQUENTIAL_CONFIG::NUM_EVALUATION_EPISODES);
+    ASSERT_TRUE(std::isfinite(result.returns_mean));
+    ASSERT_GT(result.episode_length_mean, 0);
+    episodes = learning_to_fly::batched_evaluation::sequential_evaluate<SEQUENTIAL_CONFIG>(device, env, actor, observations_mean, observations_std, bank, 5, 2, NaN, -INF, result);
+    ASSERT_EQ(episodes, SEQUENTIAL_CONFIG::NUM_EVALUATION_EPISODES);
+    // a reference far above (or below) any return is settled after the first round
+    episodes = learning_to_fly::batched_evaluation::sequential_evaluate<SEQUENTIAL_CONFIG>(device, env, actor, observations_mean, observations_std, bank, 5, 2, 1e9, -INF, result);
+    ASSERT_EQ(episodes, ROUND);
+    episodes = learning_to_fly::batched_evaluation::sequential_evaluate<SEQUENTIAL_CONFIG>(device, env, actor, observations_mean, observations_std, bank, 5, 2, -1e9, NaN, result);
+    ASSERT_EQ(episodes, ROUND);
+    // both references have to be settled
+    episodes = learning_to_fly::batched_evaluation::sequential_evaluate<SEQUENTIAL_CONFIG>(device, env, actor, observations_mean, observations_std, bank, 5, 2, 1e9, result.returns_mean, result);
+    ASSERT_GT(episodes, ROUND);
+    ASSERT_LE(episodes, SEQUENTIAL_CONFIG::NUM_EVALUATION_EPISODES);
+
+    rlt::free(device, observations_mean);
+    rlt::free(device, observations_std);
+    rlt::free(device, actor);
+}
+
+namespace scenario_bank_test{
+    namespace scenario_bank = learning_to_fly::scenario_bank;
+    namespace obstacles = rlt::rl::environments::multirotor::obstacles;
+    using T = training_test::T;
+    using TI = training_test::TI;
+    // the position to position reward carries the per-episode obstacle course
+    using CONFIG = learning_to_fly::config::Config<learning_to_fly::config::POSITION_TO_POSITION_ABLATION_SPEC>;
+    using ENVIRONMENT = CONFIG::ENVIRONMENT;
+    const auto environment_parameters = parameters::environment<T, TI, CONFIG::ABLATION_SPEC>::parameters;
+    const obstacles::CourseGenerator generator = {1, 4, 0.1, 0.3, 0, 2, 0.05, 0.5, 1.5, {-2, -2, -1}, {2, 2, 1}, 0.2, 10};
+    template <typename STATE>
+    void expect_equal(const STATE& a, const STATE& b){
+        for(TI i = 0; i < 3; i++){
+            ASSERT_EQ(a.position[i], b.position[i]);
+            ASSERT_EQ(a.linear_velocity[i], b.linear_velocity[i]);
+            ASSERT_EQ(a.angular_velocity[i], b.angular_velocity[i]);
+            ASSERT_EQ(a.force[i], b.force[i]);
+            ASSERT_EQ(a.torque[i], b.torque[i]);
+        }
+        for(TI i = 0; i < 4; i++){
+            ASSERT_EQ(a.orientation[i], b.orientation[i]);
+            ASSERT_EQ(a.rpm[i], b.rpm[i]);
+        }
+    }
+    void expect_equal(const obstacles::Course& a, const obstacles::Course& b){
+        ASSERT_EQ(a.num_cylinders, b.num_cylinders);
+        ASSERT_EQ(a.num_planes, b.num_planes);
+        for(size_t i = 0; i < a.num_cylinders; i++){
+            ASSERT_EQ(a.x[i], b.x[i]);
+            ASSERT_EQ(a.y[i], b.y[i]);
+            ASSERT_EQ(a.radius[i], b.radius[i]);
+            ASSERT_EQ(a.cylinder_z_min[i], b.cylinder_z_min[i]);
+            ASSERT_EQ(a.cylinder_z_max[i], b.cylinder_z_max[i]);
+        }
+        for(size_t i = 0; i < a.num_planes; i++){
+            ASSERT_EQ(a.thickness[i], b.thickness[i]);
+            for(size_t dim_i = 0; dim_i < 3; dim_i++){
+                ASSERT_EQ(a.point[dim_i][i], b.point[dim_i][i]);
+                ASSERT_EQ(a.normal[dim_i][i], b.normal[dim_i][i]);
+                ASSERT_EQ(a.lower[dim_i][i], b.lower[dim_i][i]);
+                ASSERT_EQ(a.upper[dim_i][i], b.upper[dim_i][i]);
+            }
+        }
+    }
+}
+
+TEST(LEARNING_TO_FLY_TRAINING, SCENARIO_BANK_ROUND_TRIP) {
+    using namespace scenario_bank_test;
+    constexpr TI NUM_RECORDS = 20;
+    constexpr TI NUM_NOISE_SAMPLES = 10;
+    CONFIG::DEVICE device;
+    ENVIRONMENT env;
+    env.parameters = environment_parameters;
+    rlt::rl::environments::multirotor::parameters::reward_functions::set_course_generator(env.parameters.mdp.reward, &generator);
+    auto reference_dynamics = env.parameters.dynamics;
+    rlt::rl::environments::multirotor::update_wrench_mixing(device, reference_dynamics);
+    // e.g. a copy of parameters that never went through update_wrench_mixing
+    std::memset(env.parameters.dynamics.wrench_mixing, 0, sizeof(env.parameters.dynamics.wrench_mixing));
+
+    std::string path = testing::TempDir() + "scenario_bank_test.bin";
+    std::string other_path = testing::TempDir() + "scenario_bank_test_other.bin";
+    scenario_bank::save(device, env, path, NUM_RECORDS, 3);
+    // the bank only depends on the seed
+    scenario_bank::save(device, env, other_path, NUM_RECORDS, 3);
+    std::string contents, other_contents;
+    {
+        std::ifstream file(path, std::ios::binary), other_file(other_path, std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        other_contents.assign(std::istreambuf_iterator<char>(other_file), std::istreambuf_iterator<char>());
+    }
+    ASSERT_EQ(contents.size(), sizeof(scenario_bank::Header) + NUM_RECORDS * sizeof(scenario_bank::Record<ENVIRONMENT>));
+    ASSERT_EQ(contents, other_contents);
+
+    scenario_bank::Bank<ENVIRONMENT> bank(path);
+    ASSERT_EQ(bank.size(), NUM_RECORDS);
+    ASSERT_EQ(&bank[NUM_RECORDS + 1], &bank[1]);
+
+    // the scenarios are replayed independently of what the environment and RNG were used for before
+    ENVIRONMENT env_forward = env, env_backward = env;
+    using RNG = decltype(rlt::random::default_engine(typename CONFIG::DEVICE::SPEC::RANDOM{}, 0));
+    std::vector<typename ENVIRONMENT::State> states_forward(NUM_RECORDS), states_backward(NUM_RECORDS);
+    std::vector<obstacles::Course> courses_forward(NUM_RECORDS), courses_backward(NUM_RECORDS);
+    std::vector<std::vector<T>> noise_forward(NUM_RECORDS), noise_backward(NUM_RECORDS);
+    auto draw_noise = [&device](RNG& rng){
+        std::vector<T> noise;
+        for(TI sample_i = 0; sample_i < NUM_NOISE_SAMPLES; sample_i++){
+            noise.push_back(rlt::random::uniform_real_distribution(device.random, (T)0, (T)1, rng));
+        }
+        return noise;
+    };
+    for(TI record_i = 0; record_i < NUM_RECORDS; record_i++){
+        RNG rng = rlt::random::default_engine(typename CONFIG::DEVICE::SPEC::RANDOM{}, 1000 + record_i);
+        scenario_bank::apply(device, env_forward, bank[record_i], states_forward[record_i], rng);
+        courses_forward[record_i] = env_forward.parameters.mdp.reward.course;
+        noise_forward[record_i] = draw_noise(rng);
+        ASSERT_EQ(std::memcmp(env_forward.parameters.dynamics.wrench_mixing, reference_dynamics.wrench_mixing, sizeof(reference_dynamics.wrench_mixing)), 0);
+    }
+    for(TI record_i = NUM_RECORDS; record_i-- > 0;){
+        RNG rng = rlt::random::default_engine(typename CONFIG::DEVICE::SPEC::RANDOM{}, 2000 + record_i);
+        scenario_bank::apply(device, env_backward, bank[record_i], states_backward[record_i], rng);
+        courses_backward[record_i] = env_backward.parameters.mdp.reward.course;
+        noise_backward[record_i] = draw_noise(rng);
+    }
+    bool any_course = false;
+    for(TI record_i = 0; record_i < NUM_RECORDS; record_i++){
+        const auto& record = bank[record_i];
+        // state
+        expect_equal(states_forward[record_i], record.state);
+        expect_equal(states_backward[record_i], record.state);
+        // course: drawn around the spawn position from the course seed
+        expect_equal(courses_forward[record_i], courses_backward[record_i]);
+        auto reference_env = env;
+        auto course_rng = rlt::random::default_engine(typename CONFIG::DEVICE::SPEC::RANDOM{}, record.course_seed);
+        rlt::rl::environments::multirotor::parameters::reward_functions::sample_obstacle_course(device, reference_env.parameters.mdp.reward, record.state.position, course_rng);
+        expect_equal(courses_forward[record_i], reference_env.parameters.mdp.reward.course);
+        ASSERT_LE(courses_forward[record_i].num_cylinders, generator.max_cylinders);
+        any_course = any_course || courses_forward[record_i].num_cylinders > 0;
+        // noise: the episode RNG starts from the noise seed
+        ASSERT_EQ(noise_forward[record_i], noise_backward[record_i]);
+        RNG noise_rng = rlt::random::default_engine(typename CONFIG::DEVICE::SPEC::RANDOM{}, record.noise_seed);
+        ASSERT_EQ(noise_forward[record_i], draw_noise(noise_rng));
+    }
+    ASSERT_TRUE(any_course);
+
+    // obstacle scenes are not mistaken for scenario banks
+    learning_to_fly::obstacle_scene::save_binary(learning_to_fly::obstacle_scene::Storage{}, other_path);
+    ASSERT_THROW(scenario_bank::Bank<ENVIRONMENT>{other_path}, std::runtime_error);
+    std::remove(path.c_str());
+    std::remove(other_path.c_str());
+}